@@ -81,18 +81,20 @@ module F2(
     input             pause
 );
 
-wire cfg_260dar, cfg_110pcr, cfg_360pri, cfg_360pri_high, cfg_io_swap, cfg_tmp82c265, cfg_190fmc, cfg_te7750;
-wire cfg_280grd, cfg_430grw, cfg_480scp, cfg_100scn;
+wire cfg_260dar, cfg_110pcr, cfg_360pri, cfg_360pri_high, cfg_io_swap, cfg_tmp82c265, cfg_te7750;
+wire cfg_190fmc /* verilator public_flat */;
+wire cfg_280grd /* verilator public_flat */;
+wire cfg_430grw, cfg_480scp, cfg_100scn;
 wire cfg_bpp15, cfg_bppmix;
 
 wire [1:0] cfg_obj_extender /* verilator public_flat */;
 
 wire [15:0] cfg_addr_rom;
 wire [15:0] cfg_addr_rom1;
-wire [15:0] cfg_addr_work_ram;
-wire [15:0] cfg_addr_screen;
-wire [15:0] cfg_addr_obj;
-wire [15:0] cfg_addr_color;
+wire [15:0] cfg_addr_work_ram /* verilator public_flat */;
+wire [15:0] cfg_addr_screen /* verilator public_flat */;
+wire [15:0] cfg_addr_obj /* verilator public_flat */;
+wire [15:0] cfg_addr_color /* verilator public_flat */;
 wire [15:0] cfg_addr_io0;
 wire [15:0] cfg_addr_io1;
 wire [15:0] cfg_addr_sound;
@@ -387,17 +389,18 @@ end
 //////////////////////////////////
 //// CHIP SELECTS
 
-logic ROMn; // CPU ROM
-logic WORKn; // CPU RAM
-logic SCREENn;
-logic COLORn;
-logic IO0n, IO1n;
-logic OBJECTn;
-logic PRIORITYn;
+logic ROMn /* verilator public_flat */; // CPU ROM
+logic WORKn /* verilator public_flat */; // CPU RAM
+logic SCREENn /* verilator public_flat */;
+logic COLORn /* verilator public_flat */;
+logic IO0n /* verilator public_flat */;
+logic IO1n /* verilator public_flat */;
+logic OBJECTn /* verilator public_flat */;
+logic PRIORITYn /* verilator public_flat */;
 logic SOUNDn /* verilator public_flat */;
-logic EXTENSIONn;
-logic CCHIPn;
-logic PIVOTn;
+logic EXTENSIONn /* verilator public_flat */;
+logic CCHIPn /* verilator public_flat */;
+logic PIVOTn /* verilator public_flat */;
 logic GROWL_HACKn;
 
 wire SDTACKn, CDTACKn, CPUENn, dar_dtack_n, pivot_dtack_n;
@@ -470,10 +473,12 @@ jtframe_frac_cen #(2) audio_cen
 
 //////////////////////////////////
 //// CPU
-wire        cpu_rw, cpu_as_n;
-wire [1:0]  cpu_ds_n;
-wire [2:0]  cpu_fc;
-wire [15:0] cpu_data_in, cpu_data_out;
+wire        cpu_rw /* verilator public_flat */;
+wire        cpu_as_n /* verilator public_flat */;
+wire [1:0]  cpu_ds_n /* verilator public_flat */;
+wire [2:0]  cpu_fc /* verilator public_flat */;
+wire [15:0] cpu_data_in /* verilator public_flat */;
+wire [15:0] cpu_data_out /* verilator public_flat */;
 wire [22:0] cpu_addr;
 wire [23:0] cpu_word_addr /* verilator public_flat */ = { cpu_addr, 1'b0 };
 wire IACKn = ~&cpu_fc;
@@ -1064,7 +1069,8 @@ TC0260DAR tc0260dar(
 wire ICLR1n = ~(~IACKn & (cpu_addr[2:0] == 3'b101) & ~cpu_ds_n[0]);
 wire ICLR2n = ~(~IACKn & (cpu_addr[2:0] == 3'b110) & ~cpu_ds_n[0]);
 
-reg int_req1, int_req2;
+reg int_req1 /* verilator public_flat */;
+reg int_req2 /* verilator public_flat */;
 reg vbl_prev, dma_prev;
 
 assign IPLn = ss_irq ? ~3'b111 :
@@ -1209,6 +1215,35 @@ always_ff @(posedge clk) begin
     prev_ds_n <= cpu_as_n;
 end
 
+`ifdef VERILATOR
+// Simulator stall accounting. Free running counts of clk cycles where the
+// 68k has AS asserted and a DTACK source is holding off the cycle, the last
+// entry counts cycles where any of them are.
+localparam int STALL_ROM_CACHE = 0;
+localparam int STALL_ROM_SETUP = 1;
+localparam int STALL_SCN = 2;
+localparam int STALL_110PR = 3;
+localparam int STALL_260DAR = 4;
+localparam int STALL_OBJ = 5;
+localparam int STALL_PIVOT = 6;
+localparam int STALL_ANY = 7;
+
+reg [31:0] dtack_stall[8] /* verilator public_flat */;
+
+always_ff @(posedge clk) begin
+    if (~cpu_as_n) begin
+        if (sdr_dtack_n) dtack_stall[STALL_ROM_CACHE] <= dtack_stall[STALL_ROM_CACHE] + 1;
+        if (pre_sdr_dtack_n) dtack_stall[STALL_ROM_SETUP] <= dtack_stall[STALL_ROM_SETUP] + 1;
+        if (SDTACKn) dtack_stall[STALL_SCN] <= dtack_stall[STALL_SCN] + 1;
+        if (~cfg_260dar & CDTACKn) dtack_stall[STALL_110PR] <= dtack_stall[STALL_110PR] + 1;
+        if (cfg_260dar & dar_dtack_n) dtack_stall[STALL_260DAR] <= dtack_stall[STALL_260DAR] + 1;
+        if (CPUENn) dtack_stall[STALL_OBJ] <= dtack_stall[STALL_OBJ] + 1;
+        if (pivot_dtack_n) dtack_stall[STALL_PIVOT] <= dtack_stall[STALL_PIVOT] + 1;
+        if (dtack_n) dtack_stall[STALL_ANY] <= dtack_stall[STALL_ANY] + 1;
+    end
+end
+`endif
+
 wire [7:0] cchip_data;
 
 TC0030CMD tc0030cmd(
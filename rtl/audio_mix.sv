@@ -12,7 +12,8 @@ module audio_mix(
 );
 
 // 2mhz, 4mhz
-wire ce_2x, ce;
+wire ce_2x;
+wire ce /* verilator public_flat */;
 jtframe_frac_cen #(2) mix_cen
 (
     .clk(clk),
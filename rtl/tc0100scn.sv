@@ -98,7 +98,7 @@ reg [15:0] ram_addr;
 reg [9:0] full_hcnt;
 reg [8:0] hcnt_actual, vcnt_actual;
 
-reg [15:0] ctrl[8];
+reg [15:0] ctrl[8] /* verilator public_flat */;
 
 wire [15:0] bg0_x = ctrl[0];
 wire [15:0] bg1_x = ctrl[1];
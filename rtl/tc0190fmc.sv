@@ -17,7 +17,7 @@ module TC0190FMC #(parameter SS_IDX=-1) (
     ssbus_if.slave ssbus
 );
 
-reg [7:0] ctrl[8];
+reg [7:0] ctrl[8] /* verilator public_flat */;
 
 always_ff @(posedge clk) begin
     if (reset) begin
@@ -97,7 +97,7 @@ reg         inst_debug;
 assign code_original = inst_tile_code;
 wire [18:0] tile_code = code_modified;
 
-reg [15:0] cmd_ctrl;
+reg [15:0] cmd_ctrl /* verilator public_flat */;
 wire ctrl_disable = cmd_ctrl[12];
 wire ctrl_flipscreen = cmd_ctrl[13];
 wire ctrl_6bpp = cmd_ctrl[8];
@@ -144,7 +144,7 @@ draw_state_t obj_state = ST_IDLE;
 reg [12:0] dma_cycle;
 wire [12:0] dma_addr = {dma_cycle[12:3], 3'b000};
 
-reg scanout_buffer = 0;
+reg scanout_buffer /* verilator public_flat */ = 0;
 wire draw_buffer = ~scanout_buffer;
 
 wire fb_dirty_scan, fb_dirty_is_set;
@@ -172,7 +172,8 @@ dualport_ram_unreg #(.WIDTH(1), .WIDTHAD(16)) fb_dirty_buffer
     .q_b(fb_dirty_is_set)
 );
 
-reg [11:0] master_x, master_y, extra_x, extra_y;
+reg [11:0] master_x /* verilator public_flat */, master_y /* verilator public_flat */;
+reg [11:0] extra_x, extra_y;
 reg [11:0] latch_x, latch_y;
 reg [7:0]  latch_color;
 reg prev_vbl_n, vbl_edge;
@@ -756,6 +757,103 @@ always_ff @(posedge clk) begin
     endcase
 end
 
+`ifdef VERILATOR
+// Simulator sprite budget accounting. obj_stat entries are free running
+// counts, the obj_vbl_* registers are latched at each vblank edge, which
+// obj_vbl_count counts. Sprite entries are paced at 256 ce_13m cycles each,
+// so a full list of 835 needs at least 213760 of the 222176 in a frame.
+localparam int OBJ_STAT_READ = 0;         // entries read from the sprite list
+localparam int OBJ_STAT_DRAWN = 1;        // entries that fetched and drew a tile
+localparam int OBJ_STAT_NO_TILE = 2;      // skipped, tile code 0 or ctrl_disable
+localparam int OBJ_STAT_OFFSCREEN = 3;    // skipped by the bounds check
+localparam int OBJ_STAT_IGNORE_EXTRA = 4; // entries with the extra scroll ignored
+localparam int OBJ_STAT_IGNORE_ALL = 5;   // entries with all scrolling ignored
+localparam int OBJ_STAT_TILE_BEATS = 6;   // ddr_obj tile data beats
+localparam int OBJ_STAT_FB_BEATS = 7;     // ddr_obj framebuffer write beats
+localparam int OBJ_STAT_SCAN_BEATS = 8;   // ddr_fb scanout read beats
+localparam int OBJ_STAT_DRAW_CYCLES = 9;  // ce_13m cycles between ST_DRAW_INIT and ST_IDLE
+localparam int OBJ_STAT_PACE_CYCLES = 10; // ce_13m cycles waiting on read_pacing
+
+reg [31:0] obj_stat[11] /* verilator public_flat */;
+
+reg [31:0] obj_vbl_count /* verilator public_flat */;
+reg [31:0] obj_vbl_remaining /* verilator public_flat */;  // ce_13m cycles from the end of the list, 0 if unfinished
+reg [9:0]  obj_vbl_unread /* verilator public_flat */;     // list entries not reached
+reg [31:0] obj_vbl_max_late /* verilator public_flat */;   // furthest an entry started behind its pacing slot
+
+reg obj_list_done;
+reg [31:0] obj_done_cycles;
+reg [17:0] obj_max_late;
+
+wire obj_drawing = obj_state >= ST_DRAW_INIT;
+wire [17:0] obj_late = read_pacing - { obj_addr[12:3], 8'd0 };
+
+always_ff @(posedge clk) begin
+    if (ce_13m) begin
+        obj_done_cycles <= obj_done_cycles + 1;
+        if (obj_drawing) obj_stat[OBJ_STAT_DRAW_CYCLES] <= obj_stat[OBJ_STAT_DRAW_CYCLES] + 1;
+    end
+
+    case(obj_state)
+        ST_DRAW_INIT: if (ce_13m) begin
+            obj_list_done <= 0;
+        end
+
+        ST_READ_START: if (ce_13m) begin
+            if (obj_addr[12:3] == 835) begin
+                obj_list_done <= 1;
+                obj_done_cycles <= 0;
+            end else if (~vbl_edge) begin
+                if (read_pacing[17:8] >= obj_addr[12:3]) begin
+                    obj_stat[OBJ_STAT_READ] <= obj_stat[OBJ_STAT_READ] + 1;
+                    if (obj_late > obj_max_late) obj_max_late <= obj_late;
+                end else begin
+                    obj_stat[OBJ_STAT_PACE_CYCLES] <= obj_stat[OBJ_STAT_PACE_CYCLES] + 1;
+                end
+            end
+        end
+
+        ST_EVAL0: begin
+            if (~inst_use_extra) obj_stat[OBJ_STAT_IGNORE_EXTRA] <= obj_stat[OBJ_STAT_IGNORE_EXTRA] + 1;
+            if (~inst_use_scroll) obj_stat[OBJ_STAT_IGNORE_ALL] <= obj_stat[OBJ_STAT_IGNORE_ALL] + 1;
+        end
+
+        ST_EVAL3: begin
+            if (tile_code == 0 || ctrl_disable) obj_stat[OBJ_STAT_NO_TILE] <= obj_stat[OBJ_STAT_NO_TILE] + 1;
+        end
+
+        ST_CHECK_BOUNDS: begin
+            if (latch_x > 480 || latch_y > 240)
+                obj_stat[OBJ_STAT_OFFSCREEN] <= obj_stat[OBJ_STAT_OFFSCREEN] + 1;
+            else
+                obj_stat[OBJ_STAT_DRAWN] <= obj_stat[OBJ_STAT_DRAWN] + 1;
+        end
+
+        ST_READ_TILE_WAIT: begin
+            if (ddr_obj.rdata_ready) obj_stat[OBJ_STAT_TILE_BEATS] <= obj_stat[OBJ_STAT_TILE_BEATS] + 1;
+        end
+
+        ST_DRAW_TILE2: begin
+            if (~ddr_obj.busy) obj_stat[OBJ_STAT_FB_BEATS] <= obj_stat[OBJ_STAT_FB_BEATS] + 1;
+        end
+
+        default: begin
+        end
+    endcase
+
+    if (scan_state == SCAN_WAIT_READ && ~ddr_fb.busy && ddr_fb.rdata_ready)
+        obj_stat[OBJ_STAT_SCAN_BEATS] <= obj_stat[OBJ_STAT_SCAN_BEATS] + 1;
+
+    if (prev_vbl_n & ~VBLn) begin
+        obj_vbl_count <= obj_vbl_count + 1;
+        obj_vbl_remaining <= obj_list_done ? obj_done_cycles : 32'd0;
+        obj_vbl_unread <= (obj_drawing & ~obj_list_done) ? 10'd835 - obj_addr[12:3] : 10'd0;
+        obj_vbl_max_late <= { 14'd0, obj_max_late };
+        obj_max_late <= 0;
+    end
+end
+`endif
+
 endmodule
 
 
@@ -160,7 +160,7 @@ reg prev_cs_n;
 reg ram_pending = 0;
 reg ram_access = 0;
 
-reg [15:0] ctrl[8];
+reg [15:0] ctrl[8] /* verilator public_flat */;
 
 wire [23:0] origin_x = { ctrl[0][7:0], ctrl[1] };
 wire [23:0] dxx = is_280grd ? { {7{ctrl[2][15]}}, ctrl[2], 1'b0 } : { {8{ctrl[2][15]}}, ctrl[2] };
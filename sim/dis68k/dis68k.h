@@ -18,6 +18,9 @@ public:
 
 	bool disasm(uint32_t *inst_address, char *decoded_str, size_t decoded_len);
 
+	// Address of the next undecoded word, ie the end of the last instruction
+	uint32_t next_address() const { return address; }
+
 private:
 	uint8_t getbyte()
 	{
@@ -0,0 +1,239 @@
+// Standalone viewer for frames and audio published by `sim --shm`.
+// Any number of viewers can attach to the same sim.
+
+#include "sim_shm.h"
+#include "sim_audio.h"
+
+#include <SDL.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct Attachment {
+    const ShmHeader* header = nullptr;
+    size_t size = 0;
+    uint32_t session = 0;
+    uint64_t audio_read_pos = 0;
+    uint64_t last_frame = ~0ull;
+};
+
+static bool attach(const char* name, Attachment& a)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) return false;
+
+    const ShmHeader* header = (const ShmHeader*)mem;
+    if (memcmp(header->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) || header->version != SHM_VERSION ||
+        header->header_size != sizeof(ShmHeader))
+    {
+        munmap(mem, st.st_size);
+        return false;
+    }
+
+    a.header = header;
+    a.size = st.st_size;
+    a.session = header->session;
+    a.audio_read_pos = header->audio_write_pos.load(std::memory_order_acquire);
+    a.last_frame = ~0ull;
+    return true;
+}
+
+static void detach(Attachment& a)
+{
+    if (a.header) munmap((void*)a.header, a.size);
+    a.header = nullptr;
+}
+
+static bool still_valid(const Attachment& a)
+{
+    return memcmp(a.header->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) == 0 && a.header->session == a.session;
+}
+
+// Copy the newest complete frame, returns false if there is nothing new or
+// the sim overwrote it while copying
+static bool read_frame(Attachment& a, std::vector<uint32_t>& pixels)
+{
+    const ShmHeader* h = a.header;
+
+    uint32_t slot;
+    uint64_t frame;
+    for (int retry = 0; ; retry++)
+    {
+        if (retry > 100) return false;
+        uint32_t s1 = h->seq.load(std::memory_order_acquire);
+        if (s1 & 1) continue;
+        slot = h->latest_slot;
+        frame = h->latest_frame;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (h->seq.load(std::memory_order_relaxed) == s1) break;
+    }
+
+    if (frame == a.last_frame || slot >= h->frame_slots) return false;
+
+    const ShmFrameSlot& s = h->slots[slot];
+    uint32_t s1 = s.seq.load(std::memory_order_acquire);
+    if (s1 & 1) return false;
+
+    const uint8_t* src = (const uint8_t*)h + h->frame_offset + slot * h->frame_stride;
+    pixels.resize(h->width * h->height);
+    memcpy(pixels.data(), src, pixels.size() * sizeof(uint32_t));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s.seq.load(std::memory_order_relaxed) != s1) return false;
+
+    a.last_frame = frame;
+    return true;
+}
+
+static void read_audio(Attachment& a, SimAudioOutput& output)
+{
+    const ShmHeader* h = a.header;
+    const int16_t* ring = (const int16_t*)((const uint8_t*)h + h->audio_offset);
+    const uint64_t mask = h->audio_samples - 1;
+
+    uint64_t write_pos = h->audio_write_pos.load(std::memory_order_acquire);
+    if (write_pos < a.audio_read_pos || write_pos - a.audio_read_pos > h->audio_samples / 2)
+    {
+        // Fell too far behind, skip ahead
+        a.audio_read_pos = write_pos - std::min<uint64_t>(write_pos, h->audio_samples / 4);
+    }
+
+    for ( ; a.audio_read_pos < write_pos; a.audio_read_pos++)
+    {
+        output.push(ring[a.audio_read_pos & mask]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* name = SHM_DEFAULT_NAME;
+    bool audio = true;
+    bool rotated = true;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if (!strcmp(argv[i], "--no-audio"))
+            audio = false;
+        else if (!strcmp(argv[i], "--no-rotate"))
+            rotated = false;
+        else if (argv[i][0] == '-')
+        {
+            printf("Usage: %s [--no-audio] [--no-rotate] [shm name]\n", argv[0]);
+            return -1;
+        }
+        else
+            name = argv[i];
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0)
+    {
+        printf("Error: %s\n", SDL_GetError());
+        return -1;
+    }
+
+    char title[128];
+    snprintf(title, sizeof(title), "F2 View - %s", name);
+    SDL_Window* window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 672, 896, SDL_WINDOW_RESIZABLE);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_ACCELERATED);
+    if (!window || !renderer)
+    {
+        printf("Error: %s\n", SDL_GetError());
+        return -1;
+    }
+
+    Attachment a;
+    SimAudioOutput output;
+    SDL_Texture* texture = nullptr;
+    int tex_w = 0, tex_h = 0;
+    std::vector<uint32_t> pixels;
+    uint32_t last_attempt = 0;
+
+    bool running = true;
+    while (running)
+    {
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+        {
+            if (event.type == SDL_QUIT) running = false;
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_r) rotated = !rotated;
+        }
+
+        if (a.header && !still_valid(a))
+        {
+            printf("Sim went away\n");
+            output.close();
+            detach(a);
+        }
+
+        if (!a.header && SDL_GetTicks() - last_attempt > 500)
+        {
+            last_attempt = SDL_GetTicks();
+            if (attach(name, a))
+            {
+                printf("Attached to %s, %ux%u\n", name, a.header->width, a.header->height);
+                if (audio) output.open(a.header->audio_rate);
+            }
+        }
+
+        if (a.header)
+        {
+            if (output.is_open()) read_audio(a, output);
+
+            if (read_frame(a, pixels))
+            {
+                if (!texture || tex_w != (int)a.header->width || tex_h != (int)a.header->height)
+                {
+                    if (texture) SDL_DestroyTexture(texture);
+                    tex_w = a.header->width;
+                    tex_h = a.header->height;
+                    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STREAMING, tex_w, tex_h);
+                }
+                SDL_UpdateTexture(texture, nullptr, pixels.data(), tex_w * sizeof(uint32_t));
+            }
+        }
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        if (texture)
+        {
+            int win_w, win_h;
+            SDL_GetRendererOutputSize(renderer, &win_w, &win_h);
+
+            // Fit the (possibly rotated) image in the window
+            int img_w = rotated ? tex_h : tex_w;
+            int img_h = rotated ? tex_w : tex_h;
+            float scale = std::min((float)win_w / img_w, (float)win_h / img_h);
+            SDL_Rect dst;
+            dst.w = (int)(tex_w * scale);
+            dst.h = (int)(tex_h * scale);
+            dst.x = (win_w - dst.w) / 2;
+            dst.y = (win_h - dst.h) / 2;
+            SDL_RenderCopyEx(renderer, texture, nullptr, &dst, rotated ? 270.0 : 0.0, nullptr, SDL_FLIP_NONE);
+        }
+        SDL_RenderPresent(renderer);
+    }
+
+    output.close();
+    detach(a);
+    if (texture) SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
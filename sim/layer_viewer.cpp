@@ -0,0 +1,246 @@
+#include <SDL.h>
+
+#include "imgui.h"
+#include "imgui_internal.h"
+#include "imgui_wrap.h"
+#include "layer_viewer.h"
+#include "tc0100scn.h"
+#include "tc0430grw.h"
+#include "tc0200obj.h"
+
+#include <chrono>
+#include <string.h>
+
+enum
+{
+    LAYER_BG0,
+    LAYER_BG1,
+    LAYER_FG0,
+    LAYER_PIVOT,
+    LAYER_SCN_MIX,
+};
+
+enum
+{
+    VIEW_PLANE,
+    VIEW_SCREEN,
+};
+
+static const int TEX_SIZE = 512;
+
+static SCNState s_scn;
+static PivotState s_pivot;
+static uint16_t s_dots[TEX_SIZE * TEX_SIZE];
+static int s_width = 0, s_height = 0;
+static double s_render_ms = 0.0;
+static SDL_Texture *s_texture = nullptr;
+
+static void render(int layer, int view, int h_adjust)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    scn_state_from_rtl(&s_scn);
+    pivot_state_from_rtl(&s_pivot);
+
+    if (view == VIEW_PLANE && layer != LAYER_SCN_MIX)
+    {
+        s_width = s_height = TEX_SIZE;
+        if (layer == LAYER_PIVOT)
+        {
+            static uint8_t plane[PIVOT_PLANE_SIZE * PIVOT_PLANE_SIZE];
+            pivot_render_plane(s_pivot, plane);
+            for( int i = 0; i < PIVOT_PLANE_SIZE * PIVOT_PLANE_SIZE; i++ )
+            {
+                s_dots[i] = pivot_palette_index(s_pivot, plane[i]);
+            }
+        }
+        else
+        {
+            scn_render_plane(s_scn, layer, s_dots);
+        }
+    }
+    else
+    {
+        s_width = SCN_SCREEN_WIDTH;
+        s_height = SCN_SCREEN_HEIGHT;
+        for( int y = 0; y < SCN_SCREEN_HEIGHT; y++ )
+        {
+            uint16_t *dest = s_dots + (y * TEX_SIZE);
+            if (layer == LAYER_PIVOT)
+            {
+                uint8_t line[PIVOT_SCREEN_WIDTH];
+                pivot_render_line(s_pivot, y, h_adjust, line);
+                for( int x = 0; x < PIVOT_SCREEN_WIDTH; x++ )
+                {
+                    dest[x] = pivot_palette_index(s_pivot, line[x]);
+                }
+            }
+            else if (layer == LAYER_SCN_MIX)
+            {
+                uint16_t lines[SCN_LAYER_COUNT][SCN_SCREEN_WIDTH];
+                for( int l = 0; l < SCN_LAYER_COUNT; l++ )
+                {
+                    scn_render_line(s_scn, l, y, h_adjust, lines[l]);
+                }
+                for( int x = 0; x < SCN_SCREEN_WIDTH; x++ )
+                {
+                    dest[x] = scn_mix(s_scn, lines[SCN_BG0][x], lines[SCN_BG1][x], lines[SCN_FG0][x]) & 0xfff;
+                }
+            }
+            else
+            {
+                scn_render_line(s_scn, layer, y, h_adjust, dest);
+            }
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    s_render_ms = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void update_texture(bool show_transparent)
+{
+    if (!s_texture)
+    {
+        s_texture = SDL_CreateTexture(imgui_get_renderer(), SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STREAMING, TEX_SIZE, TEX_SIZE);
+    }
+
+    void *work;
+    int pitch;
+    SDL_LockTexture(s_texture, nullptr, &work, &pitch);
+
+    for( int y = 0; y < s_height; y++ )
+    {
+        uint32_t *dest = (uint32_t *)((uint8_t *)work + (pitch * y));
+        const uint16_t *src = s_dots + (y * TEX_SIZE);
+        for( int x = 0; x < s_width; x++ )
+        {
+            if (src[x] & 0xf)
+                dest[x] = obj_palette_rgb(src[x]);
+            else if (show_transparent)
+                dest[x] = (((x >> 3) ^ (y >> 3)) & 1) ? 0x40404000 : 0x30303000;
+            else
+                dest[x] = 0;
+        }
+    }
+
+    SDL_UnlockTexture(s_texture);
+}
+
+// Outline of the area shown on line 0, ignoring rowscroll and colscroll
+static void draw_screen_outline(int layer, ImVec2 origin, float scale)
+{
+    bool flip = s_scn.ctrl[7] & 1;
+    if (layer == LAYER_PIVOT || layer == LAYER_SCN_MIX || flip) return;
+
+    static const int scroll_x[SCN_LAYER_COUNT] = { 0, 1, 2 };
+    static const int scroll_y[SCN_LAYER_COUNT] = { 3, 4, 5 };
+    int x0 = (SCN_H_START - s_scn.ctrl[scroll_x[layer]]) & (SCN_PLANE_SIZE - 1);
+    int y0 = (SCN_V_START - s_scn.ctrl[scroll_y[layer]]) & (SCN_PLANE_SIZE - 1);
+
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+    for( int wy = -1; wy <= 0; wy++ )
+    {
+        for( int wx = -1; wx <= 0; wx++ )
+        {
+            float x = origin.x + ((x0 + (wx * SCN_PLANE_SIZE)) * scale);
+            float y = origin.y + ((y0 + (wy * SCN_PLANE_SIZE)) * scale);
+            draw_list->PushClipRect(origin, ImVec2(origin.x + (SCN_PLANE_SIZE * scale), origin.y + (SCN_PLANE_SIZE * scale)), true);
+            draw_list->AddRect(ImVec2(x, y), ImVec2(x + (SCN_SCREEN_WIDTH * scale), y + (SCN_SCREEN_HEIGHT * scale)), IM_COL32(255, 255, 0, 255));
+            draw_list->PopClipRect();
+        }
+    }
+}
+
+static void draw_tooltip(int layer, int view, int x, int y)
+{
+    uint16_t dot = s_dots[(y * TEX_SIZE) + x];
+
+    ImGui::BeginTooltip();
+    ImGui::Text("X: %d Y: %d", x, y);
+    ImGui::Text("Dot: %03X", dot);
+    if (view == VIEW_PLANE && layer != LAYER_SCN_MIX)
+    {
+        int tile = ((y >> 3) * 64) + (x >> 3);
+        ImGui::Text("Tile: %d,%d", x >> 3, y >> 3);
+        if (layer == LAYER_PIVOT)
+        {
+            ImGui::Text("Code: %04X", s_pivot.ram[tile]);
+        }
+        else if (layer == LAYER_FG0)
+        {
+            ImGui::Text("Code: %04X", s_scn.ram[0x2000 + tile]);
+        }
+        else
+        {
+            uint32_t map = layer == LAYER_BG0 ? 0x0000 : 0x4000;
+            ImGui::Text("Attrib: %04X Code: %04X", s_scn.ram[map + (tile * 2)], s_scn.ram[map + (tile * 2) + 1]);
+        }
+    }
+    ImGui::EndTooltip();
+}
+
+void draw_layer_window()
+{
+    static int layer = LAYER_BG0;
+    static int view = VIEW_PLANE;
+    static int h_adjust = 0;
+    static bool live = true;
+    static bool show_transparent = true;
+    static bool dirty = true;
+
+    if( !ImGui::Begin("Layers") )
+    {
+        ImGui::End();
+        return;
+    }
+
+    dirty |= ImGui::Combo("Layer", &layer, "BG0\0BG1\0FG0\0Pivot\0SCN Mix\0");
+    dirty |= ImGui::Combo("View", &view, "Plane\0Screen\0");
+    dirty |= ImGui::SliderInt("H Adjust", &h_adjust, -16, 16);
+    dirty |= ImGui::Checkbox("Show Transparent", &show_transparent);
+    ImGui::SameLine();
+    ImGui::Checkbox("Live", &live);
+    ImGui::SameLine();
+    dirty |= ImGui::Button("Refresh");
+
+    if (live || dirty)
+    {
+        render(layer, view, h_adjust);
+        update_texture(show_transparent);
+        dirty = false;
+    }
+
+    ImGui::Text("SCN ctrl: %04X %04X %04X %04X %04X %04X %04X %04X",
+                s_scn.ctrl[0], s_scn.ctrl[1], s_scn.ctrl[2], s_scn.ctrl[3],
+                s_scn.ctrl[4], s_scn.ctrl[5], s_scn.ctrl[6], s_scn.ctrl[7]);
+    ImGui::Text("Pivot ctrl: %04X %04X %04X %04X %04X %04X %04X %04X",
+                s_pivot.ctrl[0], s_pivot.ctrl[1], s_pivot.ctrl[2], s_pivot.ctrl[3],
+                s_pivot.ctrl[4], s_pivot.ctrl[5], s_pivot.ctrl[6], s_pivot.ctrl[7]);
+    ImGui::Text("Render: %.2f ms", s_render_ms);
+
+    if (s_texture)
+    {
+        ImVec2 avail = ImGui::GetContentRegionAvail();
+        float scale = avail.x / s_width;
+        if (scale < 1.0f) scale = 1.0f;
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::Image((ImTextureID)s_texture, ImVec2(s_width * scale, s_height * scale), ImVec2(0, 0),
+                     ImVec2((float)s_width / TEX_SIZE, (float)s_height / TEX_SIZE));
+
+        if (view == VIEW_PLANE) draw_screen_outline(layer, origin, scale);
+
+        if (ImGui::IsItemHovered())
+        {
+            ImVec2 mouse = ImGui::GetMousePos();
+            int x = (int)((mouse.x - origin.x) / scale);
+            int y = (int)((mouse.y - origin.y) / scale);
+            if (x >= 0 && x < s_width && y >= 0 && y < s_height)
+            {
+                draw_tooltip(layer, view, x, y);
+            }
+        }
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,8 @@
+#if !defined(LAYER_VIEWER_H)
+#define LAYER_VIEWER_H 1
+
+// Renders the TC0100SCN and TC0430GRW layers from the C++ models, either
+// as whole planes or as they would appear on screen
+void draw_layer_window();
+
+#endif // LAYER_VIEWER_H
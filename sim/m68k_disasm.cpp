@@ -0,0 +1,546 @@
+#include <SDL.h>
+
+#include "imgui.h"
+#include "imgui_internal.h"
+#include "imgui_wrap.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include "m68k_disasm.h"
+#include "sim_sdram.h"
+#include "games.h"
+#include "dis68k/dis68k.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+extern F2* top;
+
+// Upper bound on the CPU ROM region that is decoded. The actual extent
+// is found by trimming unused space from the end.
+static const uint32_t ROM_REGION_MAX = 0x400000;
+static const uint32_t VECTOR_TABLE_SIZE = 0x400;
+
+enum LineKind : uint8_t
+{
+    LINE_LABEL,
+    LINE_CODE,
+    LINE_DATA
+};
+
+struct DisasmLine
+{
+    uint32_t addr;
+    uint16_t size;
+    LineKind kind;
+    uint32_t text; // offset into s_text
+};
+
+static std::map<uint32_t, std::string> s_symbols;
+static std::unordered_map<std::string, uint32_t> s_symbol_addrs;
+static bool s_symbols_changed = false;
+static std::string s_symbol_file;
+
+static std::vector<DisasmLine> s_lines;
+static std::vector<char> s_text;
+static size_t s_text_unused = 0;          // bytes of s_text no longer referenced by a line
+static std::vector<int32_t> s_line_index; // line for each 16-bit word of ROM
+static const uint8_t *s_rom = nullptr;
+static uint32_t s_rom_size = 0;
+static uint32_t s_generation = ~0u;
+
+static uint32_t read_be32(const uint8_t *p)
+{
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint16_t read_be16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static void add_symbol(uint32_t addr, const char *name)
+{
+    if (name[0] == '\0' || name[0] == '.' || name[0] == '$') return;
+
+    s_symbols.emplace(addr, name);
+    s_symbol_addrs.emplace(name, addr);
+}
+
+static int load_elf_symbols(const std::vector<uint8_t>& elf)
+{
+    // 32-bit, big-endian only
+    if (elf.size() < 52 || elf[4] != 1 || elf[5] != 2) return -1;
+
+    uint32_t shoff = read_be32(&elf[32]);
+    uint16_t shentsize = read_be16(&elf[46]);
+    uint16_t shnum = read_be16(&elf[48]);
+
+    if (shentsize < 40 || shoff + (size_t)shnum * shentsize > elf.size()) return -1;
+
+    int count = 0;
+    for( int i = 0; i < shnum; i++ )
+    {
+        const uint8_t *sh = &elf[shoff + i * shentsize];
+        uint32_t type = read_be32(sh + 4);
+        if (type != 2) continue; // SHT_SYMTAB
+
+        uint32_t offset = read_be32(sh + 16);
+        uint32_t size = read_be32(sh + 20);
+        uint32_t link = read_be32(sh + 24);
+        if (link >= shnum || offset + size > elf.size()) continue;
+
+        const uint8_t *strsh = &elf[shoff + link * shentsize];
+        uint32_t str_offset = read_be32(strsh + 16);
+        uint32_t str_size = read_be32(strsh + 20);
+        if (str_offset + str_size > elf.size()) continue;
+
+        for( uint32_t ofs = 0; ofs + 16 <= size; ofs += 16 )
+        {
+            const uint8_t *sym = &elf[offset + ofs];
+            uint32_t name = read_be32(sym + 0);
+            uint32_t value = read_be32(sym + 4);
+            uint8_t sym_type = sym[12] & 0xf;
+            uint16_t shndx = read_be16(sym + 14);
+
+            // Skip undefined, section and file symbols
+            if (shndx == 0 || sym_type == 3 || sym_type == 4) continue;
+            if (name >= str_size) continue;
+
+            const char *sym_name = (const char *)&elf[str_offset + name];
+            if (memchr(sym_name, 0, str_size - name) == nullptr) continue;
+
+            add_symbol(value, sym_name);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static bool is_symbol_name(const char *s)
+{
+    if (!isalpha((unsigned char)s[0]) && s[0] != '_') return false;
+    for( ; *s; s++ )
+    {
+        if (!isalnum((unsigned char)*s) && *s != '_' && *s != '.') return false;
+    }
+    return true;
+}
+
+// Accepts both "00001234 T name" (nm) and "0x00001234    name" (ld map) lines
+static int load_text_symbols(const std::vector<uint8_t>& data)
+{
+    std::string text(data.begin(), data.end());
+    int count = 0;
+
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos) eol = text.size();
+        std::string line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        char *tokens[4];
+        int num_tokens = 0;
+        char *save = nullptr;
+        for( char *tok = strtok_r(&line[0], " \t\r", &save); tok && num_tokens < 4; tok = strtok_r(nullptr, " \t\r", &save) )
+        {
+            tokens[num_tokens++] = tok;
+        }
+
+        const char *name;
+        if (num_tokens == 2)
+            name = tokens[1];
+        else if (num_tokens == 3 && strlen(tokens[1]) == 1)
+            name = tokens[2];
+        else
+            continue;
+
+        char *end;
+        unsigned long long addr = strtoull(tokens[0], &end, 16);
+        if (*end != '\0' || !is_symbol_name(name)) continue;
+
+        add_symbol((uint32_t)addr, name);
+        count++;
+    }
+
+    return count;
+}
+
+int load_68k_symbols(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == nullptr)
+    {
+        printf("Failed to open symbol file: %s\n", filename);
+        return -1;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(fp);
+
+    s_symbols.clear();
+    s_symbol_addrs.clear();
+
+    int count;
+    if (data.size() >= 4 && memcmp(data.data(), "\x7f" "ELF", 4) == 0)
+        count = load_elf_symbols(data);
+    else
+        count = load_text_symbols(data);
+
+    s_symbols_changed = true;
+    s_symbol_file = filename;
+
+    printf("Loaded %d symbols from %s\n", count, filename);
+    return count;
+}
+
+const char *find_68k_symbol(uint32_t addr)
+{
+    auto it = s_symbols.find(addr);
+    if (it == s_symbols.end()) return nullptr;
+    return it->second.c_str();
+}
+
+bool find_68k_symbol_addr(const char *name, uint32_t *addr)
+{
+    auto it = s_symbol_addrs.find(name);
+    if (it == s_symbol_addrs.end()) return false;
+    *addr = it->second;
+    return true;
+}
+
+// Append "  ; symbol" for the first absolute address in the operands that has a symbol
+static void annotate(char *str, size_t len)
+{
+    for( const char *p = strchr(str, '$'); p != nullptr; p = strchr(p + 1, '$') )
+    {
+        int digits = 0;
+        while (digits < 8 && isxdigit((unsigned char)p[1 + digits])) digits++;
+        if (digits != 8 || isxdigit((unsigned char)p[9])) continue;
+
+        const char *sym = find_68k_symbol((uint32_t)strtoul(p + 1, nullptr, 16));
+        if (sym)
+        {
+            size_t used = strlen(str);
+            snprintf(str + used, len - used, "  ; %s", sym);
+            return;
+        }
+    }
+}
+
+static void add_line(std::vector<DisasmLine>& lines, uint32_t addr, uint16_t size, LineKind kind, const char *text)
+{
+    DisasmLine line;
+    line.addr = addr;
+    line.size = size;
+    line.kind = kind;
+    line.text = s_text.size();
+    s_text.insert(s_text.end(), text, text + strlen(text) + 1);
+    lines.push_back(line);
+}
+
+static void add_label(std::vector<DisasmLine>& lines, uint32_t addr)
+{
+    const char *sym = find_68k_symbol(addr);
+    if (sym == nullptr) return;
+
+    char label[256];
+    snprintf(label, sizeof(label), "%s:", sym);
+    add_line(lines, addr, 0, LINE_LABEL, label);
+}
+
+static void add_data_word(std::vector<DisasmLine>& lines, uint32_t addr)
+{
+    char text[64];
+    snprintf(text, sizeof(text), "DC.W     $%04X", read_be16(s_rom + addr));
+    add_line(lines, addr, 2, LINE_DATA, text);
+}
+
+// Decode one instruction (or vector) at addr, returns its size in bytes
+static uint32_t decode_at(std::vector<DisasmLine>& lines, uint32_t addr)
+{
+    char text[192];
+
+    if (addr < VECTOR_TABLE_SIZE && (addr & 3) == 0)
+    {
+        snprintf(text, sizeof(text), "DC.L     $%08X", read_be32(s_rom + addr));
+        annotate(text, sizeof(text));
+        add_line(lines, addr, 4, LINE_DATA, text);
+        return 4;
+    }
+
+    Dis68k dis(s_rom + addr, s_rom + s_rom_size, addr);
+    uint32_t inst_addr;
+    if (!dis.disasm(&inst_addr, text, sizeof(text)) || dis.next_address() <= addr)
+    {
+        add_data_word(lines, addr);
+        return 2;
+    }
+
+    size_t len = strlen(text);
+    while (len > 0 && isspace((unsigned char)text[len - 1])) text[--len] = '\0';
+    annotate(text, sizeof(text));
+
+    uint32_t size = dis.next_address() - addr;
+    add_line(lines, addr, size, LINE_CODE, text);
+    return size;
+}
+
+static void rebuild_index()
+{
+    s_line_index.assign(s_rom_size / 2, -1);
+    for( size_t i = 0; i < s_lines.size(); i++ )
+    {
+        const DisasmLine& line = s_lines[i];
+        for( uint32_t a = line.addr; a < line.addr + line.size && a < s_rom_size; a += 2 )
+        {
+            s_line_index[a >> 1] = (int32_t)i;
+        }
+    }
+}
+
+// Drop the text of lines replaced by resync once it is most of the buffer
+static void compact_text()
+{
+    if (s_text_unused < s_text.size() / 2) return;
+
+    std::vector<char> text;
+    text.reserve(s_text.size() - s_text_unused);
+    for( DisasmLine& line : s_lines )
+    {
+        const char *str = &s_text[line.text];
+        line.text = text.size();
+        text.insert(text.end(), str, str + strlen(str) + 1);
+    }
+    s_text.swap(text);
+    s_text_unused = 0;
+}
+
+static void rebuild_cache()
+{
+    s_rom = sdram.data + CPU_ROM_SDR_BASE;
+
+    // Trim unprogrammed space from the end of the region
+    uint32_t size = ROM_REGION_MAX;
+    while (size > VECTOR_TABLE_SIZE && (s_rom[size - 1] == 0x00 || s_rom[size - 1] == 0xff))
+    {
+        size--;
+    }
+    s_rom_size = (size + 0xff) & ~0xff;
+
+    s_lines.clear();
+    s_text.clear();
+    s_text_unused = 0;
+
+    uint32_t addr = 0;
+    while (addr < s_rom_size)
+    {
+        add_label(s_lines, addr);
+        addr += decode_at(s_lines, addr);
+    }
+
+    rebuild_index();
+
+    s_generation = sdram.generation;
+    s_symbols_changed = false;
+}
+
+// Linear decoding can go out of step with the real instruction stream when it
+// passes over data. If the CPU is executing from the middle of a decoded
+// instruction, redecode from there until we fall back in line.
+static void resync(uint32_t pc)
+{
+    int32_t first = s_line_index[pc >> 1];
+    if (first < 0 || s_lines[first].addr == pc) return;
+
+    std::vector<DisasmLine> patch;
+    for( uint32_t a = s_lines[first].addr; a < pc; a += 2 )
+    {
+        add_data_word(patch, a);
+    }
+
+    uint32_t addr = pc;
+    size_t last = s_lines.size();
+    while (addr < s_rom_size)
+    {
+        int32_t li = s_line_index[addr >> 1];
+        if (li > first && s_lines[li].addr == addr)
+        {
+            last = li;
+            break;
+        }
+        add_label(patch, addr);
+        addr += decode_at(patch, addr);
+    }
+
+    // Keep any labels belonging to the line we resynchronized on
+    while (last > (size_t)first && s_lines[last - 1].kind == LINE_LABEL) last--;
+
+    for( size_t i = first; i < last; i++ )
+    {
+        s_text_unused += strlen(&s_text[s_lines[i].text]) + 1;
+    }
+
+    // Words up to the first line kept now belong to the patch, everything
+    // after it only moves by the difference in line count
+    uint32_t end = last < s_lines.size() ? s_lines[last].addr : s_rom_size;
+    int32_t shift = (int32_t)patch.size() - (int32_t)(last - first);
+
+    s_lines.erase(s_lines.begin() + first, s_lines.begin() + last);
+    s_lines.insert(s_lines.begin() + first, patch.begin(), patch.end());
+
+    for( size_t i = first; i < first + patch.size(); i++ )
+    {
+        const DisasmLine& line = s_lines[i];
+        for( uint32_t a = line.addr; a < line.addr + line.size && a < end; a += 2 )
+        {
+            s_line_index[a >> 1] = (int32_t)i;
+        }
+    }
+
+    if (shift != 0)
+    {
+        for( uint32_t w = end >> 1; w < s_rom_size / 2; w++ )
+        {
+            if (s_line_index[w] >= 0) s_line_index[w] += shift;
+        }
+    }
+
+    compact_text();
+}
+
+static int32_t line_for_addr(uint32_t addr)
+{
+    addr &= ~1;
+    if (addr >= s_rom_size) return -1;
+    int32_t line = s_line_index[addr >> 1];
+
+    // Include the label, if any
+    while (line > 0 && s_lines[line - 1].kind == LINE_LABEL && s_lines[line - 1].addr == addr) line--;
+    return line;
+}
+
+void draw_68k_window()
+{
+    static bool follow_pc = true;
+    static char goto_text[64] = "";
+    static char symbol_file[256] = "";
+    static uint32_t last_pc = ~0u;
+    static int32_t scroll_to_line = -1;
+
+    if (!ImGui::Begin("68000"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (s_generation != sdram.generation || s_symbols_changed)
+    {
+        rebuild_cache();
+        last_pc = ~0u;
+    }
+
+    uint32_t pc = top->rootp->F2__DOT__m68000__DOT__excUnit__DOT__PcL |
+        (top->rootp->F2__DOT__m68000__DOT__excUnit__DOT__PcH << 16);
+    auto pc_sym = s_symbols.upper_bound(pc);
+    ImGui::LabelText("PC", "%08X %s", pc, pc_sym != s_symbols.begin() ? std::prev(pc_sym)->second.c_str() : "");
+
+    ImGui::Checkbox("Follow PC", &follow_pc);
+    ImGui::SameLine();
+    ImGui::PushItemWidth(160);
+    if (ImGui::InputText("Goto", goto_text, sizeof(goto_text), ImGuiInputTextFlags_EnterReturnsTrue))
+    {
+        uint32_t addr;
+        if (!find_68k_symbol_addr(goto_text, &addr))
+        {
+            addr = strtoul(goto_text, nullptr, 16);
+        }
+        scroll_to_line = line_for_addr(addr);
+        follow_pc = false;
+    }
+    ImGui::PopItemWidth();
+
+    if (symbol_file[0] == '\0' && !s_symbol_file.empty())
+    {
+        strncpy(symbol_file, s_symbol_file.c_str(), sizeof(symbol_file) - 1);
+    }
+    ImGui::InputText("##symfile", symbol_file, sizeof(symbol_file));
+    ImGui::SameLine();
+    if (ImGui::Button("Load Symbols"))
+    {
+        load_68k_symbols(symbol_file);
+    }
+    ImGui::SameLine();
+    ImGui::Text("%zu symbols", s_symbols.size());
+
+    if (follow_pc && pc != last_pc && (pc & 1) == 0 && pc < s_rom_size)
+    {
+        resync(pc);
+        scroll_to_line = line_for_addr(pc);
+    }
+    last_pc = pc;
+
+    ImGui::BeginChild("disasm", ImVec2(0, 0), true);
+
+    const float line_height = ImGui::GetTextLineHeightWithSpacing();
+    if (scroll_to_line >= 0)
+    {
+        // Only scroll when the line is out of view so following the PC doesn't jitter
+        float y = scroll_to_line * line_height;
+        float view_top = ImGui::GetScrollY();
+        float view_height = ImGui::GetWindowHeight();
+        if (y < view_top || y + line_height > view_top + view_height)
+        {
+            ImGui::SetScrollY(y - view_height * 0.3f);
+        }
+        scroll_to_line = -1;
+    }
+
+    int32_t pc_line = (pc & 1) == 0 && pc < s_rom_size ? s_line_index[pc >> 1] : -1;
+
+    ImGuiListClipper clipper;
+    clipper.Begin((int)s_lines.size(), line_height);
+    while (clipper.Step())
+    {
+        for( int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++ )
+        {
+            const DisasmLine& line = s_lines[i];
+            const char *text = &s_text[line.text];
+
+            if (line.kind == LINE_LABEL)
+            {
+                ImGui::TextColored(ImVec4(0.4f, 0.8f, 1.0f, 1.0f), "%s", text);
+            }
+            else if (i == pc_line)
+            {
+                ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.3f, 1.0f), "%06X> %s", line.addr, text);
+            }
+            else if (line.kind == LINE_DATA)
+            {
+                ImGui::TextDisabled("%06X  %s", line.addr, text);
+            }
+            else
+            {
+                ImGui::Text("%06X  %s", line.addr, text);
+            }
+        }
+    }
+
+    ImGui::EndChild();
+    ImGui::End();
+}
@@ -0,0 +1,18 @@
+#if !defined(M68K_DISASM_H)
+#define M68K_DISASM_H 1
+
+#include <stdint.h>
+
+// Load symbols from an m68k ELF or a text symbol/map file (nm output or
+// GNU ld map). Returns the number of symbols loaded, or -1 on error.
+int load_68k_symbols(const char *filename);
+
+// Name of the symbol at exactly addr, or nullptr
+const char *find_68k_symbol(uint32_t addr);
+
+// Address of the named symbol, returns false if not found
+bool find_68k_symbol_addr(const char *name, uint32_t *addr);
+
+void draw_68k_window();
+
+#endif // M68K_DISASM_H
@@ -6,13 +6,31 @@
 
 #include "imgui_wrap.h"
 #include "imgui_memory_editor.h"
+#include "sim.h"
 #include "sim_sdram.h"
 #include "sim_video.h"
+#include "sim_video_timing.h"
 #include "sim_ddr.h"
 #include "sim_state.h"
+#include "sim_rewind.h"
+#include "sim_ram_history.h"
+#include "sim_checkpoint.h"
+#include "sim_checkpoint_cache.h"
+#include "sim_input.h"
+#include "sim_audio.h"
+#include "sim_capture.h"
+#include "sim_shm.h"
+#include "sim_memory_view.h"
+#include "sim_cheats.h"
+#include "sim_bus_log.h"
+#include "sim_cpu_usage.h"
+#include "sim_irq_latency.h"
+#include "sim_obj_budget.h"
 #include "tc0200obj.h"
+#include "tc0200obj_render.h"
 #include "tc0360pri.h"
-#include "dis68k/dis68k.h"
+#include "layer_viewer.h"
+#include "m68k_disasm.h"
 #include "games.h"
 
 #include <stdio.h>
@@ -21,6 +39,9 @@
 #include <string>
 #include <algorithm>
 #include <cstring>
+#include <chrono>
+#include <csignal>
+#include <unistd.h>
 
 VerilatedContext *contextp;
 F2 *top;
@@ -29,13 +50,24 @@ std::unique_ptr<VerilatedFstC> tfp;
 SimSDRAM sdram(128 * 1024 * 1024);
 SimDDR ddr_memory(16 * 1024 * 1024);
 SimVideo video;
+SimVideoTiming video_timing;
 SimState* state_manager = nullptr;
-
-#define NUM_SAMPLES (5 * 1024 * 1024)
-int16_t audio_samples[NUM_SAMPLES];
-int audio_sample_index = 0;
+SimRewind* rewind_manager = nullptr;
+SimRamHistory* ram_history = nullptr;
+SimCheckpointCache* checkpoint_cache = nullptr;
+SimInput* input_manager = nullptr;
+
+SimAudioCapture audio_capture;
+SimAudioOutput audio_output;
+SimFrameCapture frame_capture;
+SimShm shm_export;
+SimBusLog bus_log(1024 * 1024);
+SimCpuUsage cpu_usage;
+SimIrqLatency irq_latency;
+SimObjBudget obj_budget;
 
 uint64_t total_ticks = 0;
+uint64_t total_frames = 0;
 
 bool trace_active = false;
 char trace_filename[64];
@@ -47,6 +79,7 @@ int simulation_step_size = 100000;
 bool simulation_step_vblank = false;
 uint64_t simulation_reset_until = 100;
 bool system_pause = false;
+bool sync_fix = false;
 
 bool simulation_wp_set = false;
 int simulation_wp_addr = 0;
@@ -54,7 +87,22 @@ int simulation_wp_addr = 0;
 uint32_t dipswitch_a = 0;
 uint32_t dipswitch_b = 0;
 
-bool prev_audio_sample = 0;
+int rewind_interval = 0;
+int rewind_memory_mb = 64;
+int history_memory_mb = 256;
+int checkpoint_interval = 600;
+int checkpoint_cache_mb = 2048;
+
+// True while the current run follows on from power on, or from a cached
+// checkpoint of such a run, with no state loaded, in-session reset or
+// inputs changed. Only then can it be added to the checkpoint cache.
+bool timeline_from_reset = true;
+
+bool goto_frame_active = false;
+uint64_t goto_frame_target = 0;
+
+bool prev_vblank = false;
+static bool rewind_capturing = false;
 void sim_tick(int count = 1)
 {
     for( int i = 0; i < count; i++ )
@@ -75,20 +123,11 @@ void sim_tick(int count = 1)
         sdram.update_channel_16(top->sdr_audio_addr, top->sdr_audio_req, 1, 0, 0, &top->sdr_audio_q, &top->sdr_audio_ack);
         sdram.update_channel_16(top->sdr_pivot_addr, top->sdr_pivot_req, 1, 0, 0, &top->sdr_pivot_q, &top->sdr_pivot_ack);
         video.clock(top->ce_pixel != 0, top->hblank != 0, top->vblank != 0, top->red, top->green, top->blue);
+        video_timing.clock(total_ticks, top->ce_pixel != 0, top->hblank != 0, top->vblank != 0, top->hsync != 0, top->vsync != 0);
         
         // Process memory stream operations
         ddr_memory.clock(top->ddr_addr, top->ddr_wdata, top->ddr_rdata, top->ddr_read, top->ddr_write, top->ddr_busy, top->ddr_read_complete, top->ddr_burstcnt, top->ddr_byteenable);
 
-        /*
-        if (top->audio_sample == 1 && prev_audio_sample == false)
-        {
-            audio_samples[audio_sample_index + 0] = top->audio_left;
-            audio_samples[audio_sample_index + 1] = top->audio_right;
-            audio_sample_index = (audio_sample_index + 2) % NUM_SAMPLES;
-        }
-
-        prev_audio_sample = top->audio_sample == 1;
-*/
         contextp->timeInc(1);
         top->clk = 0;
 
@@ -101,6 +140,56 @@ void sim_tick(int count = 1)
         top->eval();
         if (tfp) tfp->dump(contextp->time());
 
+        // audio_out updates on the mixer sample enable
+        if (top->rootp->F2__DOT__audio_mix__DOT__ce)
+        {
+            audio_capture.push(top->audio_out);
+            audio_output.push(top->audio_out);
+            shm_export.push_audio(top->audio_out);
+        }
+
+        if (obj_compare_active) obj_compare_tick();
+        if (pri_capture_active) pri_capture_tick();
+        // The savestate handler a rewind capture runs is not game work
+        if (!rewind_capturing)
+        {
+            bus_log.tick();
+            cpu_usage.tick();
+            irq_latency.tick();
+            obj_budget.tick();
+        }
+
+        bool frame_edge = top->vblank && !prev_vblank;
+        prev_vblank = top->vblank != 0;
+
+        if (frame_edge)
+        {
+            total_frames++;
+            input_manager->on_frame(total_frames);
+            ram_history->record(total_frames);
+            bus_log.frame(total_frames);
+            cpu_usage.frame(total_frames);
+            irq_latency.frame(total_frames);
+            // Rewind captures run the savestate machine, which ticks the sim,
+            // so they happen here for every run mode and before the checkpoint
+            // that includes their effect. Neither can start in the middle of
+            // another save or restore. The capture interrupts the CPU, so the
+            // instrumentation picks up again from the state after it.
+            bool state_busy = rewind_capturing || top->ss_do_save || top->ss_do_restore || top->ss_state_out;
+            if (!state_busy && total_ticks >= simulation_reset_until)
+            {
+                if (rewind_manager->due(total_frames))
+                {
+                    rewind_capturing = true;
+                    rewind_manager->update(total_frames);
+                    rewind_capturing = false;
+                    sim_state_restored();
+                }
+
+                if (timeline_from_reset) checkpoint_cache->update(total_frames);
+            }
+        }
+
         if (simulation_wp_set && top->rootp->F2__DOT__cpu_word_addr == simulation_wp_addr)
         {
             simulation_run = false;
@@ -110,6 +199,62 @@ void sim_tick(int count = 1)
     }
 }
 
+// Reset the core and start counting frames again. Only the reset input is
+// asserted, SDRAM refresh timing, RAM and DDR contents carry over, so the
+// run that follows is not the one from power on and is never cached. Use
+// sim_power_on() for a run that should match one from startup.
+void sim_reset()
+{
+    simulation_reset_until = total_ticks + 100;
+    total_frames = 0;
+    timeline_from_reset = false;
+    rewind_manager->clear();
+    input_manager->on_frame(0);
+}
+
+// Native checkpoint of the model before its first tick. Restoring it is a
+// power on, the model, core-writable DDR and harness counters all go back
+// to where this session started, so the run that follows can be cached.
+static char power_on_checkpoint[64] = "";
+
+static void save_power_on_checkpoint()
+{
+    strcpy(power_on_checkpoint, "/tmp/f2sim-poweron-XXXXXX");
+    int fd = mkstemp(power_on_checkpoint);
+    if (fd >= 0)
+    {
+        close(fd);
+        if (save_checkpoint(power_on_checkpoint)) return;
+        remove(power_on_checkpoint);
+    }
+
+    printf("Failed to save the power on checkpoint, movies and go to frame will not be cached\n");
+    power_on_checkpoint[0] = '\0';
+}
+
+// Restart from power on, or reset the core if there is no power on
+// checkpoint to restore
+void sim_power_on()
+{
+    if (!power_on_checkpoint[0] || !restore_checkpoint(power_on_checkpoint))
+    {
+        sim_reset();
+        return;
+    }
+
+    timeline_from_reset = true;
+    rewind_manager->clear();
+    input_manager->on_frame(0);
+}
+
+void sim_state_restored()
+{
+    bus_log.resync();
+    cpu_usage.resync();
+    obj_budget.resync();
+    irq_latency.resync();
+}
+
 void sim_tick_until(std::function<bool()> until)
 {
     while(!until())
@@ -119,51 +264,199 @@ void sim_tick_until(std::function<bool()> until)
 }
 
 #define blockram_16_rw(instance, size) \
-ImU8 instance##_read(const ImU8* , size_t off, void*) \
-{ \
-    size_t word_off = off >> 1; \
-    if (off & 1) \
-        return top->rootp->F2__DOT__##instance##__DOT__ram_l[word_off]; \
-    else \
-        return top->rootp->F2__DOT__##instance##__DOT__ram_h[word_off]; \
-} \
-void instance##_write(ImU8* , size_t off, ImU8 d, void*) \
-{ \
-    size_t word_off = off >> 1; \
-    if (off & 1) \
-        top->rootp->F2__DOT__##instance##__DOT__ram_l[word_off] = d; \
-    else \
-        top->rootp->F2__DOT__##instance##__DOT__ram_h[word_off] = d; \
-} \
-class instance##_Editor : public MemoryEditor \
-{ \
-public: \
-    instance##_Editor() : MemoryEditor() \
-    { \
-        ReadFn = instance##_read; \
-        WriteFn = instance##_write; \
-    } \
-    void DrawContents() \
-    { \
-        MemoryEditor::DrawContents(nullptr, size); \
-    } \
-}; \
-instance##_Editor instance;
+static uint8_t *instance##_high() { return top->rootp->F2__DOT__##instance##__DOT__ram_h.m_storage; } \
+static uint8_t *instance##_low() { return top->rootp->F2__DOT__##instance##__DOT__ram_l.m_storage; } \
+SimMemoryView instance(instance##_high, instance##_low, size);
 
 blockram_16_rw(scn_ram_0, 64 * 1024);
-blockram_16_rw(color_ram, 8 * 1024);
+blockram_16_rw(color_ram, 32 * 1024);
 blockram_16_rw(obj_ram, 64 * 1024);
 blockram_16_rw(work_ram, 64 * 1024);
 blockram_16_rw(pivot_ram, 8 * 1024);
 
+static uint8_t *sound_ram_data() { return top->rootp->F2__DOT__sound_ram__DOT__ram.m_storage; }
+
+static int history_scn_ram_0, history_color_ram, history_obj_ram, history_work_ram, history_sound_ram;
+
+SimCheatFinder cheat_finder;
+
+// Checkpoint cache key for the current input source. Rewind captures run
+// the savestate machine on every interval'th frame edge, which shifts
+// timing, so the interval is part of the key along with the inputs.
+static uint64_t checkpoint_key_inputs()
+{
+    uint64_t inputs = input_manager->playing() ? input_manager->movie_hash()
+                                               : ((uint64_t)sync_fix << 16) | ((dipswitch_b & 0xff) << 8) | (dipswitch_a & 0xff);
+    return inputs ^ ((uint64_t)rewind_manager->interval << 48);
+}
+
+static volatile sig_atomic_t headless_quit = 0;
+
+static void headless_signal(int)
+{
+    headless_quit = 1;
+}
+
+// Measurements from a headless run as JSON
+static bool write_headless_json(const char *filename)
+{
+    FILE *fp = fopen(filename, "w");
+    if (!fp)
+    {
+        printf("Failed to open %s\n", filename);
+        return false;
+    }
+
+    fprintf(fp, "{\n  \"frames\": %llu,\n  \"ticks\": %llu,\n  \"interrupts\": ",
+            (unsigned long long)total_frames, (unsigned long long)total_ticks);
+    irq_latency.write_json(fp, "  ");
+    fprintf(fp, "\n}\n");
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    if (!ok) printf("Failed to write %s\n", filename);
+    return ok;
+}
+
+// Run without a window until interrupted, or for a number of frames if
+// frame_count is non-zero. Frames and audio are only visible through the
+// shared memory export, measurements are printed at the end and written
+// to json_filename if set. A non-zero rewind_frames rewinds that far at the
+// end and runs back up to the same frame.
+static void run_headless(uint64_t frame_count, int rewind_frames, const char *json_filename)
+{
+    signal(SIGINT, headless_signal);
+    signal(SIGTERM, headless_signal);
+
+    if (frame_count)
+        printf("Running headless for %llu frames\n", (unsigned long long)frame_count);
+    else
+        printf("Running headless, Ctrl-C to stop\n");
+
+    // Frames are counted on the vblank edge like inputs, movies, checkpoints
+    // and go to frame, so frame N here is the same frame as in the GUI
+    const uint64_t end_frame = total_frames + frame_count;
+    while (!headless_quit && (!frame_count || total_frames < end_frame))
+    {
+        input_manager->poll(dipswitch_a & 0xff, dipswitch_b & 0xff, sync_fix);
+        video_timing.set_config(top->game, top->sync_fix);
+
+        uint64_t frame = total_frames;
+        sim_tick_until([&] { return headless_quit || total_frames != frame; });
+    }
+
+    if (rewind_frames && !headless_quit)
+    {
+        uint64_t end = total_frames;
+        int64_t frame = rewind_manager->rewind(total_frames, rewind_frames);
+        if (frame < 0)
+        {
+            printf("Rewind of %d frames from %llu failed, states cover frames %llu-%llu\n", rewind_frames,
+                   (unsigned long long)end, (unsigned long long)rewind_manager->oldest_frame(),
+                   (unsigned long long)rewind_manager->newest_frame());
+        }
+        else
+        {
+            printf("Rewound to frame %lld, running to frame %llu\n", (long long)frame, (unsigned long long)end);
+            total_frames = frame;
+            timeline_from_reset = false;
+            sim_tick_until([&] { return headless_quit || total_frames >= end; });
+        }
+    }
+
+    printf("Stopped at frame %llu, tick %llu\n", (unsigned long long)total_frames, (unsigned long long)total_ticks);
+    bus_log.print_summary();
+    cpu_usage.print_summary();
+    irq_latency.print_summary();
+    obj_budget.print_summary();
+    if (video_timing.valid())
+    {
+        const VideoTiming& t = video_timing.timing();
+        printf("Video %dx%d of %dx%d, %llu ticks per frame (%.4f Hz)\n", t.hactive, t.vactive, t.htotal, t.vtotal,
+               (unsigned long long)t.ticks, video_timing.frame_rate());
+    }
+
+    if (json_filename) write_headless_json(json_filename);
+}
+
 int main(int argc, char **argv)
 {
     const char *game_name = "finalb";
+    const char *movie_filename = nullptr;
+    const char *shm_name = nullptr;
+    bool headless = false;
+    uint64_t headless_frames = 0;
+    int headless_rewind = 0;
+    const char *json_filename = nullptr;
     char title[64];
 
-    if (argc == 2)
+    for( int i = 1; i < argc; i++ )
     {
-        game_name = argv[1];
+        if (!strcmp(argv[i], "--rewind-interval") && i + 1 < argc)
+        {
+            rewind_interval = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--rewind") && i + 1 < argc)
+        {
+            headless_rewind = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--rewind-memory") && i + 1 < argc)
+        {
+            rewind_memory_mb = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--history-memory") && i + 1 < argc)
+        {
+            history_memory_mb = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--checkpoint-interval") && i + 1 < argc)
+        {
+            checkpoint_interval = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--checkpoint-cache") && i + 1 < argc)
+        {
+            checkpoint_cache_mb = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--play") && i + 1 < argc)
+        {
+            movie_filename = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--shm"))
+        {
+            shm_name = (i + 1 < argc && argv[i + 1][0] == '/') ? argv[++i] : SHM_DEFAULT_NAME;
+        }
+        else if (!strcmp(argv[i], "--headless"))
+        {
+            headless = true;
+        }
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            headless_frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+        {
+            json_filename = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--sync-fix"))
+        {
+            sync_fix = true;
+        }
+        else if (argv[i][0] == '-')
+        {
+            printf("Usage: %s [--rewind-interval FRAMES] [--rewind-memory MB] [--rewind FRAMES] [--history-memory MB] "
+                   "[--checkpoint-interval FRAMES] [--checkpoint-cache MB] [--play MOVIE] "
+                   "[--shm [/NAME]] [--headless] [--frames N] [--json FILE] [--sync-fix] [game]\n", argv[0]);
+            return -1;
+        }
+        else
+        {
+            game_name = argv[i];
+        }
+    }
+
+    if (headless_rewind && rewind_interval <= 0)
+    {
+        printf("--rewind needs captures, set --rewind-interval\n");
+        return -1;
     }
 
     const game_t game = game_find(game_name);
@@ -175,7 +468,7 @@ int main(int argc, char **argv)
 
     snprintf(title, 64, "F2 - %s", game_name);
 
-    if( !imgui_init(title) )
+    if( !headless && !imgui_init(title) )
     {
         return -1;
     }
@@ -188,17 +481,49 @@ int main(int argc, char **argv)
 
     g_fs.addSearchPath(".");
 
+    // Symbols from the test ROM build, or a map file next to the sim
+    const char *symbol_paths[] = { "../testroms/build/%s/cpu.elf", "../testroms/build/%s/cpu.map", "%s.map" };
+    for( const char *fmt : symbol_paths )
+    {
+        char symbol_file[256];
+        snprintf(symbol_file, sizeof(symbol_file), fmt, game_name);
+        if (access(symbol_file, R_OK) == 0 && load_68k_symbols(symbol_file) >= 0) break;
+    }
+
     strcpy(trace_filename, "sim.fst");
 
     top->ss_do_save = 0;
     top->ss_do_restore = 0;
     top->obj_debug_idx = -1;
 
-    top->joystick_p1 = 0;
-    top->joystick_p2 = 0;
+    if (!headless) save_power_on_checkpoint();
 
     // Create state manager
     state_manager = new SimState(top, &ddr_memory, 0, 256 * 1024);
+    rewind_manager = new SimRewind(state_manager, (size_t)std::max(rewind_memory_mb, 1) * 1024 * 1024);
+    rewind_manager->interval = rewind_interval;
+
+    ram_history = new SimRamHistory((size_t)std::max(history_memory_mb, 1) * 1024 * 1024);
+    history_work_ram = ram_history->add_region("Work RAM", work_ram_high, work_ram_low, 64 * 1024);
+    history_obj_ram = ram_history->add_region("OBJ RAM", obj_ram_high, obj_ram_low, 64 * 1024);
+    history_scn_ram_0 = ram_history->add_region("Screen RAM", scn_ram_0_high, scn_ram_0_low, 64 * 1024);
+    history_color_ram = ram_history->add_region("Color RAM", color_ram_high, color_ram_low, 32 * 1024);
+    history_sound_ram = ram_history->add_region("Sound RAM", sound_ram_data, nullptr, 8 * 1024);
+    ram_history->recording = !headless;
+
+    checkpoint_cache = new SimCheckpointCache("checkpoints", (uint64_t)std::max(checkpoint_cache_mb, 1) * 1024 * 1024);
+    checkpoint_cache->interval = checkpoint_interval;
+    const uint64_t rom_hash = sdram.load_hash ^ (ddr_memory.load_hash * 0x100000001b3ull);
+    uint64_t key_inputs = ~0ull;
+
+    input_manager = new SimInput(top);
+    input_manager->poll(dipswitch_a & 0xff, dipswitch_b & 0xff, sync_fix);
+    if (movie_filename)
+    {
+        if (!input_manager->load_movie(movie_filename)) return -1;
+        input_manager->start_playback();
+    }
+    input_manager->on_frame(0);
 
     //memset(&ddr_memory.memory[0x100000 + 8192], 0x01, 8192);
 
@@ -210,23 +535,63 @@ int main(int argc, char **argv)
     MemoryEditor extension_ram;
 
     video.init(320, 224, imgui_get_renderer());
+    video_timing.set_expected(video.width, video.height);
+    video.on_frame_complete([] { frame_capture.push(video.pixels, total_frames); });
+    video.on_frame_complete([] { shm_export.frame_complete(total_frames); });
 
-    init_obj_cache(imgui_get_renderer(),
-                   ddr_memory.memory.data() + OBJ_DATA_DDR_BASE, 
-                   top->rootp->F2__DOT__color_ram__DOT__ram_l.m_storage,
-                   top->rootp->F2__DOT__color_ram__DOT__ram_h.m_storage);
+    if (shm_name && !shm_export.open(shm_name, &video, AUDIO_SAMPLE_RATE))
+    {
+        return -1;
+    }
 
     Verilated::traceEverOn(true);
 
-    while( imgui_begin_frame() )
+    if (headless)
+    {
+        checkpoint_cache->set_key(game_name, rom_hash, checkpoint_key_inputs());
+        run_headless(headless_frames, headless_rewind, json_filename);
+    }
+    else
     {
-        prune_obj_cache();
+        init_obj_cache(imgui_get_renderer(),
+                       ddr_memory.memory.data() + OBJ_DATA_DDR_BASE, 
+                       top->rootp->F2__DOT__color_ram__DOT__ram_l.m_storage,
+                       top->rootp->F2__DOT__color_ram__DOT__ram_h.m_storage);
+    }
 
-        top->dswa = dipswitch_a & 0xff;
-        top->dswb = dipswitch_b & 0xff;
+    while( !headless && imgui_begin_frame() )
+    {
         top->pause = system_pause;
 
-        if (simulation_run || simulation_step)
+        // Inputs, including the sync fix, reach the core on the next frame edge
+        input_manager->poll(dipswitch_a & 0xff, dipswitch_b & 0xff, sync_fix);
+        video_timing.set_config(top->game, top->sync_fix);
+        if (!input_manager->playing() && input_manager->live_active())
+        {
+            timeline_from_reset = false;
+        }
+
+        uint64_t inputs = checkpoint_key_inputs();
+        if (inputs != key_inputs)
+        {
+            // A change mid-run isn't reproducible from reset with the new settings
+            if (key_inputs != ~0ull && total_frames > 0 && !input_manager->playing()) timeline_from_reset = false;
+            key_inputs = inputs;
+            checkpoint_cache->set_key(game_name, rom_hash, inputs);
+        }
+
+        if (goto_frame_active)
+        {
+            // Run a frame per UI update so progress is visible
+            uint64_t frame = total_frames;
+            sim_tick_until([&] { return total_frames != frame || total_frames >= goto_frame_target; });
+            if (total_frames >= goto_frame_target)
+            {
+                goto_frame_active = false;
+            }
+            video.update_texture();
+        }
+        else if (simulation_run || simulation_step)
         {
             if (simulation_step_vblank)
             {
@@ -244,6 +609,7 @@ int main(int argc, char **argv)
         if (ImGui::Begin("Simulation Control"))
         {
             ImGui::LabelText("Ticks", "%llu", total_ticks);
+            ImGui::LabelText("Frames", "%llu", total_frames);
             ImGui::Checkbox("Run", &simulation_run);
             if (ImGui::Button("Step"))
             {
@@ -259,11 +625,13 @@ int main(int argc, char **argv)
 
             if (ImGui::Button("Reset"))
             {
-                simulation_reset_until = total_ticks + 100;
+                sim_reset();
             }
 
             ImGui::SameLine();
             ImGui::Checkbox("Pause", &system_pause);
+            ImGui::SameLine();
+            ImGui::Checkbox("Sync Fix", &sync_fix);
 
 
             ImGui::Separator();
@@ -316,7 +684,10 @@ int main(int argc, char **argv)
                         selected_state_file = (int)i;
                         if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
                         {
-                            state_manager->restore_state(state_files[i].c_str());
+                            if (state_manager->restore_state(state_files[i].c_str()))
+                            {
+                                timeline_from_reset = false;
+                            }
                         }
                     }
                 }
@@ -328,6 +699,167 @@ int main(int argc, char **argv)
             }
             
             ImGui::Separator();
+
+            ImGui::Text("Checkpoint");
+            static char checkpoint_filename[256] = "sim.f2ckpt";
+            static std::string checkpoint_report;
+            ImGui::InputText("Checkpoint Filename", checkpoint_filename, sizeof(checkpoint_filename));
+            if (ImGui::Button("Save Checkpoint"))
+            {
+                save_checkpoint(checkpoint_filename);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Load Checkpoint"))
+            {
+                if (restore_checkpoint(checkpoint_filename))
+                {
+                    timeline_from_reset = false;
+                    rewind_manager->clear();
+                    video.update_texture();
+                }
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Verify RTL State"))
+            {
+                verify_rtl_savestate(state_manager, "verify.f2ckpt", checkpoint_report);
+            }
+            if (!checkpoint_report.empty())
+            {
+                ImGui::TextUnformatted(checkpoint_report.c_str());
+            }
+
+            ImGui::Separator();
+
+            ImGui::Text("Input Movie");
+            static char movie_file[256] = "input.f2movie";
+            ImGui::InputText("Movie Filename", movie_file, sizeof(movie_file));
+            if (input_manager->recording() || input_manager->playing())
+            {
+                if (ImGui::Button("Stop Movie"))
+                {
+                    if (input_manager->recording()) input_manager->save_movie(movie_file);
+                    input_manager->stop();
+                }
+            }
+            else
+            {
+                if (ImGui::Button("Record"))
+                {
+                    input_manager->start_recording();
+                    sim_power_on();
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Play"))
+                {
+                    if (input_manager->load_movie(movie_file))
+                    {
+                        input_manager->start_playback();
+                        sim_power_on();
+                    }
+                }
+            }
+
+            ImGui::Separator();
+
+            ImGui::Text("Video Capture");
+            static char capture_path[256] = "capture";
+            static int capture_format = 0;
+            ImGui::InputText("Capture Path", capture_path, sizeof(capture_path),
+                             frame_capture.active() ? ImGuiInputTextFlags_ReadOnly : ImGuiInputTextFlags_None);
+            ImGui::PushItemWidth(100);
+            ImGui::Combo("##captureformat", &capture_format, "PNG\0RGB\0Y4M\0");
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            if (ImGui::Button(frame_capture.active() ? "Stop Capture###CaptureBtn" : "Start Capture###CaptureBtn"))
+            {
+                if (frame_capture.active())
+                    frame_capture.stop();
+                else
+                {
+                    // Measured frame length if there is one, otherwise the board's
+                    uint64_t ticks = video_timing.valid() ? video_timing.timing().ticks : F2_FRAME_TICKS;
+                    frame_capture.start(capture_path, (CaptureFormat)capture_format, video.width, video.height,
+                                        F2_CLOCK_HZ, (uint32_t)ticks);
+                }
+            }
+            if (frame_capture.active())
+            {
+                ImGui::Text("%llu frames written, %llu dropped", (unsigned long long)frame_capture.frames_written(),
+                            (unsigned long long)frame_capture.frames_dropped());
+            }
+
+            ImGui::Separator();
+
+            ImGui::Text("Go To Frame");
+            static int goto_frame = 0;
+            ImGui::PushItemWidth(100);
+            ImGui::InputInt("##gotoframe", &goto_frame);
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            if (ImGui::Button(goto_frame_active ? "Stop###GotoBtn" : "Go###GotoBtn"))
+            {
+                if (goto_frame_active)
+                {
+                    goto_frame_active = false;
+                }
+                else
+                {
+                    uint64_t target = (uint64_t)std::max(goto_frame, 0);
+                    int64_t cached = checkpoint_cache->nearest(target);
+
+                    // Use the cache when it is closer than simulating on from here
+                    bool restored = false;
+                    if (cached >= 0 && (!timeline_from_reset || target < total_frames || (uint64_t)cached > total_frames))
+                    {
+                        restored = checkpoint_cache->restore(cached);
+                    }
+
+                    if (restored)
+                    {
+                        // Checkpoints hold the model, SDRAM, DDR and sim timing
+                        // state, the run carries on exactly as the cached one did
+                        timeline_from_reset = true;
+                        rewind_manager->clear();
+                    }
+                    else if (!timeline_from_reset || target < total_frames)
+                    {
+                        sim_power_on();
+                    }
+
+                    goto_frame_target = target;
+                    goto_frame_active = true;
+                    simulation_run = false;
+                }
+            }
+            ImGui::Text("Cache: %d checkpoints, %llu/%llu MB", checkpoint_cache->count(),
+                        (unsigned long long)(checkpoint_cache->bytes_used() >> 20),
+                        (unsigned long long)(checkpoint_cache->max_bytes() >> 20));
+
+            ImGui::Separator();
+
+            ImGui::Text("Rewind");
+            static int rewind_frames = 60;
+            ImGui::PushItemWidth(100);
+            ImGui::InputInt("Capture Interval", &rewind_manager->interval);
+            ImGui::InputInt("##rewindframes", &rewind_frames);
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            if (ImGui::Button("Rewind Frames"))
+            {
+                int64_t frame = rewind_manager->rewind(total_frames, rewind_frames);
+                if (frame >= 0)
+                {
+                    total_frames = frame;
+                    timeline_from_reset = false;
+                    video.update_texture();
+                }
+            }
+            ImGui::Text("%d states, frames %llu-%llu, %zu/%zu KB", rewind_manager->count(),
+                        (unsigned long long)rewind_manager->oldest_frame(),
+                        (unsigned long long)rewind_manager->newest_frame(),
+                        rewind_manager->bytes_used() / 1024, rewind_manager->arena_size() / 1024);
+
+            ImGui::Separator();
             
             ImGui::PushItemWidth(100);
             if(ImGui::InputInt("Trace Depth", &trace_depth, 1, 10,
@@ -372,36 +904,114 @@ int main(int argc, char **argv)
 
         if (ImGui::Begin("Audio"))
         {
-            if (ImGui::Button("Save Audio"))
+            static char audio_filename[256] = "audio.wav";
+            ImGui::InputText("WAV Filename", audio_filename, sizeof(audio_filename),
+                             audio_capture.active() ? ImGuiInputTextFlags_ReadOnly : ImGuiInputTextFlags_None);
+            if (ImGui::Button(audio_capture.active() ? "Stop Capture###AudioBtn" : "Start Capture###AudioBtn"))
+            {
+                if (audio_capture.active())
+                    audio_capture.stop();
+                else
+                    audio_capture.start(audio_filename);
+            }
+
+            bool play_audio = audio_output.is_open();
+            if (ImGui::Checkbox("Play Audio", &play_audio))
             {
-                FILE *fout = fopen("audio.raw", "wb");
-                fwrite(audio_samples, sizeof(int16_t) * NUM_SAMPLES, 1, fout);
-                fclose(fout);
+                if (play_audio)
+                    audio_output.open();
+                else
+                    audio_output.close();
             }
 
-            ImGui::Text("Idx: %u", audio_sample_index);
+            if (audio_capture.active())
+            {
+                uint64_t samples = audio_capture.samples_written();
+                ImGui::Text("%llu samples, %.2fs", (unsigned long long)samples, (double)samples / audio_capture.sample_rate());
+                ImGui::Text("Dropped: %llu", (unsigned long long)audio_capture.samples_dropped());
+            }
+        }
+        ImGui::End();
+
+        if (ImGui::Begin("Performance"))
+        {
+            // Averaged over half a second of wall time
+            static auto perf_start = std::chrono::steady_clock::now();
+            static uint64_t perf_ticks = total_ticks;
+            static uint64_t perf_frames = total_frames;
+            static double ticks_per_sec = 0, frames_per_sec = 0;
+
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - perf_start).count();
+            if (elapsed >= 0.5)
+            {
+                ticks_per_sec = (total_ticks - perf_ticks) / elapsed;
+                frames_per_sec = total_frames >= perf_frames ? (total_frames - perf_frames) / elapsed : 0;
+                perf_start = now;
+                perf_ticks = total_ticks;
+                perf_frames = total_frames;
+            }
+
+            ImGui::Text("Sim speed: %.2f MHz (%.1f%% real time)", ticks_per_sec / 1000000.0, ticks_per_sec * 100.0 / F2_CLOCK_HZ);
+            ImGui::Text("Frames/s: %.2f", frames_per_sec);
+
+            ImGui::SeparatorText("Audio Output");
+            if (audio_output.is_open())
+            {
+                ImGui::Text("Device rate: %u Hz", audio_output.device_rate());
+                ImGui::Text("Buffered: %.1f ms", audio_output.buffered_ms());
+                ImGui::Text("Rate adjust: %+d ppm", audio_output.rate_adjust_ppm());
+                ImGui::Text("Underruns: %llu", (unsigned long long)audio_output.underruns());
+                ImGui::Text("Overflows: %llu", (unsigned long long)audio_output.overflows());
+            }
+            else
+            {
+                ImGui::TextDisabled("Not playing");
+            }
         }
         ImGui::End();
 
         if (ImGui::Begin("Memory"))
         {
+            static bool highlight_changes = true;
+            ImGui::Checkbox("Highlight Changes", &highlight_changes);
+            scn_ram_0.highlight_changes = color_ram.highlight_changes = obj_ram.highlight_changes = highlight_changes;
+            work_ram.highlight_changes = pivot_ram.highlight_changes = highlight_changes;
+
+            // Past frames picked in the RAM History window replace the live contents
+            uint64_t history_frame = ram_history->view_frame;
+            auto history_contents = [&](int region) { return ram_history->viewing ? ram_history->contents(region, history_frame) : nullptr; };
+            auto draw_ram = [&](SimMemoryView &view, int region)
+            {
+                const uint8_t *past = history_contents(region);
+                if (past)
+                    view.DrawContents(past);
+                else
+                    view.DrawContents();
+            };
+            if (ram_history->viewing)
+            {
+                ImGui::SameLine();
+                ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.0f, 1.0f), "Showing frame %llu", (unsigned long long)history_frame);
+            }
+
             if (ImGui::BeginTabBar("memory_tabs"))
             {
                 if (ImGui::BeginTabItem("Screen RAM"))
                 {
-                    scn_ram_0.DrawContents();
+                    draw_ram(scn_ram_0, history_scn_ram_0);
                     ImGui::EndTabItem();
                 }
 
                 if (ImGui::BeginTabItem("Color RAM"))
                 {
-                    color_ram.DrawContents();
+                    draw_ram(color_ram, history_color_ram);
                     ImGui::EndTabItem();
                 }
                 
                 if (ImGui::BeginTabItem("OBJ RAM"))
                 {
-                    obj_ram.DrawContents();
+                    draw_ram(obj_ram, history_obj_ram);
                     ImGui::EndTabItem();
                 }
 
@@ -420,7 +1030,7 @@ int main(int argc, char **argv)
                 
                 if (ImGui::BeginTabItem("Work RAM"))
                 {
-                    work_ram.DrawContents();
+                    draw_ram(work_ram, history_work_ram);
                     ImGui::EndTabItem();
                 }
 
@@ -438,7 +1048,9 @@ int main(int argc, char **argv)
 
                 if (ImGui::BeginTabItem("Sound RAM"))
                 {
-                    sound_ram.DrawContents(top->rootp->F2__DOT__sound_ram__DOT__ram.m_storage, 16 * 1024);
+                    const uint8_t *past = history_contents(history_sound_ram);
+                    sound_ram.ReadOnly = past != nullptr;
+                    sound_ram.DrawContents(past ? (void *)past : sound_ram_data(), 8 * 1024);
                     ImGui::EndTabItem();
                 }
 
@@ -490,21 +1102,24 @@ int main(int argc, char **argv)
         }
         ImGui::End();
 
+        update_obj_cache();
         draw_obj_window();
         draw_obj_preview_window();
+        draw_obj_render_window();
         draw_pri_window();
+        draw_layer_window();
+        cheat_finder.draw();
+        ram_history->draw();
+        bus_log.draw();
+        cpu_usage.draw();
+        irq_latency.draw();
+        obj_budget.draw();
         video.draw();
+        draw_pri_video_tooltip(video.hover_x, video.hover_y);
+        video_timing.draw();
+        input_manager->draw();
 
-        ImGui::Begin("68000");
-        uint32_t pc = top->rootp->F2__DOT__m68000__DOT__excUnit__DOT__PcL |
-            (top->rootp->F2__DOT__m68000__DOT__excUnit__DOT__PcH << 16);
-        ImGui::LabelText("PC", "%08X", pc);
-        Dis68k dis(sdram.data + pc, sdram.data + pc + 64, pc);
-        char optxt[128];
-        uint32_t addr;
-        dis.disasm(&addr, optxt, sizeof(optxt));
-        ImGui::TextUnformatted(optxt);
-        ImGui::End();
+        draw_68k_window();
 
         imgui_end_frame();
     }
@@ -515,10 +1130,21 @@ int main(int argc, char **argv)
         tfp.reset();
     }
 
+    audio_capture.stop();
+    audio_output.close();
+    frame_capture.stop();
+    shm_export.close();
+
     top->final();
 
     video.deinit();
 
+    if (power_on_checkpoint[0]) remove(power_on_checkpoint);
+
+    delete input_manager;
+    delete checkpoint_cache;
+    delete ram_history;
+    delete rewind_manager;
     delete state_manager;
     delete top;
     delete contextp;
@@ -2,7 +2,25 @@
 #define SIM_H 1
 
 #include <functional>
+#include <cstdint>
+
+// clk_sys, one sim tick per cycle
+static const uint32_t F2_CLOCK_HZ = 53372000;
+
+// Board timing, an 8 tick pixel clock with 424 pixels by 262 lines per frame
+static const uint32_t F2_FRAME_TICKS = 8 * 424 * 262;
 
 void sim_tick_until(std::function<bool()> until);
 
+// Call after the sim state has been restored, from a savestate or a
+// checkpoint, or after a rewind capture, so measurements don't span the
+// jump or the savestate handler
+void sim_state_restored();
+
+// Harness counters, saved with native checkpoints
+extern uint64_t total_ticks;
+extern uint64_t total_frames;
+extern uint64_t simulation_reset_until;
+extern bool prev_vblank;
+
 #endif // SIM_H
@@ -0,0 +1,339 @@
+#include "sim_audio.h"
+
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static void put_le16(uint8_t* p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t* p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static void wav_header(uint8_t* header, uint32_t sample_rate, uint32_t data_size)
+{
+    memcpy(header + 0, "RIFF", 4);
+    put_le32(header + 4, 36 + data_size);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    put_le32(header + 16, 16);
+    put_le16(header + 20, 1);               // PCM
+    put_le16(header + 22, 1);               // mono
+    put_le32(header + 24, sample_rate);
+    put_le32(header + 28, sample_rate * 2); // byte rate
+    put_le16(header + 32, 2);               // block align
+    put_le16(header + 34, 16);              // bits per sample
+    memcpy(header + 36, "data", 4);
+    put_le32(header + 40, data_size);
+}
+
+SimAudioCapture::SimAudioCapture(size_t ring_samples)
+    : m_head(0), m_tail(0), m_active(false), m_stop(false), m_fp(nullptr),
+      m_sample_rate(0), m_written(0), m_dropped(0), m_silenced(0)
+{
+    size_t size = 1;
+    while (size < ring_samples) size <<= 1;
+    m_ring.resize(size);
+    m_mask = size - 1;
+}
+
+SimAudioCapture::~SimAudioCapture()
+{
+    stop();
+}
+
+bool SimAudioCapture::start(const char* filename, uint32_t sample_rate)
+{
+    stop();
+
+    m_fp = fopen(filename, "wb");
+    if (!m_fp)
+    {
+        printf("Failed to open audio file for writing: %s\n", filename);
+        return false;
+    }
+
+    uint8_t header[44];
+    wav_header(header, sample_rate, 0);
+    fwrite(header, sizeof(header), 1, m_fp);
+
+    m_sample_rate = sample_rate;
+    m_head = 0;
+    m_tail = 0;
+    m_written = 0;
+    m_dropped = 0;
+    m_silenced = 0;
+    m_stop = false;
+    m_thread = std::thread(&SimAudioCapture::writer, this);
+    m_active = true;
+
+    printf("Capturing audio to %s at %u Hz\n", filename, sample_rate);
+    return true;
+}
+
+void SimAudioCapture::stop()
+{
+    if (!m_active) return;
+
+    m_active = false;
+    m_stop = true;
+    m_wake.notify_one();
+    m_thread.join();
+
+    // WAV sizes are 32-bit, anything past that is still written but the
+    // header can't describe it
+    uint64_t data_size = m_written * 2;
+    if (data_size > 0xffffffffull - 36) data_size = 0xffffffffull - 36;
+
+    uint8_t header[44];
+    wav_header(header, m_sample_rate, (uint32_t)data_size);
+    fseek(m_fp, 0, SEEK_SET);
+    fwrite(header, sizeof(header), 1, m_fp);
+    fclose(m_fp);
+    m_fp = nullptr;
+
+    printf("Audio capture finished, %llu samples, %llu dropped\n", (unsigned long long)m_written.load(),
+           (unsigned long long)m_dropped.load());
+}
+
+size_t SimAudioCapture::drain()
+{
+    size_t head = m_head.load(std::memory_order_acquire);
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+
+    size_t count = 0;
+    if (head < tail)
+    {
+        // Wrapped, write up to the end of the ring first
+        fwrite(&m_ring[tail], sizeof(int16_t), m_ring.size() - tail, m_fp);
+        count += m_ring.size() - tail;
+        tail = 0;
+    }
+    fwrite(&m_ring[tail], sizeof(int16_t), head - tail, m_fp);
+    count += head - tail;
+
+    m_tail.store(head, std::memory_order_release);
+
+    // Drops only happen while the ring is full, so they all came after the
+    // samples just written and before any pushed since
+    static const int16_t silence[4096] = {};
+    uint64_t dropped = m_dropped.load(std::memory_order_acquire);
+    while (m_silenced < dropped)
+    {
+        size_t n = (size_t)std::min<uint64_t>(dropped - m_silenced, 4096);
+        fwrite(silence, sizeof(int16_t), n, m_fp);
+        m_silenced += n;
+        count += n;
+    }
+
+    m_written += count;
+    return count;
+}
+
+void SimAudioCapture::writer()
+{
+    while (!m_stop)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        drain();
+    }
+
+    // Pick up anything pushed before stop()
+    drain();
+}
+
+SimAudioOutput::SimAudioOutput()
+    : m_device(0), m_open(false), m_device_rate(0), m_input_rate(0),
+      m_accum(0), m_accum_count(0), m_head(0), m_tail(0), m_target_fill(0),
+      m_taps(0), m_step(0), m_pos(0), m_primed(false), m_last(0),
+      m_adjust_ppm(0), m_underruns(0), m_overflows(0)
+{
+    m_ring.resize(64 * 1024);
+    m_mask = m_ring.size() - 1;
+}
+
+SimAudioOutput::~SimAudioOutput()
+{
+    close();
+}
+
+void SimAudioOutput::build_filter()
+{
+    // Cutoff just below the output Nyquist, in cycles per input sample
+    const double fc = 0.45 * m_device_rate / m_input_rate;
+    const int ZERO_CROSSINGS = 8;
+    const int half = (int)ceil(ZERO_CROSSINGS / (2.0 * fc));
+
+    m_taps = half * 2;
+    m_filter.resize(PHASES * m_taps);
+
+    for( int p = 0; p < PHASES; p++ )
+    {
+        float* h = &m_filter[p * m_taps];
+        double sum = 0;
+        for( int k = 0; k < m_taps; k++ )
+        {
+            // Distance from the interpolated point, which sits between
+            // taps half-1 and half
+            double t = k - (half - 1) - (double)p / PHASES;
+            double x = 2.0 * fc * t;
+            double sinc = x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double w = (t + half) / (2.0 * half);
+            double blackman = 0.42 - 0.5 * cos(2 * M_PI * w) + 0.08 * cos(4 * M_PI * w);
+            h[k] = sinc * blackman;
+            sum += h[k];
+        }
+
+        // Unity gain for every phase
+        for( int k = 0; k < m_taps; k++ )
+        {
+            h[k] /= sum;
+        }
+    }
+}
+
+bool SimAudioOutput::open(uint32_t input_rate)
+{
+    close();
+
+    if (!SDL_WasInit(SDL_INIT_AUDIO) && SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+    {
+        printf("Failed to init SDL audio: %s\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_AudioSpec want, have;
+    memset(&want, 0, sizeof(want));
+    want.freq = 48000;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = 512;
+    want.callback = callback;
+    want.userdata = this;
+
+    m_device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (m_device == 0)
+    {
+        printf("Failed to open audio device: %s\n", SDL_GetError());
+        return false;
+    }
+
+    m_device_rate = have.freq;
+    m_input_rate = (double)input_rate / DECIMATION;
+    m_step = m_input_rate / m_device_rate;
+    build_filter();
+
+    // Aim to keep 60ms buffered
+    m_target_fill = (size_t)(m_input_rate * 0.06);
+
+    m_accum = 0;
+    m_accum_count = 0;
+    m_head = 0;
+    m_tail = 0;
+    m_pos = 0;
+    m_primed = false;
+    m_last = 0;
+    m_adjust_ppm = 0;
+    m_underruns = 0;
+    m_overflows = 0;
+
+    m_open = true;
+    SDL_PauseAudioDevice(m_device, 0);
+
+    printf("Audio output at %u Hz, %d tap resampler\n", m_device_rate, m_taps);
+    return true;
+}
+
+void SimAudioOutput::close()
+{
+    if (!m_open) return;
+
+    // Waits for the callback to finish
+    SDL_CloseAudioDevice(m_device);
+    m_device = 0;
+    m_open = false;
+}
+
+float SimAudioOutput::buffered_ms() const
+{
+    if (!m_open) return 0;
+    size_t fill = m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_relaxed);
+    return (float)(fill * 1000.0 / m_input_rate);
+}
+
+void SimAudioOutput::callback(void* userdata, uint8_t* stream, int len)
+{
+    SimAudioOutput* self = (SimAudioOutput*)userdata;
+    self->fill((int16_t*)stream, len / sizeof(int16_t));
+}
+
+void SimAudioOutput::fill(int16_t* out, int count)
+{
+    const size_t head = m_head.load(std::memory_order_acquire);
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t avail = head - tail;
+
+    int i = 0;
+
+    // Wait for the target fill before starting, and again after an underrun
+    if (!m_primed && avail >= m_target_fill)
+    {
+        m_primed = true;
+    }
+
+    if (m_primed)
+    {
+        // Proportional control, consume faster when there is more than the
+        // target buffered
+        double error = ((double)avail - (double)m_target_fill) / m_target_fill;
+        double adjust = std::max(-MAX_RATE_ADJUST, std::min(MAX_RATE_ADJUST, error * MAX_RATE_ADJUST));
+        double step = m_step * (1.0 + adjust);
+        m_adjust_ppm = (int)(adjust * 1000000);
+
+        for( ; i < count; i++ )
+        {
+            size_t ipos = (size_t)m_pos;
+            if (ipos + m_taps > avail)
+            {
+                m_underruns++;
+                m_primed = false;
+                break;
+            }
+
+            const float* h = &m_filter[(int)((m_pos - ipos) * PHASES) * m_taps];
+            size_t base = tail + ipos;
+            float acc = 0;
+            for( int k = 0; k < m_taps; k++ )
+            {
+                acc += m_ring[(base + k) & m_mask] * h[k];
+            }
+
+            int v = (int)lrintf(acc);
+            m_last = (int16_t)std::max(-32768, std::min(32767, v));
+            out[i] = m_last;
+            m_pos += step;
+        }
+
+        size_t consumed = (size_t)m_pos;
+        m_pos -= consumed;
+        m_tail.store(tail + consumed, std::memory_order_release);
+    }
+
+    // Hold the last value rather than dropping to zero and clicking
+    for( ; i < count; i++ )
+    {
+        out[i] = m_last;
+    }
+}
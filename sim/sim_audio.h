@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <SDL.h>
+
+// audio_mix updates its output on a 35/467 fractional enable of the 53.372MHz
+// system clock divided by two
+static const uint32_t AUDIO_SAMPLE_RATE = 2000021;
+
+// Streams audio_out samples to a mono 16-bit WAV file.
+//
+// The sim thread pushes into a single producer/single consumer ring which
+// a writer thread drains to disk, so captures can be any length without
+// holding them in memory. The sim never waits on the writer, samples that
+// arrive while the ring is full are dropped and written as silence so the
+// file keeps its timing. The header sizes are patched when the capture is
+// stopped.
+class SimAudioCapture {
+public:
+    SimAudioCapture(size_t ring_samples = 1 << 22);
+    ~SimAudioCapture();
+
+    bool start(const char* filename, uint32_t sample_rate = AUDIO_SAMPLE_RATE);
+    void stop();
+
+    // Called from the sim thread for every sample
+    void push(int16_t sample)
+    {
+        if (!m_active) return;
+
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t next = (head + 1) & m_mask;
+        if (next == m_tail.load(std::memory_order_acquire))
+        {
+            // Only happens if the disk can't keep up
+            m_dropped.fetch_add(1, std::memory_order_release);
+            return;
+        }
+
+        m_ring[head] = sample;
+        m_head.store(next, std::memory_order_release);
+    }
+
+    bool active() const { return m_active; }
+    uint64_t samples_written() const { return m_written; }
+    uint64_t samples_dropped() const { return m_dropped; }
+    uint32_t sample_rate() const { return m_sample_rate; }
+
+private:
+    void writer();
+    size_t drain();
+
+    std::vector<int16_t> m_ring;
+    size_t m_mask;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+
+    bool m_active;
+    std::atomic<bool> m_stop;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+
+    FILE* m_fp;
+    uint32_t m_sample_rate;
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+    uint64_t m_silenced;    // dropped samples already written as silence
+};
+
+// Real-time playback of audio_out through SDL.
+//
+// Samples are box filtered down by DECIMATION on the sim thread and passed
+// to the SDL callback through a lock-free single producer/single consumer
+// ring. The callback resamples to the device rate with a polyphase
+// windowed-sinc filter, nudging the ratio by up to MAX_RATE_ADJUST to
+// hold the ring at its target fill so speed jitter in the sim doesn't
+// cause clicks.
+class SimAudioOutput {
+public:
+    SimAudioOutput();
+    ~SimAudioOutput();
+
+    bool open(uint32_t input_rate = AUDIO_SAMPLE_RATE);
+    void close();
+
+    // Called from the sim thread for every sample
+    void push(int16_t sample)
+    {
+        if (!m_open) return;
+
+        m_accum += sample;
+        if (++m_accum_count < DECIMATION) return;
+
+        int16_t value = (int16_t)(m_accum / DECIMATION);
+        m_accum = 0;
+        m_accum_count = 0;
+
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= m_ring.size())
+        {
+            // Sim is running faster than real time
+            m_overflows++;
+            return;
+        }
+
+        m_ring[head & m_mask] = value;
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    bool is_open() const { return m_open; }
+    uint32_t device_rate() const { return m_device_rate; }
+
+    // Buffered audio in milliseconds
+    float buffered_ms() const;
+
+    // Current resampling ratio adjustment in parts per million
+    int rate_adjust_ppm() const { return m_adjust_ppm; }
+
+    uint64_t underruns() const { return m_underruns; }
+    uint64_t overflows() const { return m_overflows; }
+
+    static const int DECIMATION = 8;
+    static const int PHASES = 256;
+    static constexpr double MAX_RATE_ADJUST = 0.005;
+
+private:
+    static void callback(void* userdata, uint8_t* stream, int len);
+    void fill(int16_t* out, int count);
+    void build_filter();
+
+    SDL_AudioDeviceID m_device;
+    bool m_open;
+    uint32_t m_device_rate;
+    double m_input_rate;
+
+    // Producer side
+    int32_t m_accum;
+    int m_accum_count;
+
+    // Ring indices count samples and are never wrapped
+    std::vector<int16_t> m_ring;
+    size_t m_mask;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+    size_t m_target_fill;
+
+    // Filter table, PHASES rows of m_taps coefficients
+    std::vector<float> m_filter;
+    int m_taps;
+
+    // Consumer side
+    double m_step;
+    double m_pos;
+    bool m_primed;
+    int16_t m_last;
+
+    std::atomic<int> m_adjust_ppm;
+    std::atomic<uint64_t> m_underruns;
+    std::atomic<uint64_t> m_overflows;
+};
@@ -0,0 +1,494 @@
+#include "imgui_wrap.h"
+#include "sim_bus_log.h"
+#include "sim.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+extern F2* top;
+
+static const char *device_names[BUS_DEVICE_COUNT] = {
+    "ROM", "Work RAM", "Screen", "OBJ", "Color", "IO", "Sound",
+    "Extension", "Priority", "ROZ", "C-Chip", "IACK", "Other"
+};
+
+const char *bus_device_name(int device)
+{
+    if (device < 0 || device >= BUS_DEVICE_COUNT) return "?";
+    return device_names[device];
+}
+
+static const char *stall_names[STALL_SOURCE_COUNT] = {
+    "ROM cache", "ROM setup", "TC0100SCN", "TC0110PR", "TC0260DAR", "TC0200OBJ", "TC0430GRW", "Any"
+};
+
+const char *stall_source_name(int source)
+{
+    if (source < 0 || source >= STALL_SOURCE_COUNT) return "?";
+    return stall_names[source];
+}
+
+static const char *bucket_names[STALL_BUCKETS] = { "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64+" };
+
+static int stall_bucket(uint32_t ticks)
+{
+    if (ticks == 0) return 0;
+    return std::min(32 - __builtin_clz(ticks), STALL_BUCKETS - 1);
+}
+
+// Chip selects are only asserted while a data strobe is
+static BusDevice selected_device()
+{
+    auto r = top->rootp;
+    if (r->F2__DOT__cpu_fc == 7) return BUS_IACK;
+    if (!r->F2__DOT__ROMn) return BUS_ROM;
+    if (!r->F2__DOT__WORKn) return BUS_WORK_RAM;
+    if (!r->F2__DOT__SCREENn) return BUS_SCREEN;
+    if (!r->F2__DOT__OBJECTn) return BUS_OBJ;
+    if (!r->F2__DOT__COLORn) return BUS_COLOR;
+    if (!r->F2__DOT__IO0n || !r->F2__DOT__IO1n) return BUS_IO;
+    if (!r->F2__DOT__SOUNDn) return BUS_SOUND;
+    if (!r->F2__DOT__EXTENSIONn) return BUS_EXTENSION;
+    if (!r->F2__DOT__PRIORITYn) return BUS_PRIORITY;
+    if (!r->F2__DOT__PIVOTn) return BUS_ROZ;
+    if (!r->F2__DOT__CCHIPn) return BUS_CCHIP;
+    return BUS_OTHER;
+}
+
+SimBusLog::SimBusLog(size_t capacity)
+{
+    m_records.resize(capacity);
+    m_total = 0;
+    m_in_cycle = false;
+    m_strobed = false;
+    m_cycle_length = 0;
+    m_cycle_stall = 0;
+    memset(&m_cycle, 0, sizeof(m_cycle));
+    memset(&m_counts, 0, sizeof(m_counts));
+    memset(m_stall_start, 0, sizeof(m_stall_start));
+    memset(m_stall_hist, 0, sizeof(m_stall_hist));
+    m_frame_start = 0;
+    m_resynced = true;
+}
+
+void SimBusLog::clear()
+{
+    m_total = 0;
+    m_frames.clear();
+    memset(m_stall_hist, 0, sizeof(m_stall_hist));
+    m_filter_dirty = true;
+}
+
+void SimBusLog::resync()
+{
+    m_in_cycle = false;
+
+    auto &stall = top->rootp->F2__DOT__dtack_stall;
+    for( int i = 0; i < STALL_SOURCE_COUNT; i++ )
+    {
+        m_stall_start[i] = stall[i];
+    }
+    m_frame_start = total_ticks;
+    m_resynced = true;
+}
+
+void SimBusLog::tick()
+{
+    auto r = top->rootp;
+
+    if (r->F2__DOT__cpu_as_n)
+    {
+        if (m_in_cycle) end_cycle();
+        return;
+    }
+
+    if (!m_in_cycle)
+    {
+        m_in_cycle = true;
+        m_strobed = false;
+        m_cycle_length = 0;
+        m_cycle.tick = total_ticks;
+        m_cycle.addr = 0;
+        m_cycle.data = 0;
+        m_cycle.device = BUS_OTHER;
+        m_cycle_stall = r->F2__DOT__dtack_stall[STALL_ANY];
+    }
+    m_cycle_length++;
+
+    // Writes assert the strobes a little after AS, and the two strobes of a
+    // word access may not change on the same tick
+    uint8_t ds_n = r->F2__DOT__cpu_ds_n;
+    if (ds_n == 3) return;
+
+    bool write = !r->F2__DOT__cpu_rw;
+    m_cycle.addr |= (r->F2__DOT__cpu_word_addr & 0xffffff) | (write << 24) |
+                    (!(ds_n & 2) << 25) | (!(ds_n & 1) << 26) | (r->F2__DOT__cpu_fc << 27);
+    m_cycle.data = write ? r->F2__DOT__cpu_data_out : r->F2__DOT__cpu_data_in;
+
+    if (!m_strobed) m_cycle.device = selected_device();
+    m_strobed = true;
+}
+
+void SimBusLog::end_cycle()
+{
+    m_in_cycle = false;
+    if (!m_strobed) return;
+
+    // A cycle never stalls for longer than it lasts
+    uint32_t stall = top->rootp->F2__DOT__dtack_stall[STALL_ANY] - m_cycle_stall;
+    if (stall <= m_cycle_length) m_stall_hist[m_cycle.device][stall_bucket(stall)]++;
+
+    m_cycle.length = std::min(m_cycle_length, 255u);
+
+    if (m_cycle.write())
+        m_counts.writes[m_cycle.device]++;
+    else
+        m_counts.reads[m_cycle.device]++;
+
+    if (logging)
+    {
+        m_records[m_total % m_records.size()] = m_cycle;
+        m_total++;
+    }
+}
+
+void SimBusLog::frame(uint64_t frame)
+{
+    // The counters are free running and wrap. After a restore, or if they
+    // went backwards without one, the frame is partial and not kept.
+    bool valid = !m_resynced && total_ticks >= m_frame_start;
+    m_counts.ticks = total_ticks - m_frame_start;
+    m_frame_start = total_ticks;
+
+    auto &stall = top->rootp->F2__DOT__dtack_stall;
+    for( int i = 0; i < STALL_SOURCE_COUNT; i++ )
+    {
+        m_counts.stalls[i] = stall[i] - m_stall_start[i];
+        m_stall_start[i] = stall[i];
+        if (m_counts.stalls[i] > m_counts.ticks) valid = false;
+    }
+
+    if (valid)
+    {
+        m_frames.push_back(m_counts);
+        if (m_frames.size() > FRAME_HISTORY) m_frames.pop_front();
+    }
+    m_resynced = false;
+
+    memset(&m_counts, 0, sizeof(m_counts));
+    m_counts.frame = frame;
+}
+
+bool SimBusLog::save(const char *path) const
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+    {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+
+    // "F2BL", version, record size, record count
+    uint32_t header[4] = { 0x4c423246, 1, sizeof(BusRecord), 0 };
+    uint64_t count = m_total - oldest();
+    header[3] = (uint32_t)count;
+    bool ok = fwrite(header, sizeof(header), 1, fp) == 1;
+
+    for( uint64_t serial = oldest(); ok && serial < m_total; serial++ )
+    {
+        ok = fwrite(&record(serial), sizeof(BusRecord), 1, fp) == 1;
+    }
+
+    fclose(fp);
+    if (!ok) printf("Failed to write %s\n", path);
+    return ok;
+}
+
+void SimBusLog::print_summary() const
+{
+    if (m_frames.empty()) return;
+
+    double frames = m_frames.size();
+    uint64_t ticks = 0;
+    for( const BusFrameCounts &f : m_frames ) ticks += f.ticks;
+
+    printf("Bus cycles per frame over the last %zu frames:\n", m_frames.size());
+    for( int d = 0; d < BUS_DEVICE_COUNT; d++ )
+    {
+        uint64_t reads = 0, writes = 0;
+        for( const BusFrameCounts &f : m_frames )
+        {
+            reads += f.reads[d];
+            writes += f.writes[d];
+        }
+        if (reads || writes)
+            printf("  %-10s %10.1f reads %10.1f writes\n", device_names[d], reads / frames, writes / frames);
+    }
+
+    printf("DTACK stall ticks per frame:\n");
+    for( int s = 0; s < STALL_SOURCE_COUNT; s++ )
+    {
+        uint64_t stalls = 0;
+        uint32_t worst = 0;
+        for( const BusFrameCounts &f : m_frames )
+        {
+            stalls += f.stalls[s];
+            worst = std::max(worst, f.stalls[s]);
+        }
+        printf("  %-10s %10.1f avg %8u max %6.2f%%\n", stall_names[s], stalls / frames, worst,
+               ticks ? (100.0 * stalls) / ticks : 0.0);
+    }
+
+    printf("Bus cycles by DTACK stall ticks:\n  %-10s", "");
+    for( int b = 0; b < STALL_BUCKETS; b++ ) printf(" %9s", bucket_names[b]);
+    printf("\n");
+    for( int d = 0; d < BUS_DEVICE_COUNT; d++ )
+    {
+        uint64_t cycles = 0;
+        for( int b = 0; b < STALL_BUCKETS; b++ ) cycles += m_stall_hist[d][b];
+        if (cycles == 0) continue;
+
+        printf("  %-10s", device_names[d]);
+        for( int b = 0; b < STALL_BUCKETS; b++ ) printf(" %9llu", (unsigned long long)m_stall_hist[d][b]);
+        printf("\n");
+    }
+}
+
+bool SimBusLog::matches(const BusRecord &r) const
+{
+    if (m_filter_device >= 0 && r.device != m_filter_device) return false;
+    if (m_filter_dir == 1 && r.write()) return false;
+    if (m_filter_dir == 2 && !r.write()) return false;
+    return r.address() >= m_filter_min && r.address() <= m_filter_max;
+}
+
+void SimBusLog::update_filter()
+{
+    if (m_filter_dirty)
+    {
+        m_filtered.clear();
+        m_filtered_upto = oldest();
+        m_filter_dirty = false;
+    }
+
+    for( uint64_t serial = std::max(m_filtered_upto, oldest()); serial < m_total; serial++ )
+    {
+        if (matches(record(serial))) m_filtered.push_back(serial);
+    }
+    m_filtered_upto = m_total;
+
+    while (!m_filtered.empty() && m_filtered.front() < oldest())
+    {
+        m_filtered.pop_front();
+    }
+}
+
+void SimBusLog::draw()
+{
+    if (!ImGui::Begin("Bus Log"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("Logging", &logging);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) clear();
+    ImGui::SameLine();
+    ImGui::Text("%llu cycles, %llu kept", (unsigned long long)m_total, (unsigned long long)(m_total - oldest()));
+
+    ImGui::InputText("##path", m_save_path, sizeof(m_save_path));
+    ImGui::SameLine();
+    if (ImGui::Button("Save")) save(m_save_path);
+
+    if (ImGui::CollapsingHeader("Per Frame", ImGuiTreeNodeFlags_DefaultOpen) && !m_frames.empty())
+    {
+        const BusFrameCounts &last = m_frames.back();
+
+        if (ImGui::BeginTable("devices", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Device");
+            ImGui::TableSetupColumn("Reads");
+            ImGui::TableSetupColumn("Writes");
+            ImGui::TableSetupColumn("Avg Reads");
+            ImGui::TableSetupColumn("Avg Writes");
+            ImGui::TableHeadersRow();
+
+            for( int d = 0; d < BUS_DEVICE_COUNT; d++ )
+            {
+                uint64_t reads = 0, writes = 0;
+                for( const BusFrameCounts &f : m_frames )
+                {
+                    reads += f.reads[d];
+                    writes += f.writes[d];
+                }
+
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(device_names[d]);
+                ImGui::TableNextColumn(); ImGui::Text("%u", last.reads[d]);
+                ImGui::TableNextColumn(); ImGui::Text("%u", last.writes[d]);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", (double)reads / m_frames.size());
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", (double)writes / m_frames.size());
+            }
+            ImGui::EndTable();
+        }
+
+        // Accesses per frame for the filtered device, or all of them
+        std::vector<float> plot;
+        for( const BusFrameCounts &f : m_frames )
+        {
+            uint32_t n = 0;
+            for( int d = 0; d < BUS_DEVICE_COUNT; d++ )
+            {
+                if (m_filter_device >= 0 && d != m_filter_device) continue;
+                n += f.reads[d] + f.writes[d];
+            }
+            plot.push_back(n);
+        }
+        ImGui::PlotLines("##per_frame", plot.data(), plot.size(), 0,
+                         m_filter_device >= 0 ? device_names[m_filter_device] : "All devices",
+                         0.0f, FLT_MAX, ImVec2(0, 80));
+    }
+
+    if (ImGui::CollapsingHeader("DTACK Stalls") && !m_frames.empty())
+    {
+        const BusFrameCounts &last = m_frames.back();
+
+        if (ImGui::BeginTable("stalls", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Source");
+            ImGui::TableSetupColumn("Ticks");
+            ImGui::TableSetupColumn("% Frame");
+            ImGui::TableSetupColumn("Avg Ticks");
+            ImGui::TableHeadersRow();
+
+            for( int s = 0; s < STALL_SOURCE_COUNT; s++ )
+            {
+                uint64_t stalls = 0;
+                for( const BusFrameCounts &f : m_frames ) stalls += f.stalls[s];
+
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(stall_names[s]);
+                ImGui::TableNextColumn(); ImGui::Text("%u", last.stalls[s]);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", last.ticks ? (100.0 * last.stalls[s]) / last.ticks : 0.0);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", (double)stalls / m_frames.size());
+            }
+            ImGui::EndTable();
+        }
+
+        std::vector<float> plot;
+        for( const BusFrameCounts &f : m_frames )
+        {
+            plot.push_back(f.ticks ? (100.0f * f.stalls[STALL_ANY]) / f.ticks : 0.0f);
+        }
+        ImGui::PlotLines("##stalls", plot.data(), plot.size(), 0, "% of frame stalled", 0.0f, FLT_MAX, ImVec2(0, 80));
+
+        // Stall ticks of each cycle, by the device it selected
+        if (ImGui::BeginTable("stall_hist", STALL_BUCKETS + 1, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Device");
+            for( int b = 0; b < STALL_BUCKETS; b++ ) ImGui::TableSetupColumn(bucket_names[b]);
+            ImGui::TableHeadersRow();
+
+            for( int d = 0; d < BUS_DEVICE_COUNT; d++ )
+            {
+                uint64_t cycles = 0;
+                for( int b = 0; b < STALL_BUCKETS; b++ ) cycles += m_stall_hist[d][b];
+                if (cycles == 0) continue;
+
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(device_names[d]);
+                for( int b = 0; b < STALL_BUCKETS; b++ )
+                {
+                    ImGui::TableNextColumn();
+                    if (m_stall_hist[d][b]) ImGui::Text("%llu", (unsigned long long)m_stall_hist[d][b]);
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    ImGui::SeparatorText("Cycles");
+
+    const char *preview = m_filter_device >= 0 ? device_names[m_filter_device] : "All";
+    ImGui::SetNextItemWidth(120);
+    if (ImGui::BeginCombo("Device", preview))
+    {
+        if (ImGui::Selectable("All", m_filter_device < 0))
+        {
+            m_filter_device = -1;
+            m_filter_dirty = true;
+        }
+        for( int d = 0; d < BUS_DEVICE_COUNT; d++ )
+        {
+            if (ImGui::Selectable(device_names[d], d == m_filter_device))
+            {
+                m_filter_device = d;
+                m_filter_dirty = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100);
+    m_filter_dirty |= ImGui::Combo("##dir", &m_filter_dir, "Any\0Reads\0Writes\0");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(80);
+    m_filter_dirty |= ImGui::InputScalar("##min", ImGuiDataType_U32, &m_filter_min, nullptr, nullptr, "%06X", ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(80);
+    m_filter_dirty |= ImGui::InputScalar("Address##max", ImGuiDataType_U32, &m_filter_max, nullptr, nullptr, "%06X", ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::SameLine();
+    ImGui::Checkbox("Follow", &m_follow);
+
+    update_filter();
+
+    if (ImGui::BeginTable("cycles", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Tick");
+        ImGui::TableSetupColumn("Address");
+        ImGui::TableSetupColumn("R/W");
+        ImGui::TableSetupColumn("Data");
+        ImGui::TableSetupColumn("Device");
+        ImGui::TableSetupColumn("Ticks");
+        ImGui::TableHeadersRow();
+
+        ImGuiListClipper clipper;
+        clipper.Begin(m_filtered.size());
+        while (clipper.Step())
+        {
+            for( int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++ )
+            {
+                const BusRecord &r = record(m_filtered[i]);
+
+                // Byte accesses show the byte address and data
+                uint32_t address = r.address();
+                char data[8];
+                if (r.upper() && r.lower())
+                    snprintf(data, sizeof(data), "%04X", r.data);
+                else if (r.upper())
+                    snprintf(data, sizeof(data), "%02X", r.data >> 8);
+                else
+                {
+                    address |= 1;
+                    snprintf(data, sizeof(data), "%02X", r.data & 0xff);
+                }
+
+                ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)r.tick);
+                ImGui::TableNextColumn(); ImGui::Text("%06X", address);
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(r.write() ? "W" : "R");
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(data);
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(device_names[r.device]);
+                ImGui::TableNextColumn(); ImGui::Text("%u", r.length);
+            }
+        }
+
+        if (m_follow && logging) ImGui::SetScrollHereY(1.0f);
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
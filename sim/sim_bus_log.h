@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Devices selected by address_translator, plus interrupt acknowledge
+// cycles and anything with no chip select
+enum BusDevice : uint8_t
+{
+    BUS_ROM,
+    BUS_WORK_RAM,
+    BUS_SCREEN,
+    BUS_OBJ,
+    BUS_COLOR,
+    BUS_IO,
+    BUS_SOUND,
+    BUS_EXTENSION,
+    BUS_PRIORITY,
+    BUS_ROZ,
+    BUS_CCHIP,
+    BUS_IACK,
+    BUS_OTHER,
+    BUS_DEVICE_COUNT
+};
+
+const char *bus_device_name(int device);
+
+// DTACK sources counted by the dtack_stall registers in F2.sv, the last
+// counts ticks where any source is holding DTACK
+enum StallSource
+{
+    STALL_ROM_CACHE,
+    STALL_ROM_SETUP,
+    STALL_SCN,
+    STALL_110PR,
+    STALL_260DAR,
+    STALL_OBJ,
+    STALL_PIVOT,
+    STALL_ANY,
+    STALL_SOURCE_COUNT
+};
+
+const char *stall_source_name(int source);
+
+// Per-cycle stall histogram buckets, 0, 1, 2-3, 4-7 ... 64+ ticks
+static const int STALL_BUCKETS = 8;
+
+// One 68k bus cycle, 16 bytes in memory and in saved logs
+struct BusRecord
+{
+    uint64_t tick;      // sim tick when AS was asserted
+    uint32_t addr;      // 23:0 byte address, 24 write, 25 UDS, 26 LDS, 29:27 function code
+    uint16_t data;      // written data, or read data as the cycle ended
+    uint8_t device;
+    uint8_t length;     // sim ticks with AS asserted, saturating
+
+    uint32_t address() const { return addr & 0xffffff; }
+    bool write() const { return (addr >> 24) & 1; }
+    bool upper() const { return (addr >> 25) & 1; }
+    bool lower() const { return (addr >> 26) & 1; }
+    int fc() const { return (addr >> 27) & 7; }
+};
+
+// Bus cycle counts and DTACK stall ticks for one frame
+struct BusFrameCounts
+{
+    uint64_t frame;
+    uint64_t ticks;
+    uint32_t reads[BUS_DEVICE_COUNT];
+    uint32_t writes[BUS_DEVICE_COUNT];
+    uint32_t stalls[STALL_SOURCE_COUNT];
+};
+
+// Watches the 68k bus pins and chip selects every sim tick.
+//
+// Each completed cycle is counted against its device for the current
+// frame, and while logging is enabled it is also appended to a ring of
+// records that can be filtered in the Bus Log window or saved as a binary
+// file of BusRecords after a small header.
+//
+// DTACK stalls are attributed two ways: per DTACK source each frame from
+// the RTL counters, and per device as a histogram of the stall ticks of
+// each cycle. Both are shown in the window and printed by print_summary.
+class SimBusLog
+{
+public:
+    explicit SimBusLog(size_t capacity);
+
+    // Call after each sim tick, and at each frame boundary
+    void tick();
+    void frame(uint64_t frame);
+
+    void clear();
+
+    // Call after a state restore, the counters may have jumped either way
+    void resync();
+
+    bool logging = false;
+
+    uint64_t total() const { return m_total; }
+    uint64_t oldest() const { return m_total > m_records.size() ? m_total - m_records.size() : 0; }
+    const BusRecord &record(uint64_t serial) const { return m_records[serial % m_records.size()]; }
+
+    // Completed frames, oldest first
+    const std::deque<BusFrameCounts> &frame_counts() const { return m_frames; }
+
+    bool save(const char *path) const;
+
+    // Per-frame averages for the headless runner
+    void print_summary() const;
+
+    void draw();
+
+private:
+    static const size_t FRAME_HISTORY = 600;
+
+    std::vector<BusRecord> m_records;
+    uint64_t m_total;
+
+    void end_cycle();
+
+    // Cycle in progress
+    bool m_in_cycle;
+    bool m_strobed;
+    BusRecord m_cycle;
+    uint32_t m_cycle_length;
+    uint32_t m_cycle_stall;
+
+    uint32_t m_stall_start[STALL_SOURCE_COUNT];
+    uint64_t m_frame_start;
+    bool m_resynced;            // the frame in progress started at a restore
+    uint64_t m_stall_hist[BUS_DEVICE_COUNT][STALL_BUCKETS];
+
+    BusFrameCounts m_counts;
+    std::deque<BusFrameCounts> m_frames;
+
+    // Viewer filter, serials of matching records
+    bool matches(const BusRecord &r) const;
+    void update_filter();
+
+    int m_filter_device = -1;
+    int m_filter_dir = 0;       // 0 any, 1 reads, 2 writes
+    uint32_t m_filter_min = 0;
+    uint32_t m_filter_max = 0xffffff;
+    bool m_filter_dirty = true;
+    uint64_t m_filtered_upto = 0;
+    std::deque<uint64_t> m_filtered;
+    bool m_follow = true;
+    char m_save_path[256] = "bus.log";
+};
@@ -0,0 +1,206 @@
+#include "sim_capture.h"
+#include "miniz.h"
+
+#include <cstring>
+#include <numeric>
+
+SimFrameCapture::SimFrameCapture(int pool_size)
+    : m_pool_size(pool_size), m_stop(false), m_active(false), m_format(CaptureFormat::PNG),
+      m_width(0), m_height(0), m_fp(nullptr), m_pipe(false), m_written(0), m_dropped(0)
+{
+}
+
+SimFrameCapture::~SimFrameCapture()
+{
+    stop();
+}
+
+bool SimFrameCapture::start(const char* path, CaptureFormat format, int width, int height, uint32_t rate_num, uint32_t rate_den)
+{
+    stop();
+
+    m_format = format;
+    m_path = path;
+    m_width = width;
+    m_height = height;
+    m_pipe = false;
+    m_fp = nullptr;
+
+    if (format != CaptureFormat::PNG)
+    {
+        if (path[0] == '|')
+        {
+            m_fp = popen(path + 1, "w");
+            m_pipe = true;
+        }
+        else
+        {
+            m_fp = fopen(path, "wb");
+        }
+
+        if (!m_fp)
+        {
+            printf("Failed to open capture output: %s\n", path);
+            return false;
+        }
+
+        if (format == CaptureFormat::Y4M)
+        {
+            uint32_t div = std::gcd(rate_num, rate_den);
+            fprintf(m_fp, "YUV4MPEG2 W%d H%d F%u:%u Ip A1:1 C444\n", width, height, rate_num / div, rate_den / div);
+            m_yuv.resize(width * height * 3);
+        }
+    }
+
+    // All buffers are allocated up front, nothing is allocated per frame
+    m_pool.resize(m_pool_size);
+    m_free.clear();
+    m_queue.clear();
+    for (Frame& f : m_pool)
+    {
+        f.rgb.resize(width * height * 3);
+        m_free.push_back(&f);
+    }
+
+    m_written = 0;
+    m_dropped = 0;
+    m_stop = false;
+    m_thread = std::thread(&SimFrameCapture::encoder, this);
+    m_active = true;
+
+    printf("Capturing video to %s\n", path);
+    return true;
+}
+
+void SimFrameCapture::stop()
+{
+    if (!m_active) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    m_active = false;
+
+    if (m_fp)
+    {
+        if (m_pipe)
+            pclose(m_fp);
+        else
+            fclose(m_fp);
+        m_fp = nullptr;
+    }
+
+    printf("Video capture finished, %llu frames written, %llu dropped\n",
+           (unsigned long long)m_written.load(), (unsigned long long)m_dropped);
+}
+
+void SimFrameCapture::push(const uint32_t* pixels, uint64_t frame)
+{
+    if (!m_active) return;
+
+    Frame* f = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty())
+        {
+            f = m_free.back();
+            m_free.pop_back();
+        }
+    }
+
+    if (!f)
+    {
+        m_dropped++;
+        return;
+    }
+
+    uint8_t* out = f->rgb.data();
+    const int count = m_width * m_height;
+    for( int i = 0; i < count; i++ )
+    {
+        uint32_t c = pixels[i];
+        out[0] = c >> 24;
+        out[1] = c >> 16;
+        out[2] = c >> 8;
+        out += 3;
+    }
+    f->frame = frame;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(f);
+    }
+    m_wake.notify_one();
+}
+
+bool SimFrameCapture::write_frame(Frame* f)
+{
+    const uint8_t* rgb = f->rgb.data();
+    const size_t count = m_width * m_height;
+
+    switch (m_format)
+    {
+        case CaptureFormat::PNG:
+        {
+            size_t png_size = 0;
+            void* png = tdefl_write_image_to_png_file_in_memory(rgb, m_width, m_height, 3, &png_size);
+            if (!png) return false;
+
+            char filename[512];
+            snprintf(filename, sizeof(filename), "%s_%06llu.png", m_path.c_str(), (unsigned long long)f->frame);
+            FILE* fp = fopen(filename, "wb");
+            bool ok = fp && fwrite(png, 1, png_size, fp) == png_size;
+            if (fp) fclose(fp);
+            mz_free(png);
+            return ok;
+        }
+
+        case CaptureFormat::RGB:
+            return fwrite(rgb, 3, count, m_fp) == count;
+
+        case CaptureFormat::Y4M:
+        {
+            // BT.601 limited range
+            uint8_t* y = m_yuv.data();
+            uint8_t* u = y + count;
+            uint8_t* v = u + count;
+            for( size_t i = 0; i < count; i++ )
+            {
+                int r = rgb[i * 3 + 0], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+                y[i] = (( 66 * r + 129 * g +  25 * b + 128) >> 8) + 16;
+                u[i] = ((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128;
+                v[i] = ((112 * r -  94 * g -  18 * b + 128) >> 8) + 128;
+            }
+            fputs("FRAME\n", m_fp);
+            return fwrite(m_yuv.data(), 1, m_yuv.size(), m_fp) == m_yuv.size();
+        }
+    }
+
+    return false;
+}
+
+void SimFrameCapture::encoder()
+{
+    while (true)
+    {
+        Frame* f;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) break;
+            f = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        if (write_frame(f))
+            m_written++;
+        else
+            printf("Failed to write frame %llu\n", (unsigned long long)f->frame);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(f);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+enum class CaptureFormat
+{
+    PNG,    // One file per frame, <path>_<frame>.png
+    RGB,    // Raw 24-bit RGB frames back to back
+    Y4M,    // YUV4MPEG2, 4:4:4
+};
+
+// Captures completed video frames without stalling the sim.
+//
+// Frames are copied into a fixed pool of buffers and encoded by a
+// background thread. If the encoder falls behind and the pool is empty
+// the frame is dropped and counted rather than waiting. RGB and Y4M
+// output go to a file, or to a command's stdin if the path starts
+// with '|'.
+class SimFrameCapture {
+public:
+    SimFrameCapture(int pool_size = 8);
+    ~SimFrameCapture();
+
+    // Y4M output is tagged with the frame rate rate_num/rate_den
+    bool start(const char* path, CaptureFormat format, int width, int height, uint32_t rate_num, uint32_t rate_den);
+    void stop();
+
+    // Pixels in SimVideo format (RGBX8888)
+    void push(const uint32_t* pixels, uint64_t frame);
+
+    bool active() const { return m_active; }
+    uint64_t frames_written() const { return m_written; }
+    uint64_t frames_dropped() const { return m_dropped; }
+
+private:
+    struct Frame {
+        std::vector<uint8_t> rgb;
+        uint64_t frame;
+    };
+
+    void encoder();
+    bool write_frame(Frame* f);
+
+    int m_pool_size;
+    std::vector<Frame> m_pool;
+    std::vector<Frame*> m_free;
+    std::deque<Frame*> m_queue;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+    bool m_stop;
+    bool m_active;
+
+    CaptureFormat m_format;
+    std::string m_path;
+    int m_width, m_height;
+    FILE* m_fp;
+    bool m_pipe;
+    std::vector<uint8_t> m_yuv;
+
+    std::atomic<uint64_t> m_written;
+    uint64_t m_dropped;
+};
@@ -0,0 +1,409 @@
+#include "imgui_wrap.h"
+#include "sim_cheats.h"
+#include "sim_memory_view.h"
+#include "miniz.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+extern F2* top;
+extern SimMemoryView work_ram, obj_ram, scn_ram_0, color_ram;
+
+// Extra bytes after the snapshot so a block can read a full 32-bit value
+// at its last offset
+static const size_t BLOCK_PAD = 64 + 16;
+
+static inline uint32_t read_be(const uint8_t *p, int width)
+{
+    if (width == 8) return p[0];
+    if (width == 16) return (p[0] << 8) | p[1];
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline bool compare(uint32_t a, uint32_t b, CheatCompare op)
+{
+    switch (op)
+    {
+        case CheatCompare::Equal: return a == b;
+        case CheatCompare::Changed: return a != b;
+        case CheatCompare::Increased: return a > b;
+        case CheatCompare::Decreased: return a < b;
+        case CheatCompare::Value: return a == b;
+    }
+    return false;
+}
+
+// Result bit n is set if the comparison holds for the value at offset n
+static uint64_t compare_block_scalar(const uint8_t *cur, const uint8_t *prev, int width, CheatCompare op, uint32_t value)
+{
+    uint64_t mask = 0;
+    int step = width == 8 ? 1 : 2;
+    for( int i = 0; i < 64; i += step )
+    {
+        uint32_t a = read_be(cur + i, width);
+        uint32_t b = op == CheatCompare::Value ? value : read_be(prev + i, width);
+        if (compare(a, b, op)) mask |= 1ull << i;
+    }
+    return mask;
+}
+
+#if defined(__SSE2__)
+// SSE2 only has signed compares, so bias both sides for unsigned ones
+static inline __m128i compare_lanes(__m128i a, __m128i b, __m128i bias, CheatCompare op, int width)
+{
+    if (op == CheatCompare::Increased || op == CheatCompare::Decreased)
+    {
+        a = _mm_xor_si128(a, bias);
+        b = _mm_xor_si128(b, bias);
+        if (op == CheatCompare::Decreased) std::swap(a, b);
+        if (width == 8) return _mm_cmpgt_epi8(a, b);
+        if (width == 16) return _mm_cmpgt_epi16(a, b);
+        return _mm_cmpgt_epi32(a, b);
+    }
+
+    __m128i eq;
+    if (width == 8) eq = _mm_cmpeq_epi8(a, b);
+    else if (width == 16) eq = _mm_cmpeq_epi16(a, b);
+    else eq = _mm_cmpeq_epi32(a, b);
+
+    if (op == CheatCompare::Changed) return _mm_xor_si128(eq, _mm_set1_epi32(-1));
+    return eq;
+}
+
+static inline __m128i swap16(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i swap32(__m128i v)
+{
+    v = swap16(v);
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline __m128i load_lanes(const uint8_t *p, int width)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    if (width == 16) return swap16(v);
+    if (width == 32) return swap32(v);
+    return v;
+}
+
+static uint64_t compare_block(const uint8_t *cur, const uint8_t *prev, int width, CheatCompare op, uint32_t value)
+{
+    __m128i bias, fixed;
+    if (width == 8)
+    {
+        bias = _mm_set1_epi8((char)0x80);
+        fixed = _mm_set1_epi8((char)value);
+    }
+    else if (width == 16)
+    {
+        bias = _mm_set1_epi16((short)0x8000);
+        fixed = _mm_set1_epi16((short)value);
+    }
+    else
+    {
+        bias = _mm_set1_epi32((int)0x80000000);
+        fixed = _mm_set1_epi32((int)value);
+    }
+
+    // Movemask gives one bit per byte, keep the bit for the first byte of
+    // each lane. 32-bit values at offsets 2 mod 4 take a second load.
+    uint64_t mask = 0;
+    for( int i = 0; i < 64; i += 16 )
+    {
+        uint32_t m;
+        for( int ofs = 0; ofs < (width == 32 ? 4 : 1); ofs += 2 )
+        {
+            __m128i a = load_lanes(cur + i + ofs, width);
+            __m128i b = op == CheatCompare::Value ? fixed : load_lanes(prev + i + ofs, width);
+            uint32_t bits = _mm_movemask_epi8(compare_lanes(a, b, bias, op, width));
+
+            if (width == 8) m = bits;
+            else if (width == 16) m = bits & 0x5555;
+            else if (ofs == 0) m = bits & 0x1111;
+            else m |= (bits & 0x1111) << 2;
+        }
+        mask |= (uint64_t)m << i;
+    }
+    return mask;
+}
+#else
+static uint64_t compare_block(const uint8_t *cur, const uint8_t *prev, int width, CheatCompare op, uint32_t value)
+{
+    return compare_block_scalar(cur, prev, width, op, value);
+}
+#endif
+
+void CheatSearch::reset(const uint8_t *data, size_t size, int width)
+{
+    m_width = width;
+    m_size = size;
+
+    m_current.assign(size + BLOCK_PAD, 0);
+    memcpy(m_current.data(), data, size);
+    m_previous = m_current;
+
+    // Aligned offsets where the whole value fits
+    size_t bytes = width / 8;
+    m_bitmap.assign((size + 63) / 64, 0);
+    for( size_t off = 0; off + bytes <= size; off += (width == 8 ? 1 : 2) )
+    {
+        m_bitmap[off / 64] |= 1ull << (off % 64);
+    }
+}
+
+void CheatSearch::filter(const uint8_t *data, CheatCompare op, uint32_t value)
+{
+    if (!active()) return;
+
+    m_previous.swap(m_current);
+    memcpy(m_current.data(), data, m_size);
+
+    if (m_width < 32) value &= (1u << m_width) - 1;
+
+    for( size_t block = 0; block < m_bitmap.size(); block++ )
+    {
+        if (m_bitmap[block] == 0) continue;
+        size_t off = block * 64;
+        m_bitmap[block] &= compare_block(m_current.data() + off, m_previous.data() + off, m_width, op, value);
+    }
+}
+
+size_t CheatSearch::count() const
+{
+    size_t n = 0;
+    for( uint64_t bits : m_bitmap )
+    {
+        n += __builtin_popcountll(bits);
+    }
+    return n;
+}
+
+std::vector<uint32_t> CheatSearch::candidates(size_t max) const
+{
+    std::vector<uint32_t> result;
+    for( size_t block = 0; block < m_bitmap.size() && result.size() < max; block++ )
+    {
+        uint64_t bits = m_bitmap[block];
+        while (bits && result.size() < max)
+        {
+            int bit = __builtin_ctzll(bits);
+            result.push_back((block * 64) + bit);
+            bits &= bits - 1;
+        }
+    }
+    return result;
+}
+
+uint32_t CheatSearch::value(uint32_t off) const
+{
+    return read_be(m_current.data() + off, m_width);
+}
+
+uint32_t CheatSearch::previous_value(uint32_t off) const
+{
+    return read_be(m_previous.data() + off, m_width);
+}
+
+struct CheatRegion
+{
+    const char *name;
+    SimMemoryView *view;
+    uint16_t cfg_addr;
+};
+
+// CPU base addresses come from the board config, the upper byte of each
+// cfg_addr is the address bits 23:16 it matches
+static std::vector<CheatRegion> cheat_regions()
+{
+    auto r = top->rootp;
+    return {
+        { "Work RAM", &work_ram, r->F2__DOT__cfg_addr_work_ram },
+        { "OBJ RAM", &obj_ram, r->F2__DOT__cfg_addr_obj },
+        { "Screen RAM", &scn_ram_0, r->F2__DOT__cfg_addr_screen },
+        { "Color RAM", &color_ram, r->F2__DOT__cfg_addr_color },
+    };
+}
+
+static uint32_t region_base(const CheatRegion &region)
+{
+    return (region.cfg_addr >> 8) << 16;
+}
+
+bool SimCheatFinder::export_mister(const char *path)
+{
+    mz_zip_archive zip;
+    memset(&zip, 0, sizeof(zip));
+    if (!mz_zip_writer_init_file(&zip, path, 0))
+    {
+        printf("Failed to create %s\n", path);
+        return false;
+    }
+
+    bool ok = true;
+    for( size_t i = 0; i < m_cheats.size() && ok; i++ )
+    {
+        const Cheat &cheat = m_cheats[i];
+
+        // 32-bit values are written as two word records
+        std::vector<uint32_t> records;
+        if (cheat.width == 32)
+        {
+            records.insert(records.end(), { 0, cheat.address, 0, cheat.value >> 16 });
+            records.insert(records.end(), { 0, cheat.address + 2, 0, cheat.value & 0xffff });
+        }
+        else
+        {
+            records.insert(records.end(), { 0, cheat.address, 0, cheat.value });
+        }
+
+        std::vector<uint8_t> data;
+        for( uint32_t v : records )
+        {
+            data.insert(data.end(), { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) });
+        }
+
+        char name[96];
+        if (cheat.description[0])
+            snprintf(name, sizeof(name), "%s.gg", cheat.description);
+        else
+            snprintf(name, sizeof(name), "%06X.gg", cheat.address);
+
+        ok = mz_zip_writer_add_mem(&zip, name, data.data(), data.size(), MZ_BEST_COMPRESSION);
+    }
+
+    ok = ok && mz_zip_writer_finalize_archive(&zip);
+    mz_zip_writer_end(&zip);
+
+    if (!ok) printf("Failed to write %s\n", path);
+    return ok;
+}
+
+void SimCheatFinder::draw()
+{
+    if (!ImGui::Begin("Cheat Finder"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    std::vector<CheatRegion> regions = cheat_regions();
+    static const int widths[3] = { 8, 16, 32 };
+
+    ImGui::Combo("Region", &m_region, "Work RAM\0OBJ RAM\0Screen RAM\0Color RAM\0");
+    ImGui::Combo("Width", &m_width, "8-bit\0" "16-bit\0" "32-bit\0");
+
+    if (ImGui::Button("New Search"))
+    {
+        SimMemoryView *view = regions[m_region].view;
+        view->snapshot_all();
+        m_search.reset(view->data(), view->size(), widths[m_width]);
+        m_search_region = m_region;
+    }
+
+    if (m_search.active())
+    {
+        const CheatRegion &region = regions[m_search_region];
+        int width = m_search.width();
+
+        int op = -1;
+        ImGui::SameLine();
+        if (ImGui::Button("Equal")) op = (int)CheatCompare::Equal;
+        ImGui::SameLine();
+        if (ImGui::Button("Changed")) op = (int)CheatCompare::Changed;
+        ImGui::SameLine();
+        if (ImGui::Button("Increased")) op = (int)CheatCompare::Increased;
+        ImGui::SameLine();
+        if (ImGui::Button("Decreased")) op = (int)CheatCompare::Decreased;
+
+        ImGui::SetNextItemWidth(120);
+        ImGui::InputScalar("##value", ImGuiDataType_U32, &m_value, nullptr, nullptr, "%X", ImGuiInputTextFlags_CharsHexadecimal);
+        ImGui::SameLine();
+        if (ImGui::Button("Equal To")) op = (int)CheatCompare::Value;
+
+        if (op >= 0)
+        {
+            auto start = std::chrono::steady_clock::now();
+            region.view->snapshot_all();
+            m_search.filter(region.view->data(), (CheatCompare)op, m_value);
+            auto end = std::chrono::steady_clock::now();
+            m_filter_us = std::chrono::duration<double, std::micro>(end - start).count();
+        }
+
+        ImGui::Text("%s, %d-bit: %zu candidates", region.name, width, m_search.count());
+        ImGui::Text("Last filter: %.1f us", m_filter_us);
+
+        if (ImGui::BeginTable("candidates", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY, ImVec2(0, 200)))
+        {
+            ImGui::TableSetupColumn("Address");
+            ImGui::TableSetupColumn("Value");
+            ImGui::TableSetupColumn("Previous");
+            ImGui::TableSetupColumn("");
+            ImGui::TableHeadersRow();
+
+            for( uint32_t off : m_search.candidates(256) )
+            {
+                uint32_t address = region_base(region) + off;
+                ImGui::PushID(off);
+                ImGui::TableNextColumn(); ImGui::Text("%06X", address);
+                ImGui::TableNextColumn(); ImGui::Text("%0*X", width / 4, m_search.value(off));
+                ImGui::TableNextColumn(); ImGui::Text("%0*X", width / 4, m_search.previous_value(off));
+                ImGui::TableNextColumn();
+                if (ImGui::SmallButton("Add"))
+                {
+                    Cheat cheat;
+                    memset(&cheat, 0, sizeof(cheat));
+                    cheat.address = address;
+                    cheat.width = width;
+                    cheat.value = m_search.value(off);
+                    m_cheats.push_back(cheat);
+                }
+                ImGui::PopID();
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    ImGui::Separator();
+    ImGui::Text("Cheats");
+
+    int remove = -1;
+    for( size_t i = 0; i < m_cheats.size(); i++ )
+    {
+        Cheat &cheat = m_cheats[i];
+        ImGui::PushID(i);
+        ImGui::Text("%06X %2d-bit", cheat.address, cheat.width);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(100);
+        ImGui::InputScalar("##value", ImGuiDataType_U32, &cheat.value, nullptr, nullptr, "%X", ImGuiInputTextFlags_CharsHexadecimal);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(200);
+        ImGui::InputText("##desc", cheat.description, sizeof(cheat.description));
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Remove")) remove = i;
+        ImGui::PopID();
+    }
+    if (remove >= 0) m_cheats.erase(m_cheats.begin() + remove);
+
+    ImGui::InputText("Path", m_export_path, sizeof(m_export_path));
+    ImGui::SameLine();
+    if (ImGui::Button("Export"))
+    {
+        m_status = export_mister(m_export_path) ? "Exported" : "Export failed";
+    }
+    if (!m_status.empty()) ImGui::TextUnformatted(m_status.c_str());
+
+    ImGui::End();
+}
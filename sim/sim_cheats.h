@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+enum class CheatCompare
+{
+    Equal,      // same as the last snapshot
+    Changed,
+    Increased,
+    Decreased,
+    Value,      // equal to a specific value
+};
+
+// Candidate addresses for a cheat search over snapshots of one RAM.
+//
+// Snapshots are in 68k byte order and values are read big-endian at 8, 16
+// or 32 bits. Candidates are a bitmap with one bit per byte offset, 16 and
+// 32-bit searches only use even offsets. Filters compare 64 offsets at a
+// time and skip blocks with no candidates left.
+class CheatSearch
+{
+public:
+    // Start over with every aligned offset as a candidate
+    void reset(const uint8_t *data, size_t size, int width);
+
+    // Keep candidates where data compares true against the last snapshot,
+    // or against value, then make data the last snapshot
+    void filter(const uint8_t *data, CheatCompare op, uint32_t value);
+
+    bool active() const { return m_size > 0; }
+    int width() const { return m_width; }
+    size_t count() const;
+
+    // Offsets of up to max candidates, in address order
+    std::vector<uint32_t> candidates(size_t max) const;
+
+    uint32_t value(uint32_t off) const;
+    uint32_t previous_value(uint32_t off) const;
+
+private:
+    int m_width = 8;
+    size_t m_size = 0;
+    std::vector<uint8_t> m_current;     // padded so blocks can read past the end
+    std::vector<uint8_t> m_previous;
+    std::vector<uint64_t> m_bitmap;
+};
+
+struct Cheat
+{
+    char description[64];
+    uint32_t address;   // CPU address
+    int width;
+    uint32_t value;
+};
+
+// Cheat finder window, searches the 68k visible RAMs and exports found
+// cheats in the MiSTer cheat format
+class SimCheatFinder
+{
+public:
+    void draw();
+
+    // Zip with one .gg file per cheat, each a list of 16-byte records of
+    // little-endian flags, address, compare and replace values
+    bool export_mister(const char *path);
+
+private:
+    CheatSearch m_search;
+    int m_region = 0;
+    int m_search_region = 0;
+    int m_width = 0;
+    uint32_t m_value = 0;
+    double m_filter_us = 0.0;
+    std::vector<Cheat> m_cheats;
+    char m_export_path[256] = "cheats.zip";
+    std::string m_status;
+};
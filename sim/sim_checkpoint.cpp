@@ -0,0 +1,237 @@
+#include "sim_checkpoint.h"
+#include "sim.h"
+#include "sim_state.h"
+#include "sim_sdram.h"
+#include "sim_ddr.h"
+#include "sim_video.h"
+#include "games.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+#include "verilated.h"
+#include "verilated_save.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if !defined(F2_BUILD_HASH)
+#define F2_BUILD_HASH 0
+#endif
+
+extern VerilatedContext *contextp;
+extern F2 *top;
+extern SimSDRAM sdram;
+extern SimVideo video;
+
+static const char CHECKPOINT_MAGIC[8] = { 'F', '2', 'C', 'K', 'P', 'T', 0, 0 };
+static const uint32_t CHECKPOINT_VERSION = 2;
+
+// Everything below the object ROM data can be written by the core
+static const uint32_t CHECKPOINT_DDR_SIZE = OBJ_DATA_DDR_BASE;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t build_hash;
+    uint8_t game;
+    uint8_t reserved[3];
+    uint32_t ddr_size;
+    uint32_t video_width;
+    uint32_t video_height;
+};
+
+bool save_checkpoint(const char *filename)
+{
+    VerilatedSave os;
+    os.open(filename);
+    if (!os.isOpen())
+    {
+        printf("Failed to open checkpoint file for writing: %s\n", filename);
+        return false;
+    }
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.build_hash = F2_BUILD_HASH;
+    header.game = top->game;
+    header.ddr_size = CHECKPOINT_DDR_SIZE;
+    header.video_width = video.width;
+    header.video_height = video.height;
+    os.write(&header, sizeof(header));
+
+    uint64_t time = contextp->time();
+    os << time;
+    os << total_ticks;
+    os << total_frames;
+    os << simulation_reset_until;
+    os << prev_vblank;
+
+    os << *top;
+
+    sdram.save_checkpoint(os);
+    ddr_memory.save_checkpoint(os, CHECKPOINT_DDR_SIZE);
+    video.save_checkpoint(os);
+
+    os.close();
+    return true;
+}
+
+bool restore_checkpoint(const char *filename)
+{
+    VerilatedRestore is;
+    is.open(filename);
+    if (!is.isOpen())
+    {
+        printf("Failed to open checkpoint file: %s\n", filename);
+        return false;
+    }
+
+    // Nothing is modified until the header has been checked
+    CheckpointHeader header;
+    is.read(&header, sizeof(header));
+
+    if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) || header.version != CHECKPOINT_VERSION)
+    {
+        printf("%s: not a checkpoint file or unsupported version\n", filename);
+        is.close();
+        return false;
+    }
+
+    if (header.build_hash != F2_BUILD_HASH)
+    {
+        printf("%s: checkpoint is from a different build (%08X, expected %08X)\n", filename, header.build_hash, F2_BUILD_HASH);
+        is.close();
+        return false;
+    }
+
+    if (header.game != top->game)
+    {
+        printf("%s: checkpoint is for %s, not %s\n", filename, game_name((game_t)header.game), game_name((game_t)top->game));
+        is.close();
+        return false;
+    }
+
+    if (header.ddr_size != CHECKPOINT_DDR_SIZE || (int)header.video_width != video.width || (int)header.video_height != video.height)
+    {
+        printf("%s: checkpoint layout does not match\n", filename);
+        is.close();
+        return false;
+    }
+
+    uint64_t time;
+    is >> time;
+    is >> total_ticks;
+    is >> total_frames;
+    is >> simulation_reset_until;
+    is >> prev_vblank;
+    contextp->time(time);
+
+    is >> *top;
+
+    sdram.restore_checkpoint(is);
+    ddr_memory.restore_checkpoint(is, CHECKPOINT_DDR_SIZE);
+    video.restore_checkpoint(is);
+
+    is.close();
+
+    sim_state_restored();
+    return true;
+}
+
+struct CheckedRam {
+    const char *name;
+    uint8_t *ram_h;
+    uint8_t *ram_l;
+    size_t words;
+};
+
+static std::vector<CheckedRam> checked_rams()
+{
+    auto r = top->rootp;
+    return {
+        { "SCN RAM", r->F2__DOT__scn_ram_0__DOT__ram_h.m_storage, r->F2__DOT__scn_ram_0__DOT__ram_l.m_storage, 32 * 1024 },
+        { "Color RAM", r->F2__DOT__color_ram__DOT__ram_h.m_storage, r->F2__DOT__color_ram__DOT__ram_l.m_storage, 16 * 1024 },
+        { "OBJ RAM", r->F2__DOT__obj_ram__DOT__ram_h.m_storage, r->F2__DOT__obj_ram__DOT__ram_l.m_storage, 32 * 1024 },
+        { "Work RAM", r->F2__DOT__work_ram__DOT__ram_h.m_storage, r->F2__DOT__work_ram__DOT__ram_l.m_storage, 32 * 1024 },
+        { "Pivot RAM", r->F2__DOT__pivot_ram__DOT__ram_h.m_storage, r->F2__DOT__pivot_ram__DOT__ram_l.m_storage, 4 * 1024 },
+        { "Sound RAM", r->F2__DOT__sound_ram__DOT__ram.m_storage, nullptr, 8 * 1024 },
+    };
+}
+
+static void snapshot_rams(std::vector<uint8_t> &out)
+{
+    out.clear();
+    for (const CheckedRam &ram : checked_rams())
+    {
+        out.insert(out.end(), ram.ram_h, ram.ram_h + ram.words);
+        if (ram.ram_l) out.insert(out.end(), ram.ram_l, ram.ram_l + ram.words);
+    }
+}
+
+bool verify_rtl_savestate(SimState *state, const char *scratch_filename, std::string &report)
+{
+    report.clear();
+
+    if (!save_checkpoint(scratch_filename))
+    {
+        report = "Failed to save checkpoint";
+        return false;
+    }
+
+    std::vector<uint8_t> expected, actual;
+    snapshot_rams(expected);
+
+    state->capture();
+    std::vector<uint8_t> rtl_state(state->data(), state->data() + state->size());
+
+    // Restore the RTL state on top of the original one
+    restore_checkpoint(scratch_filename);
+    bool ok = state->restore(rtl_state.data(), rtl_state.size());
+    snapshot_rams(actual);
+
+    restore_checkpoint(scratch_filename);
+
+    if (!ok)
+    {
+        report = "RTL restore failed";
+        return false;
+    }
+
+    char line[128];
+    size_t offset = 0;
+    int mismatched = 0;
+    for (const CheckedRam &ram : checked_rams())
+    {
+        size_t size = ram.ram_l ? ram.words * 2 : ram.words;
+        size_t diffs = 0;
+        size_t first = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            if (expected[offset + i] != actual[offset + i])
+            {
+                if (diffs == 0) first = i;
+                diffs++;
+            }
+        }
+
+        if (diffs)
+        {
+            // Convert back to a byte address, high bytes were stored first
+            size_t addr = ram.ram_l ? ((first % ram.words) * 2 + (first / ram.words)) : first;
+            snprintf(line, sizeof(line), "%s: %zu bytes differ, first at 0x%05zX\n", ram.name, diffs, addr);
+            report += line;
+            mismatched++;
+        }
+        offset += size;
+    }
+
+    if (mismatched == 0)
+    {
+        report = "RTL savestate matches checkpoint\n";
+    }
+
+    return mismatched == 0;
+}
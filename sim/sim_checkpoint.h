@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+class SimState;
+
+// Native checkpoints of the whole simulation, using Verilator's --savable
+// serialization of the F2 model plus the SDRAM, DDR and video harness
+// state. Restoring one resumes bit-exactly where it was saved without
+// running the RTL savestate machine, and is only valid for the same
+// build and game.
+bool save_checkpoint(const char *filename);
+bool restore_checkpoint(const char *filename);
+
+// Check the RTL savestate against a native checkpoint. Runs an RTL save
+// and restore and reports any block RAM contents that differ from the
+// checkpointed ones. The simulation is returned to where it started.
+bool verify_rtl_savestate(SimState *state, const char *scratch_filename, std::string &report);
@@ -0,0 +1,182 @@
+#include "sim_checkpoint_cache.h"
+#include "sim_checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#if !defined(F2_BUILD_HASH)
+#define F2_BUILD_HASH 0
+#endif
+
+static const char *CACHE_EXT = ".f2ckpt";
+
+SimCheckpointCache::SimCheckpointCache(const char* dir, uint64_t max_bytes)
+    : m_dir(dir), m_max_bytes(max_bytes), m_total_bytes(0)
+{
+    mkdir(dir, 0755);
+}
+
+void SimCheckpointCache::set_key(const char* game, uint64_t rom_hash, uint64_t input_hash)
+{
+    char key[128];
+    snprintf(key, sizeof(key), "%s-%016llx-%08x-%016llx", game,
+             (unsigned long long)rom_hash, (unsigned int)F2_BUILD_HASH, (unsigned long long)input_hash);
+
+    if (m_key == key) return;
+
+    m_key = key;
+    scan();
+}
+
+std::string SimCheckpointCache::path_for(uint64_t frame) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "-%010llu", (unsigned long long)frame);
+    return m_dir + "/" + m_key + name + CACHE_EXT;
+}
+
+void SimCheckpointCache::scan()
+{
+    m_frames.clear();
+    m_total_bytes = 0;
+
+    DIR* dir = opendir(m_dir.c_str());
+    if (!dir) return;
+
+    const std::string prefix = m_key + "-";
+    const size_t ext_len = strlen(CACHE_EXT);
+
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        std::string name = ent->d_name;
+        if (name.size() <= ext_len || name.compare(name.size() - ext_len, ext_len, CACHE_EXT) != 0) continue;
+
+        struct stat st;
+        if (stat((m_dir + "/" + name).c_str(), &st) != 0) continue;
+        m_total_bytes += st.st_size;
+
+        if (name.compare(0, prefix.size(), prefix) == 0)
+        {
+            uint64_t frame = strtoull(name.c_str() + prefix.size(), nullptr, 10);
+            m_frames[frame] = st.st_size;
+        }
+    }
+    closedir(dir);
+}
+
+void SimCheckpointCache::evict()
+{
+    if (m_total_bytes <= m_max_bytes) return;
+
+    struct CacheFile {
+        std::string name;
+        time_t used;
+        uint64_t size;
+    };
+    std::vector<CacheFile> files;
+
+    DIR* dir = opendir(m_dir.c_str());
+    if (!dir) return;
+
+    const size_t ext_len = strlen(CACHE_EXT);
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        std::string name = ent->d_name;
+        if (name.size() <= ext_len || name.compare(name.size() - ext_len, ext_len, CACHE_EXT) != 0) continue;
+
+        struct stat st;
+        if (stat((m_dir + "/" + name).c_str(), &st) != 0) continue;
+        files.push_back({ name, st.st_mtime, (uint64_t)st.st_size });
+    }
+    closedir(dir);
+
+    // Files are touched when restored, so the oldest modification time is
+    // the least recently used
+    std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) { return a.used < b.used; });
+
+    uint64_t total = 0;
+    for (const CacheFile& f : files) total += f.size;
+
+    const std::string prefix = m_key + "-";
+    for (const CacheFile& f : files)
+    {
+        if (total <= m_max_bytes) break;
+        if (remove((m_dir + "/" + f.name).c_str()) != 0) continue;
+        total -= f.size;
+
+        if (f.name.compare(0, prefix.size(), prefix) == 0)
+        {
+            m_frames.erase(strtoull(f.name.c_str() + prefix.size(), nullptr, 10));
+        }
+    }
+
+    m_total_bytes = total;
+}
+
+void SimCheckpointCache::update(uint64_t frame)
+{
+    if (interval <= 0 || m_key.empty()) return;
+    if (frame == 0 || (frame % interval) != 0) return;
+    if (m_frames.count(frame)) return;
+
+    // Write under a temporary name so a partial file is never picked up
+    std::string path = path_for(frame);
+    std::string tmp_path = path + ".tmp";
+    if (!save_checkpoint(tmp_path.c_str()) || rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        remove(tmp_path.c_str());
+        return;
+    }
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return;
+
+    m_frames[frame] = st.st_size;
+    m_total_bytes += st.st_size;
+    evict();
+}
+
+int64_t SimCheckpointCache::nearest(uint64_t frame) const
+{
+    auto it = m_frames.upper_bound(frame);
+    if (it == m_frames.begin()) return -1;
+    --it;
+    return it->first;
+}
+
+bool SimCheckpointCache::restore(uint64_t frame)
+{
+    auto it = m_frames.find(frame);
+    if (it == m_frames.end()) return false;
+
+    std::string path = path_for(frame);
+    if (!restore_checkpoint(path.c_str()))
+    {
+        m_total_bytes -= std::min(m_total_bytes, it->second);
+        m_frames.erase(it);
+        remove(path.c_str());
+        return false;
+    }
+
+    utime(path.c_str(), nullptr);
+    return true;
+}
+
+void SimCheckpointCache::clear()
+{
+    for (const auto& f : m_frames)
+    {
+        if (remove(path_for(f.first).c_str()) == 0)
+        {
+            m_total_bytes -= std::min(m_total_bytes, f.second);
+        }
+    }
+    m_frames.clear();
+}
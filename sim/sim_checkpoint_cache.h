@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <map>
+
+// On-disk cache of native checkpoints indexed by frame number, for jumping
+// to a frame without simulating from reset.
+//
+// Checkpoints are keyed by game, ROM hash, build hash and input hash, so
+// files from a different ROM set, core build or input sequence are never
+// used. The directory is shared by all keys and kept under a size cap by
+// deleting the least recently used files.
+class SimCheckpointCache {
+public:
+    SimCheckpointCache(const char* dir, uint64_t max_bytes);
+
+    // Identity of the current run. Changing it switches to a different set
+    // of checkpoints.
+    void set_key(const char* game, uint64_t rom_hash, uint64_t input_hash);
+
+    // Call on each frame edge, saves a checkpoint every interval frames
+    void update(uint64_t frame);
+
+    // Frame of the newest checkpoint at or before frame, or -1 if none
+    int64_t nearest(uint64_t frame) const;
+
+    // Restore the checkpoint for exactly this frame
+    bool restore(uint64_t frame);
+
+    // Delete every checkpoint for the current key
+    void clear();
+
+    int count() const { return (int)m_frames.size(); }
+    uint64_t bytes_used() const { return m_total_bytes; }
+    uint64_t max_bytes() const { return m_max_bytes; }
+    const std::string& key() const { return m_key; }
+
+    int interval = 600;
+
+private:
+    std::string path_for(uint64_t frame) const;
+    void scan();
+    void evict();
+
+    std::string m_dir;
+    std::string m_key;
+    uint64_t m_max_bytes;
+
+    // Checkpoints for the current key, frame to file size
+    std::map<uint64_t, uint64_t> m_frames;
+
+    // Size of every checkpoint in the directory
+    uint64_t m_total_bytes;
+};
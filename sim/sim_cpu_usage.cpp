@@ -0,0 +1,296 @@
+#include "imgui_wrap.h"
+#include "sim_cpu_usage.h"
+#include "sim.h"
+#include "m68k_disasm.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+extern F2* top;
+
+SimCpuUsage::SimCpuUsage()
+{
+    m_prev_as_n = true;
+    m_last_cycle = 0;
+    m_last_fetch = 0;
+    m_in_wait = false;
+    m_stopped = false;
+    m_seen_stop = false;
+
+    m_start = m_end = 0;
+    m_range_valid = false;
+
+    m_status = nullptr;
+    m_frame = 0;
+    m_frame_start = 0;
+    m_idle = 0;
+    m_resynced = false;
+
+    detect();
+}
+
+void SimCpuUsage::resync()
+{
+    m_prev_as_n = true;
+    m_last_cycle = total_ticks;
+    m_last_fetch = total_ticks;
+    m_in_wait = false;
+    m_stopped = false;
+    m_frame_start = total_ticks;
+    m_idle = 0;
+    m_resynced = true;
+}
+
+void SimCpuUsage::detect()
+{
+    m_detecting = true;
+    m_detect_frames = 0;
+    m_detect_total = 0;
+    m_fetches.clear();
+}
+
+void SimCpuUsage::set_range(uint32_t start, uint32_t end)
+{
+    m_start = std::min(start, end);
+    m_end = std::max(start, end);
+    m_range_valid = true;
+    m_detecting = false;
+    m_status = "Set";
+}
+
+void SimCpuUsage::tick()
+{
+    auto r = top->rootp;
+    bool as_n = r->F2__DOT__cpu_as_n;
+
+    if (!as_n && m_prev_as_n)
+    {
+        // Nothing on the bus for this long means a STOP
+        uint64_t gap = total_ticks - m_last_cycle;
+        if (m_stopped || gap > STOP_TICKS)
+        {
+            if (!m_in_wait) m_idle += gap;
+            m_seen_stop = true;
+        }
+        m_stopped = false;
+        m_last_cycle = total_ticks;
+
+        uint8_t fc = r->F2__DOT__cpu_fc;
+        if (fc == 2 || fc == 6) fetch(r->F2__DOT__cpu_word_addr & 0xffffff);
+    }
+    m_prev_as_n = as_n;
+}
+
+void SimCpuUsage::fetch(uint32_t addr)
+{
+    if (m_in_wait) m_idle += total_ticks - m_last_fetch;
+    m_last_fetch = total_ticks;
+    m_in_wait = m_range_valid && addr >= m_start && addr <= m_end;
+
+    if (m_detecting)
+    {
+        m_fetches[addr]++;
+        m_detect_total++;
+    }
+}
+
+void SimCpuUsage::finish_detect()
+{
+    uint32_t best = 0, best_count = 0;
+    for( const auto &it : m_fetches )
+    {
+        if (it.second > best_count)
+        {
+            best = it.first;
+            best_count = it.second;
+        }
+    }
+
+    // Every word of a tight loop is fetched about as often, including the
+    // prefetch past its branch
+    uint32_t threshold = std::max(best_count / 8, 1u);
+    auto hot = [&](uint32_t addr)
+    {
+        auto it = m_fetches.find(addr);
+        return it != m_fetches.end() && it->second >= threshold;
+    };
+
+    uint32_t start = best, end = best;
+    while (best - start < 64 && start >= 2 && hot(start - 2)) start -= 2;
+    while (end - best < 64 && hot(end + 2)) end += 2;
+
+    uint64_t in_range = 0;
+    for( uint32_t addr = start; addr <= end; addr += 2 )
+    {
+        auto it = m_fetches.find(addr);
+        if (it != m_fetches.end()) in_range += it->second;
+    }
+
+    bool found = best_count > 0 && in_range * 10 >= m_detect_total;
+
+    m_fetches.clear();
+    m_detect_frames = 0;
+    m_detect_total = 0;
+
+    if (!found)
+    {
+        // Keep looking, the game may not have reached its main loop yet
+        m_status = "No wait loop found yet";
+        return;
+    }
+
+    set_range(start, end);
+    m_status = "Detected";
+}
+
+void SimCpuUsage::frame(uint64_t frame)
+{
+    if (m_in_wait)
+    {
+        m_idle += total_ticks - m_last_fetch;
+        m_last_fetch = total_ticks;
+    }
+
+    bool stopped = m_stopped || total_ticks - m_last_cycle > STOP_TICKS;
+    if (stopped)
+    {
+        m_idle += total_ticks - m_last_cycle;
+        m_last_cycle = total_ticks;
+        m_stopped = true;
+    }
+
+    // Frame numbers go backwards on a reset or rewind, start over
+    if (!m_resynced && frame == m_frame + 1 && total_ticks > m_frame_start)
+    {
+        CpuFrameUsage usage;
+        usage.frame = m_frame;
+        usage.ticks = total_ticks - m_frame_start;
+        usage.idle = std::min(m_idle, usage.ticks);
+        usage.lag = (m_range_valid || m_seen_stop) && !m_in_wait && !stopped;
+
+        m_frames.push_back(usage);
+        if (m_frames.size() > FRAME_HISTORY) m_frames.pop_front();
+    }
+
+    m_frame = frame;
+    m_frame_start = total_ticks;
+    m_idle = 0;
+    m_resynced = false;
+
+    if (m_detecting && ++m_detect_frames >= DETECT_FRAMES) finish_detect();
+}
+
+void SimCpuUsage::print_summary() const
+{
+    if (m_frames.empty()) return;
+
+    float total = 0.0f, peak = 0.0f;
+    int lag = 0;
+    for( const CpuFrameUsage &f : m_frames )
+    {
+        total += f.utilization();
+        peak = std::max(peak, f.utilization());
+        if (f.lag) lag++;
+    }
+
+    if (m_range_valid)
+        printf("Wait loop %06X-%06X\n", m_start, m_end);
+    printf("CPU utilization over the last %zu frames: %.1f%% avg, %.1f%% max, %d lag frames\n",
+           m_frames.size(), (100.0f * total) / m_frames.size(), 100.0f * peak, lag);
+}
+
+static bool parse_address(const char *text, uint32_t *addr)
+{
+    if (find_68k_symbol_addr(text, addr)) return true;
+
+    char *end;
+    *addr = strtoul(text, &end, 16);
+    return end != text;
+}
+
+void SimCpuUsage::draw()
+{
+    if (!ImGui::Begin("CPU Usage"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (m_range_valid)
+    {
+        const char *sym = find_68k_symbol(m_start);
+        ImGui::Text("Wait loop %06X-%06X %s", m_start, m_end, sym ? sym : "");
+    }
+    else
+    {
+        ImGui::TextDisabled(m_seen_stop ? "No wait loop, idle in STOP" : "No wait loop");
+    }
+
+    if (m_detecting)
+        ImGui::Text("Detecting, %d/%d frames", m_detect_frames, DETECT_FRAMES);
+    else if (m_status)
+        ImGui::TextUnformatted(m_status);
+
+    if (ImGui::Button("Detect")) detect();
+
+    ImGui::PushItemWidth(120);
+    ImGui::InputText("Start", m_start_text, sizeof(m_start_text));
+    ImGui::SameLine();
+    ImGui::InputText("End", m_end_text, sizeof(m_end_text));
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (ImGui::Button("Set"))
+    {
+        uint32_t start, end;
+        if (parse_address(m_start_text, &start) && parse_address(m_end_text, &end))
+            set_range(start, end);
+        else
+            m_status = "Bad address";
+    }
+
+    if (m_frames.empty())
+    {
+        ImGui::End();
+        return;
+    }
+
+    std::vector<float> usage;
+    std::vector<float> lag;
+    float total = 0.0f;
+    int lag_count = 0;
+    for( const CpuFrameUsage &f : m_frames )
+    {
+        usage.push_back(100.0f * f.utilization());
+        lag.push_back(f.lag ? 1.0f : 0.0f);
+        total += f.utilization();
+        if (f.lag) lag_count++;
+    }
+
+    const CpuFrameUsage &last = m_frames.back();
+    ImGui::Text("Frame %llu: %.1f%%, average %.1f%%", (unsigned long long)last.frame,
+                100.0f * last.utilization(), (100.0f * total) / m_frames.size());
+    ImGui::Text("Lag frames: %d of %zu", lag_count, m_frames.size());
+
+    ImGui::PlotLines("##usage", usage.data(), usage.size(), 0, "Utilization %", 0.0f, 100.0f, ImVec2(0, 80));
+    ImGui::PlotHistogram("##lag", lag.data(), lag.size(), 0, "Lag", 0.0f, 1.0f, ImVec2(0, 30));
+
+    // Most recent first
+    if (lag_count && ImGui::TreeNode("Recent lag frames"))
+    {
+        int shown = 0;
+        for( auto it = m_frames.rbegin(); it != m_frames.rend() && shown < 20; ++it )
+        {
+            if (!it->lag) continue;
+            ImGui::Text("%llu  %.1f%%", (unsigned long long)it->frame, 100.0f * it->utilization());
+            shown++;
+        }
+        ImGui::TreePop();
+    }
+
+    ImGui::End();
+}
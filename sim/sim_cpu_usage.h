@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+
+// 68k time spent in the game's vblank wait loop, per frame
+struct CpuFrameUsage
+{
+    uint64_t frame;
+    uint64_t ticks;
+    uint64_t idle;
+    bool lag;           // the CPU was not waiting when vblank came
+
+    float utilization() const { return ticks ? 1.0f - (float)idle / ticks : 0.0f; }
+};
+
+// Measures 68k utilization from program fetch bus cycles.
+//
+// Fetches inside the wait loop range, and stretches with no bus cycles at
+// all from a STOP, count as idle until the next fetch outside it. The range
+// is either set directly or detected as the short run of addresses with
+// the most fetches over DETECT_FRAMES frames, retrying until one is found.
+// A frame boundary that finds the CPU outside the wait loop marks the
+// frame that just ended as a lag frame.
+class SimCpuUsage
+{
+public:
+    SimCpuUsage();
+
+    // Call after each sim tick, and at each frame boundary
+    void tick();
+    void frame(uint64_t frame);
+
+    // Start counting fetches to find the wait loop
+    void detect();
+    void set_range(uint32_t start, uint32_t end);
+
+    // Call after a state restore, the frame in progress is dropped
+    void resync();
+
+    bool has_range() const { return m_range_valid; }
+    uint32_t range_start() const { return m_start; }
+    uint32_t range_end() const { return m_end; }
+
+    // Completed frames, oldest first
+    const std::deque<CpuFrameUsage> &frames() const { return m_frames; }
+
+    void print_summary() const;
+
+    void draw();
+
+private:
+    static const size_t FRAME_HISTORY = 600;
+    static const int DETECT_FRAMES = 60;
+
+    // Longer than any instruction goes without a bus cycle
+    static const uint64_t STOP_TICKS = 1024;
+
+    void fetch(uint32_t addr);
+    void finish_detect();
+
+    bool m_prev_as_n;
+    uint64_t m_last_cycle;
+    uint64_t m_last_fetch;
+    bool m_in_wait;
+    bool m_stopped;         // idle in a STOP at the last frame boundary
+    bool m_seen_stop;
+
+    uint32_t m_start, m_end;
+    bool m_range_valid;
+
+    bool m_detecting;
+    int m_detect_frames;
+    uint64_t m_detect_total;
+    std::unordered_map<uint32_t, uint32_t> m_fetches;
+    const char *m_status;
+
+    uint64_t m_frame;
+    uint64_t m_frame_start;
+    bool m_resynced;
+    uint64_t m_idle;
+    std::deque<CpuFrameUsage> m_frames;
+
+    // Range inputs, symbols or hex addresses
+    char m_start_text[64] = "";
+    char m_end_text[64] = "";
+};
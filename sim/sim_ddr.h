@@ -6,6 +6,7 @@
 #include <vector>
 #include <string>
 #include "file_search.h"
+#include "verilated_save.h"
 
 // Class to simulate a 64-bit wide memory device
 class SimDDR
@@ -23,6 +24,10 @@ public:
         busy_counter = 0;
         burst_counter = 0;
         burst_size = 0;
+        load_hash = 0xcbf29ce484222325ull;
+        pending_read = false;
+        pending_addr = 0;
+        pending_rdata = 0;
     }
     
     // Load data from a file into memory at specified offset with optional stride
@@ -56,6 +61,13 @@ public:
             }
         }
         
+        load_hash = (load_hash ^ offset) * 0x100000001b3ull;
+        load_hash = (load_hash ^ stride) * 0x100000001b3ull;
+        for (uint8_t byte : buffer)
+        {
+            load_hash = (load_hash ^ byte) * 0x100000001b3ull;
+        }
+
         printf("Loaded %zu bytes from %s at offset 0x%08X with stride %u\n", 
                buffer.size(), filename.c_str(), offset, stride);
         return true;
@@ -246,6 +258,38 @@ public:
         return memory[index];
     }
     
+    // Checkpoint support. Only the first `length` bytes are saved, memory
+    // above that holds ROM data that is reloaded with the game.
+    void save_checkpoint(VerilatedSerialize& os, size_t length)
+    {
+        os.write(&read_latency, sizeof(read_latency));
+        os.write(&write_latency, sizeof(write_latency));
+        os.write(&busy, sizeof(busy));
+        os.write(&busy_counter, sizeof(busy_counter));
+        os.write(&read_complete, sizeof(read_complete));
+        os.write(&pending_read, sizeof(pending_read));
+        os.write(&pending_addr, sizeof(pending_addr));
+        os.write(&pending_rdata, sizeof(pending_rdata));
+        os.write(&burst_counter, sizeof(burst_counter));
+        os.write(&burst_size, sizeof(burst_size));
+        os.write(memory.data(), length);
+    }
+
+    void restore_checkpoint(VerilatedDeserialize& is, size_t length)
+    {
+        is.read(&read_latency, sizeof(read_latency));
+        is.read(&write_latency, sizeof(write_latency));
+        is.read(&busy, sizeof(busy));
+        is.read(&busy_counter, sizeof(busy_counter));
+        is.read(&read_complete, sizeof(read_complete));
+        is.read(&pending_read, sizeof(pending_read));
+        is.read(&pending_addr, sizeof(pending_addr));
+        is.read(&pending_rdata, sizeof(pending_rdata));
+        is.read(&burst_counter, sizeof(burst_counter));
+        is.read(&burst_size, sizeof(burst_size));
+        is.read(memory.data(), length);
+    }
+
     // Memory parameters
     void set_read_latency(int cycles) { read_latency = cycles; }
     void set_write_latency(int cycles) { write_latency = cycles; }
@@ -253,6 +297,9 @@ public:
     std::vector<uint8_t> memory;
     size_t size;
 
+    // FNV-1a hash of every file loaded and where it went
+    uint64_t load_hash;
+
 private:
    
     // Memory timing parameters
@@ -0,0 +1,377 @@
+#include "sim_input.h"
+#include "sim_sdram.h"
+#include "sim_ddr.h"
+#include "games.h"
+#include "imgui_wrap.h"
+
+#include "F2.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const char MOVIE_MAGIC[8] = { 'F', '2', 'M', 'O', 'V', 'I', 'E', 0 };
+static const uint32_t MOVIE_VERSION = 1;
+
+struct MovieHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t frame_size;
+    char game_name[16];
+    uint8_t game;
+    uint8_t reserved[3];
+    uint32_t num_frames;
+    uint64_t rom_hash;
+};
+
+static_assert(sizeof(InputFrame) == 20, "InputFrame is part of the movie format");
+
+static const int STICK_THRESHOLD = 16384;
+static const int ANALOG_DEADZONE = 4096;
+
+// MiSTer joystick bits
+enum {
+    JOY_RIGHT = 1 << 0,
+    JOY_LEFT = 1 << 1,
+    JOY_DOWN = 1 << 2,
+    JOY_UP = 1 << 3,
+    JOY_B1 = 1 << 4,
+    JOY_B2 = 1 << 5,
+    JOY_B3 = 1 << 6,
+    JOY_B4 = 1 << 7,
+    JOY_B5 = 1 << 8,
+    JOY_B6 = 1 << 9,
+};
+
+// Signed 8-bit position for the TC0220IOC paddle inputs, zero inside the
+// deadzone so a resting stick doesn't count as live input
+static uint8_t analog_axis(int value)
+{
+    if (value > -ANALOG_DEADZONE && value < ANALOG_DEADZONE) return 0;
+    return (uint8_t)(int8_t)(value >> 8);
+}
+
+static uint64_t rom_hash()
+{
+    return sdram.load_hash ^ (ddr_memory.load_hash * 0x100000001b3ull);
+}
+
+SimInput::SimInput(F2* top)
+    : m_top(top), m_recording(false), m_playing(false), m_frame(0), m_num_joysticks(-1)
+{
+    memset(&m_live, 0, sizeof(m_live));
+    memset(&m_current, 0, sizeof(m_current));
+    memset(m_controllers, 0, sizeof(m_controllers));
+}
+
+SimInput::~SimInput()
+{
+    for (int i = 0; i < MAX_CONTROLLERS; i++)
+    {
+        if (m_controllers[i]) SDL_GameControllerClose(m_controllers[i]);
+    }
+}
+
+void SimInput::open_controllers()
+{
+    for (int i = 0; i < MAX_CONTROLLERS; i++)
+    {
+        if (m_controllers[i]) SDL_GameControllerClose(m_controllers[i]);
+        m_controllers[i] = nullptr;
+    }
+
+    int player = 0;
+    for (int i = 0; i < m_num_joysticks && player < MAX_CONTROLLERS; i++)
+    {
+        if (!SDL_IsGameController(i)) continue;
+        m_controllers[player] = SDL_GameControllerOpen(i);
+        if (m_controllers[player]) player++;
+    }
+}
+
+void SimInput::poll(uint8_t dswa, uint8_t dswb, bool sync_fix)
+{
+    // Reopen everything when a device is plugged in or removed
+    int num_joysticks = SDL_NumJoysticks();
+    if (num_joysticks != m_num_joysticks)
+    {
+        m_num_joysticks = num_joysticks;
+        open_controllers();
+    }
+
+    InputFrame in;
+    memset(&in, 0, sizeof(in));
+    in.dswa = dswa;
+    in.dswb = dswb;
+    in.sync_fix = sync_fix ? 1 : 0;
+
+    for (int i = 0; i < MAX_CONTROLLERS; i++)
+    {
+        SDL_GameController* pad = m_controllers[i];
+        if (!pad) continue;
+
+        uint16_t joy = 0;
+        int x = SDL_GameControllerGetAxis(pad, SDL_CONTROLLER_AXIS_LEFTX);
+        int y = SDL_GameControllerGetAxis(pad, SDL_CONTROLLER_AXIS_LEFTY);
+
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_DPAD_RIGHT) || x > STICK_THRESHOLD) joy |= JOY_RIGHT;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_DPAD_LEFT) || x < -STICK_THRESHOLD) joy |= JOY_LEFT;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_DPAD_DOWN) || y > STICK_THRESHOLD) joy |= JOY_DOWN;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_DPAD_UP) || y < -STICK_THRESHOLD) joy |= JOY_UP;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_A)) joy |= JOY_B1;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_B)) joy |= JOY_B2;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_X)) joy |= JOY_B3;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_Y)) joy |= JOY_B4;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_LEFTSHOULDER)) joy |= JOY_B5;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_RIGHTSHOULDER)) joy |= JOY_B6;
+
+        in.joystick[i] = joy;
+        if (i == 0) in.analog_p1 = analog_axis(x);
+        if (i == 1) in.analog_p2 = analog_axis(x);
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_START)) in.start |= 1 << i;
+        if (SDL_GameControllerGetButton(pad, SDL_CONTROLLER_BUTTON_BACK)) in.coin |= 1 << i;
+    }
+
+    // Keyboard is player 1, arrows, ZXCVBN, 1/2 for start and 5/6 for coins
+    // No ImGui context when running headless, and no window to take keys
+    if (keyboard_enabled && ImGui::GetCurrentContext() && !ImGui::GetIO().WantTextInput)
+    {
+        const uint8_t* keys = SDL_GetKeyboardState(nullptr);
+
+        uint16_t joy = 0;
+        if (keys[SDL_SCANCODE_RIGHT]) joy |= JOY_RIGHT;
+        if (keys[SDL_SCANCODE_LEFT]) joy |= JOY_LEFT;
+        if (keys[SDL_SCANCODE_DOWN]) joy |= JOY_DOWN;
+        if (keys[SDL_SCANCODE_UP]) joy |= JOY_UP;
+        if (keys[SDL_SCANCODE_Z]) joy |= JOY_B1;
+        if (keys[SDL_SCANCODE_X]) joy |= JOY_B2;
+        if (keys[SDL_SCANCODE_C]) joy |= JOY_B3;
+        if (keys[SDL_SCANCODE_V]) joy |= JOY_B4;
+        if (keys[SDL_SCANCODE_B]) joy |= JOY_B5;
+        if (keys[SDL_SCANCODE_N]) joy |= JOY_B6;
+        in.joystick[0] |= joy;
+
+        if (keys[SDL_SCANCODE_1]) in.start |= 1;
+        if (keys[SDL_SCANCODE_2]) in.start |= 2;
+        if (keys[SDL_SCANCODE_5]) in.coin |= 1;
+        if (keys[SDL_SCANCODE_6]) in.coin |= 2;
+    }
+
+    // Paddles are absolute positions, as in the core's default analog mode.
+    // Without a stick, left and right steer like its joystick mode does.
+    in.analog_abs = 1;
+    if (in.analog_p1 == 0) in.analog_p1 = (in.joystick[0] & JOY_RIGHT) ? 0x40 : (in.joystick[0] & JOY_LEFT) ? 0xc0 : 0x00;
+    if (in.analog_p2 == 0) in.analog_p2 = (in.joystick[1] & JOY_RIGHT) ? 0x40 : (in.joystick[1] & JOY_LEFT) ? 0xc0 : 0x00;
+
+    m_live = in;
+}
+
+bool SimInput::live_active() const
+{
+    InputFrame idle;
+    memset(&idle, 0, sizeof(idle));
+    idle.analog_abs = m_live.analog_abs;
+    idle.dswa = m_live.dswa;
+    idle.dswb = m_live.dswb;
+    idle.sync_fix = m_live.sync_fix;
+    return memcmp(&idle, &m_live, sizeof(idle)) != 0;
+}
+
+void SimInput::apply(const InputFrame& in)
+{
+    m_top->joystick_p1 = in.joystick[0];
+    m_top->joystick_p2 = in.joystick[1];
+    m_top->joystick_p3 = in.joystick[2];
+    m_top->joystick_p4 = in.joystick[3];
+    m_top->start = in.start;
+    m_top->coin = in.coin;
+    m_top->analog_inc = in.analog_inc;
+    m_top->analog_abs = in.analog_abs;
+    m_top->analog_p1 = in.analog_p1;
+    m_top->analog_p2 = in.analog_p2;
+    m_top->dswa = in.dswa;
+    m_top->dswb = in.dswb;
+    m_top->sync_fix = in.sync_fix;
+    m_current = in;
+}
+
+void SimInput::on_frame(uint64_t frame)
+{
+    m_frame = frame;
+
+    if (m_playing)
+    {
+        if (frame < m_movie.size())
+        {
+            apply(m_movie[frame]);
+            return;
+        }
+
+        printf("Movie finished at frame %llu\n", (unsigned long long)frame);
+        m_playing = false;
+    }
+
+    if (m_recording)
+    {
+        // Going back in time (rewind) drops everything after that point
+        m_movie.resize(frame);
+        m_movie.push_back(m_live);
+    }
+
+    apply(m_live);
+}
+
+void SimInput::start_recording()
+{
+    m_movie.clear();
+    m_playing = false;
+    m_recording = true;
+}
+
+void SimInput::start_playback()
+{
+    m_recording = false;
+    m_playing = !m_movie.empty();
+}
+
+void SimInput::stop()
+{
+    m_recording = false;
+    m_playing = false;
+}
+
+uint64_t SimInput::movie_hash() const
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const uint8_t* p = (const uint8_t*)m_movie.data();
+    for (size_t i = 0; i < m_movie.size() * sizeof(InputFrame); i++)
+    {
+        hash = (hash ^ p[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool SimInput::save_movie(const char* filename)
+{
+    FILE* fp = fopen(filename, "wb");
+    if (!fp)
+    {
+        printf("Failed to open movie file for writing: %s\n", filename);
+        return false;
+    }
+
+    MovieHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MOVIE_MAGIC, sizeof(header.magic));
+    header.version = MOVIE_VERSION;
+    header.frame_size = sizeof(InputFrame);
+    strncpy(header.game_name, game_name((game_t)m_top->game), sizeof(header.game_name) - 1);
+    header.game = m_top->game;
+    header.num_frames = m_movie.size();
+    header.rom_hash = rom_hash();
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (ok && !m_movie.empty())
+    {
+        ok = fwrite(m_movie.data(), sizeof(InputFrame), m_movie.size(), fp) == m_movie.size();
+    }
+    fclose(fp);
+
+    if (!ok)
+    {
+        printf("Failed to write movie file: %s\n", filename);
+        return false;
+    }
+
+    printf("Saved %zu frames of input to %s\n", m_movie.size(), filename);
+    return true;
+}
+
+bool SimInput::load_movie(const char* filename)
+{
+    FILE* fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        printf("Failed to open movie file: %s\n", filename);
+        return false;
+    }
+
+    MovieHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, MOVIE_MAGIC, sizeof(header.magic)) ||
+        header.version != MOVIE_VERSION || header.frame_size != sizeof(InputFrame))
+    {
+        printf("%s: not a movie file or unsupported version\n", filename);
+        fclose(fp);
+        return false;
+    }
+
+    header.game_name[sizeof(header.game_name) - 1] = '\0';
+    if (header.game != m_top->game)
+    {
+        printf("%s: movie is for %s, not %s\n", filename, header.game_name, game_name((game_t)m_top->game));
+        fclose(fp);
+        return false;
+    }
+
+    if (header.rom_hash != rom_hash())
+    {
+        printf("%s: warning, movie was recorded with different ROMs\n", filename);
+    }
+
+    std::vector<InputFrame> movie(header.num_frames);
+    if (header.num_frames && fread(movie.data(), sizeof(InputFrame), header.num_frames, fp) != header.num_frames)
+    {
+        printf("%s: truncated movie file\n", filename);
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+
+    stop();
+    m_movie.swap(movie);
+
+    printf("Loaded %zu frames of input from %s\n", m_movie.size(), filename);
+    return true;
+}
+
+void SimInput::draw()
+{
+    if (ImGui::Begin("Input"))
+    {
+        ImGui::Checkbox("Keyboard", &keyboard_enabled);
+        ImGui::SameLine();
+        int pads = 0;
+        for (int i = 0; i < MAX_CONTROLLERS; i++)
+        {
+            if (m_controllers[i]) pads++;
+        }
+        ImGui::Text("%d controllers", pads);
+
+        if (m_recording)
+            ImGui::Text("Recording, %zu frames", m_movie.size());
+        else if (m_playing)
+            ImGui::Text("Playing, frame %llu/%zu", (unsigned long long)m_frame, m_movie.size());
+        else
+            ImGui::Text("Live, movie has %zu frames", m_movie.size());
+
+        if (ImGui::BeginTable("ports", 2, ImGuiTableFlags_Borders))
+        {
+            for( int i = 0; i < 4; i++ )
+            {
+                ImGui::TableNextColumn();
+                ImGui::Text("P%d", i + 1);
+                ImGui::TableNextColumn();
+                ImGui::Text("%03X", m_current.joystick[i]);
+            }
+            ImGui::TableNextColumn(); ImGui::Text("Start/Coin");
+            ImGui::TableNextColumn(); ImGui::Text("%X / %X", m_current.start, m_current.coin);
+            ImGui::TableNextColumn(); ImGui::Text("Analog");
+            ImGui::TableNextColumn(); ImGui::Text("%02X %02X inc:%d abs:%d", m_current.analog_p1, m_current.analog_p2,
+                                                  m_current.analog_inc, m_current.analog_abs);
+            ImGui::TableNextColumn(); ImGui::Text("DSW");
+            ImGui::TableNextColumn(); ImGui::Text("%02X %02X%s", m_current.dswa, m_current.dswb, m_current.sync_fix ? " sync fix" : "");
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
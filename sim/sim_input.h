@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <SDL.h>
+
+class F2;
+
+// Values of every F2 input port for one frame
+struct InputFrame {
+    uint16_t joystick[4];   // joystick_p1..p4, MiSTer layout (R,L,D,U,B1..B6)
+    uint8_t start;
+    uint8_t coin;
+    uint8_t analog_inc;
+    uint8_t analog_abs;
+    uint8_t analog_p1;
+    uint8_t analog_p2;
+    uint8_t dswa;
+    uint8_t dswb;
+    uint8_t sync_fix;       // changes video timing, so it is part of the run
+    uint8_t reserved[3];
+};
+
+// Drives the F2 input ports once per frame, from live SDL keyboard and
+// game controller input or from a recorded movie.
+//
+// Ports only change on frame edges so a movie played back from reset
+// reproduces the recorded run exactly.
+class SimInput {
+public:
+    SimInput(F2* top);
+    ~SimInput();
+
+    // Sample keyboard and controllers, call once per UI update. Dipswitches
+    // and the sync fix setting come from the caller.
+    void poll(uint8_t dswa, uint8_t dswb, bool sync_fix);
+
+    // Call on each frame edge and once at reset with frame 0
+    void on_frame(uint64_t frame);
+
+    // Recording and playback both start from reset, the caller is
+    // responsible for resetting the core.
+    void start_recording();
+    void start_playback();
+    void stop();
+
+    bool save_movie(const char* filename);
+    bool load_movie(const char* filename);
+
+    bool recording() const { return m_recording; }
+    bool playing() const { return m_playing; }
+    size_t movie_frames() const { return m_movie.size(); }
+
+    // True if the live input has anything pressed
+    bool live_active() const;
+
+    // Identifies the movie contents, for keying cached checkpoints
+    uint64_t movie_hash() const;
+
+    void draw();
+
+    bool keyboard_enabled = true;
+
+private:
+    void apply(const InputFrame& in);
+    void open_controllers();
+
+    F2* m_top;
+    InputFrame m_live;
+    InputFrame m_current;
+
+    std::vector<InputFrame> m_movie;
+    bool m_recording;
+    bool m_playing;
+    uint64_t m_frame;
+
+    static const int MAX_CONTROLLERS = 4;
+    SDL_GameController* m_controllers[MAX_CONTROLLERS];
+    int m_num_joysticks;
+};
@@ -0,0 +1,253 @@
+#include "imgui_wrap.h"
+#include "sim_irq_latency.h"
+#include "sim.h"
+#include "m68k_disasm.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <string>
+#include <vector>
+
+extern F2* top;
+
+static const char *level_names[IRQ_LEVEL_COUNT] = { "vblank", "dma" };
+static const int level_numbers[IRQ_LEVEL_COUNT] = { 5, 6 };
+
+void IrqStats::add(uint32_t latency)
+{
+    count++;
+    sum += latency;
+    sum_sq += (double)latency * latency;
+    min = std::min(min, latency);
+    max = std::max(max, latency);
+    histogram[latency]++;
+}
+
+double IrqStats::stddev() const
+{
+    if (count == 0) return 0.0;
+    double m = mean();
+    return sqrt(std::max(0.0, (sum_sq / count) - (m * m)));
+}
+
+SimIrqLatency::SimIrqLatency()
+{
+    m_prev_as_n = true;
+    clear();
+}
+
+void SimIrqLatency::clear()
+{
+    for( int l = 0; l < IRQ_LEVEL_COUNT; l++ )
+    {
+        m_prev_req[l] = false;
+        m_pending[l] = false;
+        m_request_tick[l] = 0;
+        m_iack_tick[l] = 0;
+        m_current.iack[l] = -1;
+        m_current.entry[l] = -1;
+        m_stats[l] = IrqStats();
+    }
+    m_entering = -1;
+    m_current.frame = 0;
+    m_frames.clear();
+}
+
+// The restored state may be from before the requests in progress were
+// raised, so their ticks mean nothing now. Requests already raised in the
+// restored state are skipped since their start is unknown.
+void SimIrqLatency::resync()
+{
+    auto r = top->rootp;
+
+    m_prev_req[IRQ_VBLANK] = r->F2__DOT__int_req1 != 0;
+    m_prev_req[IRQ_DMA] = r->F2__DOT__int_req2 != 0;
+    for( int l = 0; l < IRQ_LEVEL_COUNT; l++ )
+    {
+        m_pending[l] = false;
+    }
+    m_entering = -1;
+    m_prev_as_n = r->F2__DOT__cpu_as_n;
+}
+
+void SimIrqLatency::tick()
+{
+    auto r = top->rootp;
+
+    bool as_n = r->F2__DOT__cpu_as_n;
+    if (!as_n && m_prev_as_n)
+    {
+        uint8_t fc = r->F2__DOT__cpu_fc;
+        uint32_t addr = r->F2__DOT__cpu_word_addr & 0xffffff;
+
+        if (fc == 7)
+        {
+            // A3-A1 hold the level being acknowledged
+            int level = (addr >> 1) & 7;
+            for( int l = 0; l < IRQ_LEVEL_COUNT; l++ )
+            {
+                if (level_numbers[l] == level && m_pending[l])
+                {
+                    m_iack_tick[l] = total_ticks;
+                    m_entering = l;
+                }
+            }
+        }
+        else if ((fc == 2 || fc == 6) && m_entering >= 0)
+        {
+            int l = m_entering;
+            uint32_t iack = m_iack_tick[l] - m_request_tick[l];
+            uint32_t entry = total_ticks - m_request_tick[l];
+
+            m_stats[l].add(entry);
+            m_stats[l].handler = addr;
+            if (m_current.entry[l] < 0)
+            {
+                m_current.iack[l] = iack;
+                m_current.entry[l] = entry;
+            }
+
+            m_pending[l] = false;
+            m_entering = -1;
+        }
+    }
+    m_prev_as_n = as_n;
+
+    // Requests are cleared by their acknowledge cycle, or by a reset
+    bool req[IRQ_LEVEL_COUNT] = { r->F2__DOT__int_req1 != 0, r->F2__DOT__int_req2 != 0 };
+    for( int l = 0; l < IRQ_LEVEL_COUNT; l++ )
+    {
+        if (req[l] && !m_prev_req[l] && !m_pending[l])
+        {
+            m_pending[l] = true;
+            m_request_tick[l] = total_ticks;
+        }
+        else if (!req[l] && m_pending[l] && m_entering != l)
+        {
+            m_pending[l] = false;
+        }
+        m_prev_req[l] = req[l];
+    }
+}
+
+void SimIrqLatency::frame(uint64_t frame)
+{
+    if (frame == m_current.frame + 1)
+    {
+        m_frames.push_back(m_current);
+        if (m_frames.size() > FRAME_HISTORY) m_frames.pop_front();
+    }
+
+    m_current.frame = frame;
+    for( int l = 0; l < IRQ_LEVEL_COUNT; l++ )
+    {
+        m_current.iack[l] = -1;
+        m_current.entry[l] = -1;
+    }
+}
+
+void SimIrqLatency::print_summary() const
+{
+    for( int l = 0; l < IRQ_LEVEL_COUNT; l++ )
+    {
+        const IrqStats &s = m_stats[l];
+        if (s.count == 0) continue;
+        printf("Level %d (%s) latency: %llu interrupts, %u-%u ticks, %.1f mean, %.1f stddev\n",
+               level_numbers[l], level_names[l], (unsigned long long)s.count, s.min, s.max, s.mean(), s.stddev());
+    }
+}
+
+void SimIrqLatency::write_json(FILE *fp, const char *indent) const
+{
+    fprintf(fp, "{\n");
+    for( int l = 0; l < IRQ_LEVEL_COUNT; l++ )
+    {
+        const IrqStats &s = m_stats[l];
+        fprintf(fp, "%s  \"%s\": {\n", indent, level_names[l]);
+        fprintf(fp, "%s    \"level\": %d,\n", indent, level_numbers[l]);
+        fprintf(fp, "%s    \"count\": %llu,\n", indent, (unsigned long long)s.count);
+        if (s.count)
+        {
+            fprintf(fp, "%s    \"handler\": %u,\n", indent, s.handler);
+            fprintf(fp, "%s    \"min\": %u,\n", indent, s.min);
+            fprintf(fp, "%s    \"max\": %u,\n", indent, s.max);
+            fprintf(fp, "%s    \"mean\": %.2f,\n", indent, s.mean());
+            fprintf(fp, "%s    \"stddev\": %.2f,\n", indent, s.stddev());
+            fprintf(fp, "%s    \"jitter\": %u,\n", indent, s.max - s.min);
+        }
+
+        fprintf(fp, "%s    \"histogram\": {", indent);
+        const char *sep = "";
+        for( const auto &it : s.histogram )
+        {
+            fprintf(fp, "%s\"%u\": %llu", sep, it.first, (unsigned long long)it.second);
+            sep = ", ";
+        }
+        fprintf(fp, "}\n%s  }%s\n", indent, l + 1 < IRQ_LEVEL_COUNT ? "," : "");
+    }
+    fprintf(fp, "%s}", indent);
+}
+
+void SimIrqLatency::draw()
+{
+    if (!ImGui::Begin("Interrupt Latency"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::Button("Clear")) clear();
+
+    for( int l = 0; l < IRQ_LEVEL_COUNT; l++ )
+    {
+        const IrqStats &s = m_stats[l];
+        ImGui::PushID(l);
+        ImGui::SeparatorText(l == IRQ_VBLANK ? "Level 5, vblank" : "Level 6, OBJ DMA");
+
+        if (s.count == 0)
+        {
+            ImGui::TextDisabled("None handled");
+            ImGui::PopID();
+            continue;
+        }
+
+        const char *sym = find_68k_symbol(s.handler);
+        ImGui::Text("Handler %06X %s", s.handler, sym ? sym : "");
+        ImGui::Text("%llu handled, %u-%u ticks, mean %.1f, stddev %.1f, jitter %u",
+                    (unsigned long long)s.count, s.min, s.max, s.mean(), s.stddev(), s.max - s.min);
+
+        if (!m_frames.empty())
+        {
+            const IrqFrameLatency &last = m_frames.back();
+            if (last.entry[l] >= 0)
+                ImGui::Text("Last frame: %d to acknowledge, %d to handler", last.iack[l], last.entry[l]);
+        }
+
+        // Frames without this interrupt plot as zero
+        std::vector<float> per_frame;
+        for( const IrqFrameLatency &f : m_frames )
+        {
+            per_frame.push_back(std::max(f.entry[l], 0));
+        }
+        ImGui::PlotLines("##per_frame", per_frame.data(), per_frame.size(), 0, "Ticks per frame", 0.0f, FLT_MAX, ImVec2(0, 60));
+
+        // Distribution over up to 32 bins between min and max
+        uint32_t range = s.max - s.min + 1;
+        int bins = std::min<uint32_t>(range, 32);
+        std::vector<float> histogram(bins, 0.0f);
+        for( const auto &it : s.histogram )
+        {
+            histogram[((uint64_t)(it.first - s.min) * bins) / range] += it.second;
+        }
+        std::string label = std::to_string(s.min) + "-" + std::to_string(s.max) + " ticks";
+        ImGui::PlotHistogram("##histogram", histogram.data(), bins, 0, label.c_str(), 0.0f, FLT_MAX, ImVec2(0, 60));
+
+        ImGui::PopID();
+    }
+
+    ImGui::End();
+}
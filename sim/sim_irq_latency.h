@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+
+// Interrupt levels raised by F2.sv, level 5 on the start of vblank and
+// level 6 when the TC0200OBJ DMA (EDMAn) finishes
+enum IrqLevel
+{
+    IRQ_VBLANK,
+    IRQ_DMA,
+    IRQ_LEVEL_COUNT
+};
+
+// Latencies in sim ticks for the interrupts handled in one frame, -1 for
+// none. Only the first of each level in a frame is kept.
+struct IrqFrameLatency
+{
+    uint64_t frame;
+    int32_t iack[IRQ_LEVEL_COUNT];      // request to the acknowledge cycle
+    int32_t entry[IRQ_LEVEL_COUNT];     // request to the handler's first fetch
+};
+
+// All-time latency distribution for one level
+struct IrqStats
+{
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    double sum_sq = 0.0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint32_t handler = 0;               // address of the last handler entered
+    std::map<uint32_t, uint64_t> histogram;
+
+    void add(uint32_t latency);
+    double mean() const { return count ? (double)sum / count : 0.0; }
+    double stddev() const;
+};
+
+// Measures interrupt latency from the int_req1/int_req2 requests through
+// the 68k acknowledge cycle to the first instruction fetch of the handler.
+// The interrupts are autovectored, so the first program fetch after the
+// acknowledge cycle of a level is its handler, level5_handler and
+// level6_handler in the test ROMs.
+class SimIrqLatency
+{
+public:
+    SimIrqLatency();
+
+    // Call after each sim tick, and at each frame boundary
+    void tick();
+    void frame(uint64_t frame);
+
+    void clear();
+
+    // Call after a state restore, requests in progress are dropped
+    void resync();
+
+    const IrqStats &stats(int level) const { return m_stats[level]; }
+    const std::deque<IrqFrameLatency> &frames() const { return m_frames; }
+
+    void print_summary() const;
+
+    // Statistics and histograms as a JSON object
+    void write_json(FILE *fp, const char *indent) const;
+
+    void draw();
+
+private:
+    static const size_t FRAME_HISTORY = 600;
+
+    bool m_prev_req[IRQ_LEVEL_COUNT];
+    bool m_prev_as_n;
+
+    // Request in progress for each level
+    bool m_pending[IRQ_LEVEL_COUNT];
+    uint64_t m_request_tick[IRQ_LEVEL_COUNT];
+    uint64_t m_iack_tick[IRQ_LEVEL_COUNT];
+    int m_entering;                     // level acknowledged, waiting for its first fetch
+
+    IrqFrameLatency m_current;
+    std::deque<IrqFrameLatency> m_frames;
+    IrqStats m_stats[IRQ_LEVEL_COUNT];
+};
@@ -0,0 +1,174 @@
+#include "sim_memory_view.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Interleave high and low bytes into 68k byte order. Bytes that differ
+// from what dest held get an age of 0, the rest age by one.
+static void interleave_words(const uint8_t *high, const uint8_t *low, uint8_t *dest, uint8_t *age, size_t words)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128i one = _mm_set1_epi8(1);
+    for( ; i + 16 <= words; i += 16 )
+    {
+        __m128i h = _mm_loadu_si128((const __m128i *)(high + i));
+        __m128i l = _mm_loadu_si128((const __m128i *)(low + i));
+        __m128i *d = (__m128i *)(dest + (i * 2));
+        __m128i *a = (__m128i *)(age + (i * 2));
+
+        __m128i bytes0 = _mm_unpacklo_epi8(h, l);
+        __m128i bytes1 = _mm_unpackhi_epi8(h, l);
+        __m128i same0 = _mm_cmpeq_epi8(bytes0, _mm_loadu_si128(d));
+        __m128i same1 = _mm_cmpeq_epi8(bytes1, _mm_loadu_si128(d + 1));
+        _mm_storeu_si128(a, _mm_and_si128(_mm_adds_epu8(_mm_loadu_si128(a), one), same0));
+        _mm_storeu_si128(a + 1, _mm_and_si128(_mm_adds_epu8(_mm_loadu_si128(a + 1), one), same1));
+        _mm_storeu_si128(d, bytes0);
+        _mm_storeu_si128(d + 1, bytes1);
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t one = vdupq_n_u8(1);
+    for( ; i + 16 <= words; i += 16 )
+    {
+        uint8x16x2_t bytes = vzipq_u8(vld1q_u8(high + i), vld1q_u8(low + i));
+        uint8_t *d = dest + (i * 2);
+        uint8_t *a = age + (i * 2);
+
+        uint8x16_t same0 = vceqq_u8(bytes.val[0], vld1q_u8(d));
+        uint8x16_t same1 = vceqq_u8(bytes.val[1], vld1q_u8(d + 16));
+        vst1q_u8(a, vandq_u8(vqaddq_u8(vld1q_u8(a), one), same0));
+        vst1q_u8(a + 16, vandq_u8(vqaddq_u8(vld1q_u8(a + 16), one), same1));
+        vst1q_u8(d, bytes.val[0]);
+        vst1q_u8(d + 16, bytes.val[1]);
+    }
+#endif
+
+    for( ; i < words; i++ )
+    {
+        uint8_t h = high[i];
+        uint8_t l = low[i];
+        uint8_t *d = dest + (i * 2);
+        uint8_t *a = age + (i * 2);
+        a[0] = d[0] == h ? (a[0] == 255 ? 255 : a[0] + 1) : 0;
+        a[1] = d[1] == l ? (a[1] == 255 ? 255 : a[1] + 1) : 0;
+        d[0] = h;
+        d[1] = l;
+    }
+}
+
+SimMemoryView::SimMemoryView(ArrayFn high, ArrayFn low, size_t size) : MemoryEditor()
+{
+    m_high = high;
+    m_low = low;
+    m_size = size;
+    m_frame = 1;
+
+    m_shadow.assign(size, 0);
+    m_age.assign(size, 255);
+    m_chunk_frame.assign((size + CHUNK_SIZE - 1) / CHUNK_SIZE, 0);
+
+    ReadFn = read_byte;
+    WriteFn = write_byte;
+    BgColorFn = bg_color;
+    UserData = this;
+}
+
+void SimMemoryView::refresh_chunk(size_t chunk)
+{
+    size_t start = chunk * CHUNK_SIZE;
+    size_t end = start + CHUNK_SIZE;
+    if (end > m_size) end = m_size;
+
+    bool first = m_chunk_frame[chunk] == 0;
+    interleave_words(m_high() + (start / 2), m_low() + (start / 2), &m_shadow[start], &m_age[start], (end - start) / 2);
+
+    // Nothing to compare against the first time
+    if (first) memset(&m_age[start], 255, end - start);
+
+    m_chunk_frame[chunk] = m_frame;
+}
+
+void SimMemoryView::snapshot(size_t start, size_t end)
+{
+    if (end > m_size) end = m_size;
+    if (start >= end) return;
+
+    for( size_t chunk = start / CHUNK_SIZE; chunk <= (end - 1) / CHUNK_SIZE; chunk++ )
+    {
+        refresh_chunk(chunk);
+    }
+}
+
+void SimMemoryView::flush_writes()
+{
+    if (m_writes.empty()) return;
+
+    uint8_t *high = m_high();
+    uint8_t *low = m_low();
+    for( const PendingWrite &w : m_writes )
+    {
+        if (w.off & 1)
+            low[w.off >> 1] = w.value;
+        else
+            high[w.off >> 1] = w.value;
+    }
+    m_writes.clear();
+}
+
+void SimMemoryView::DrawContents()
+{
+    m_frame++;
+    if (m_frame == 0) m_frame = 1;
+
+    MemoryEditor::DrawContents(m_shadow.data(), m_size);
+    flush_writes();
+}
+
+void SimMemoryView::DrawContents(const uint8_t *data)
+{
+    bool read_only = ReadOnly;
+    ReadOnly = true;
+    ReadFn = nullptr;
+    BgColorFn = nullptr;
+
+    MemoryEditor::DrawContents((void *)data, m_size);
+
+    ReadOnly = read_only;
+    ReadFn = read_byte;
+    BgColorFn = bg_color;
+}
+
+ImU8 SimMemoryView::read_byte(const ImU8 *, size_t off, void *user_data)
+{
+    SimMemoryView *view = (SimMemoryView *)user_data;
+    size_t chunk = off / CHUNK_SIZE;
+    if (view->m_chunk_frame[chunk] != view->m_frame) view->refresh_chunk(chunk);
+    return view->m_shadow[off];
+}
+
+void SimMemoryView::write_byte(ImU8 *, size_t off, ImU8 d, void *user_data)
+{
+    SimMemoryView *view = (SimMemoryView *)user_data;
+    view->m_shadow[off] = d;
+    view->m_writes.push_back({ off, d });
+}
+
+ImU32 SimMemoryView::bg_color(const ImU8 *, size_t off, void *user_data)
+{
+    SimMemoryView *view = (SimMemoryView *)user_data;
+    if (!view->highlight_changes) return 0;
+
+    // Colors are asked for before the byte is read
+    size_t chunk = off / CHUNK_SIZE;
+    if (view->m_chunk_frame[chunk] != view->m_frame) view->refresh_chunk(chunk);
+
+    uint8_t age = view->m_age[off];
+    if (age >= 8) return 0;
+    return IM_COL32(255, 140, 0, 160 - (age * 18));
+}
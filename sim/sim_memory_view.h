@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "imgui.h"
+#include "imgui_memory_editor.h"
+
+// Memory editor for a 16-bit Verilated RAM split into high and low byte
+// arrays.
+//
+// Rather than reading the RTL arrays for every visible byte, the editor
+// works on an interleaved shadow copy in 68k byte order. Each 256-byte
+// chunk is refreshed from the RTL at most once per drawn frame, the first
+// time something reads it, and edits are queued and written back after
+// drawing. Bytes that differed from the previous refresh of their chunk
+// are highlighted, fading over the following refreshes.
+class SimMemoryView : public MemoryEditor
+{
+public:
+    typedef uint8_t *(*ArrayFn)();
+
+    // The arrays are looked up on use since the model does not exist yet
+    // when views are constructed. size is in bytes.
+    SimMemoryView(ArrayFn high, ArrayFn low, size_t size);
+
+    void DrawContents();
+
+    // Show a copy of the RAM in 68k byte order instead, read-only
+    void DrawContents(const uint8_t *data);
+
+    // Refresh a byte range of the shadow copy from the RTL
+    void snapshot(size_t start, size_t end);
+    void snapshot_all() { snapshot(0, m_size); }
+
+    // Shadow copy, valid for whatever was last refreshed
+    const uint8_t *data() const { return m_shadow.data(); }
+    size_t size() const { return m_size; }
+
+    // Snapshots since the byte last changed, saturating at 255
+    uint8_t change_age(size_t off) const { return m_age[off]; }
+
+    bool highlight_changes = true;
+
+private:
+    static const size_t CHUNK_SIZE = 256;
+
+    void refresh_chunk(size_t chunk);
+    void flush_writes();
+
+    static ImU8 read_byte(const ImU8 *mem, size_t off, void *user_data);
+    static void write_byte(ImU8 *mem, size_t off, ImU8 d, void *user_data);
+    static ImU32 bg_color(const ImU8 *mem, size_t off, void *user_data);
+
+    ArrayFn m_high, m_low;
+    size_t m_size;
+    uint32_t m_frame;
+
+    std::vector<uint8_t> m_shadow;
+    std::vector<uint8_t> m_age;
+    std::vector<uint32_t> m_chunk_frame;    // frame each chunk was refreshed
+
+    struct PendingWrite { size_t off; uint8_t value; };
+    std::vector<PendingWrite> m_writes;
+};
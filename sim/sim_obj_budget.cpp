@@ -0,0 +1,170 @@
+#include "imgui_wrap.h"
+#include "sim_obj_budget.h"
+#include "sim.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <vector>
+
+extern F2* top;
+
+static const char *stat_names[OBJ_STAT_COUNT] =
+{
+    "Read", "Drawn", "No tile", "Offscreen", "Ignore extra", "Ignore all",
+    "Tile beats", "FB beats", "Scan beats", "Draw cycles", "Pace cycles"
+};
+
+const char *obj_stat_name(int stat)
+{
+    if (stat < 0 || stat >= OBJ_STAT_COUNT) return "?";
+    return stat_names[stat];
+}
+
+SimObjBudget::SimObjBudget()
+{
+    clear();
+}
+
+void SimObjBudget::clear()
+{
+    m_synced = false;
+    m_vbl_count = 0;
+    m_overflows = 0;
+    m_frames.clear();
+}
+
+void SimObjBudget::tick()
+{
+    auto r = top->rootp;
+
+    uint32_t vbl_count = r->F2__DOT__tc0200obj__DOT__obj_vbl_count;
+    if (m_synced && vbl_count == m_vbl_count) return;
+
+    auto &stat = r->F2__DOT__tc0200obj__DOT__obj_stat;
+
+    // The counters jump on a reset or state load, start over from there
+    if (m_synced && vbl_count == m_vbl_count + 1)
+    {
+        ObjFrameBudget budget;
+        budget.frame = total_frames;
+        for( int s = 0; s < OBJ_STAT_COUNT; s++ )
+        {
+            budget.stats[s] = stat[s] - m_stat_start[s];
+        }
+        budget.remaining = r->F2__DOT__tc0200obj__DOT__obj_vbl_remaining;
+        budget.unread = r->F2__DOT__tc0200obj__DOT__obj_vbl_unread;
+        budget.max_late = r->F2__DOT__tc0200obj__DOT__obj_vbl_max_late;
+
+        if (budget.overflow()) m_overflows++;
+
+        m_frames.push_back(budget);
+        if (m_frames.size() > FRAME_HISTORY) m_frames.pop_front();
+    }
+
+    for( int s = 0; s < OBJ_STAT_COUNT; s++ )
+    {
+        m_stat_start[s] = stat[s];
+    }
+    m_vbl_count = vbl_count;
+    m_synced = true;
+}
+
+void SimObjBudget::print_summary() const
+{
+    if (m_frames.empty()) return;
+
+    double frames = m_frames.size();
+    printf("TC0200OBJ per frame over the last %zu frames:\n", m_frames.size());
+    for( int s = 0; s < OBJ_STAT_COUNT; s++ )
+    {
+        uint64_t total = 0;
+        uint32_t worst = 0;
+        for( const ObjFrameBudget &f : m_frames )
+        {
+            total += f.stats[s];
+            worst = std::max(worst, f.stats[s]);
+        }
+        printf("  %-13s %10.1f avg %10u max\n", stat_names[s], total / frames, worst);
+    }
+
+    uint32_t min_remaining = UINT32_MAX, max_late = 0;
+    int overflow = 0;
+    for( const ObjFrameBudget &f : m_frames )
+    {
+        if (f.overflow())
+            overflow++;
+        else
+            min_remaining = std::min(min_remaining, f.remaining);
+        max_late = std::max(max_late, f.max_late);
+    }
+
+    if (overflow < (int)m_frames.size())
+        printf("  Fewest cycles remaining at vblank: %u\n", min_remaining);
+    printf("  Furthest behind pacing: %u cycles, %d overflow frames\n", max_late, overflow);
+}
+
+void SimObjBudget::draw()
+{
+    if (!ImGui::Begin("OBJ Budget"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::Button("Clear")) clear();
+    ImGui::SameLine();
+    ImGui::Text("%llu overflow frames", (unsigned long long)m_overflows);
+
+    if (m_frames.empty())
+    {
+        ImGui::End();
+        return;
+    }
+
+    const ObjFrameBudget &last = m_frames.back();
+    ImGui::Text("Frame %llu: %u of %u entries read, %u drawn, %u no tile, %u offscreen",
+                (unsigned long long)last.frame, last.stats[OBJ_STAT_READ], OBJ_LIST_SIZE,
+                last.stats[OBJ_STAT_DRAWN], last.stats[OBJ_STAT_NO_TILE], last.stats[OBJ_STAT_OFFSCREEN]);
+    ImGui::Text("Ignore extra %u, ignore all %u",
+                last.stats[OBJ_STAT_IGNORE_EXTRA], last.stats[OBJ_STAT_IGNORE_ALL]);
+    ImGui::Text("Draw cycles %u of %u budget, %u waiting on pacing",
+                last.stats[OBJ_STAT_DRAW_CYCLES], OBJ_CYCLE_BUDGET, last.stats[OBJ_STAT_PACE_CYCLES]);
+    if (last.overflow())
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Overflow, %u entries dropped", last.unread);
+    else
+        ImGui::Text("%u cycles remaining at vblank", last.remaining);
+    ImGui::Text("Furthest behind pacing: %u cycles", last.max_late);
+    ImGui::Text("DDR beats: tile %u, framebuffer %u, scanout %u",
+                last.stats[OBJ_STAT_TILE_BEATS], last.stats[OBJ_STAT_FB_BEATS], last.stats[OBJ_STAT_SCAN_BEATS]);
+
+    std::vector<float> drawn, skipped, remaining, late, dropped, tile, fb;
+    for( const ObjFrameBudget &f : m_frames )
+    {
+        drawn.push_back(f.stats[OBJ_STAT_DRAWN]);
+        skipped.push_back(f.stats[OBJ_STAT_NO_TILE] + f.stats[OBJ_STAT_OFFSCREEN]);
+        remaining.push_back(f.remaining);
+        late.push_back(f.max_late);
+        dropped.push_back(f.unread);
+        tile.push_back(f.stats[OBJ_STAT_TILE_BEATS]);
+        fb.push_back(f.stats[OBJ_STAT_FB_BEATS]);
+    }
+
+    ImGui::SeparatorText("Sprites");
+    ImGui::PlotLines("##drawn", drawn.data(), drawn.size(), 0, "Drawn", 0.0f, OBJ_LIST_SIZE, ImVec2(0, 60));
+    ImGui::PlotLines("##skipped", skipped.data(), skipped.size(), 0, "Skipped", 0.0f, OBJ_LIST_SIZE, ImVec2(0, 60));
+    ImGui::PlotHistogram("##dropped", dropped.data(), dropped.size(), 0, "Dropped at vblank", 0.0f, FLT_MAX, ImVec2(0, 40));
+
+    ImGui::SeparatorText("Time");
+    ImGui::PlotLines("##remaining", remaining.data(), remaining.size(), 0, "Cycles remaining at vblank", 0.0f, FLT_MAX, ImVec2(0, 60));
+    ImGui::PlotLines("##late", late.data(), late.size(), 0, "Cycles behind pacing", 0.0f, FLT_MAX, ImVec2(0, 60));
+
+    ImGui::SeparatorText("DDR");
+    ImGui::PlotLines("##tile", tile.data(), tile.size(), 0, "Tile fetch beats", 0.0f, FLT_MAX, ImVec2(0, 60));
+    ImGui::PlotLines("##fb", fb.data(), fb.size(), 0, "Framebuffer write beats", 0.0f, FLT_MAX, ImVec2(0, 60));
+
+    ImGui::End();
+}
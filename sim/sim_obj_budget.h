@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+
+// Counters from the obj_stat registers in tc0200obj.sv
+enum ObjStat
+{
+    OBJ_STAT_READ,
+    OBJ_STAT_DRAWN,
+    OBJ_STAT_NO_TILE,
+    OBJ_STAT_OFFSCREEN,
+    OBJ_STAT_IGNORE_EXTRA,
+    OBJ_STAT_IGNORE_ALL,
+    OBJ_STAT_TILE_BEATS,
+    OBJ_STAT_FB_BEATS,
+    OBJ_STAT_SCAN_BEATS,
+    OBJ_STAT_DRAW_CYCLES,
+    OBJ_STAT_PACE_CYCLES,
+    OBJ_STAT_COUNT
+};
+
+const char *obj_stat_name(int stat);
+
+// ce_13m cycles the pacing allows for the full sprite list of 835 entries
+static const uint32_t OBJ_CYCLE_BUDGET = 213760;
+static const uint32_t OBJ_LIST_SIZE = 835;
+
+// TC0200OBJ work between two of its vblank edges
+struct ObjFrameBudget
+{
+    uint64_t frame;
+    uint32_t stats[OBJ_STAT_COUNT];
+    uint32_t remaining;     // ce_13m cycles between the end of the list and vblank
+    uint32_t unread;        // list entries not reached before vblank
+    uint32_t max_late;      // furthest an entry started behind its pacing slot
+
+    bool overflow() const { return unread != 0; }
+};
+
+// Samples the TC0200OBJ budget counters at each of its vblank edges.
+//
+// Entries are only read once read_pacing reaches their 256 cycle slot, so
+// an engine that keeps up finishes a little after OBJ_CYCLE_BUDGET with
+// the remaining cycles to spare. One that falls behind shows a growing
+// max_late, and if vblank arrives before the list ends the unread entries
+// are dropped for that frame.
+class SimObjBudget
+{
+public:
+    SimObjBudget();
+
+    // Call after each sim tick
+    void tick();
+
+    void clear();
+
+    // Call after a state restore, the frame in progress is dropped
+    void resync() { m_synced = false; }
+
+    // Completed frames, oldest first
+    const std::deque<ObjFrameBudget> &frames() const { return m_frames; }
+
+    void print_summary() const;
+
+    void draw();
+
+private:
+    static const size_t FRAME_HISTORY = 600;
+
+    uint32_t m_vbl_count;
+    bool m_synced;
+    uint32_t m_stat_start[OBJ_STAT_COUNT];
+
+    std::deque<ObjFrameBudget> m_frames;
+    uint64_t m_overflows;
+};
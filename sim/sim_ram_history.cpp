@@ -0,0 +1,428 @@
+#include "imgui_wrap.h"
+#include "sim_ram_history.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Chunks are encoded the same way as SimRewind deltas. Each run is a header
+// of two 16-bit counts, the number of unchanged words to skip followed by
+// the number of changed words, then the changed words XORed with the
+// original.
+static const size_t CHUNK_WORDS = 1024 / 4;
+
+SimRamHistory::SimRamHistory(size_t budget)
+    : m_budget(budget), m_bytes(0), m_since_key(0)
+{
+}
+
+int SimRamHistory::add_region(const char *name, ArrayFn high, ArrayFn low, size_t size)
+{
+    if (size == 0 || size % CHUNK_SIZE || size > CHUNK_SIZE * 64)
+    {
+        printf("RAM history: bad size %zu for %s\n", size, name);
+        return -1;
+    }
+
+    clear();
+
+    Region region;
+    region.name = name;
+    region.high = high;
+    region.low = low;
+    region.size = size;
+    region.last.assign(size, 0);
+    region.cached_frame = 0;
+    region.view_valid = false;
+    m_regions.push_back(region);
+
+    if (m_current.size() < size) m_current.resize(size);
+    if (m_zero.size() < size) m_zero.resize(size, 0);
+
+    return (int)m_regions.size() - 1;
+}
+
+void SimRamHistory::clear()
+{
+    m_frames.clear();
+    m_bytes = 0;
+    m_since_key = 0;
+    viewing = false;
+    invalidate_views();
+}
+
+void SimRamHistory::invalidate_views()
+{
+    for( Region &region : m_regions )
+    {
+        region.view_valid = false;
+    }
+}
+
+void SimRamHistory::read_region(const Region &region, uint8_t *dest) const
+{
+    const uint8_t *high = region.high();
+    if (!region.low)
+    {
+        memcpy(dest, high, region.size);
+        return;
+    }
+
+    const uint8_t *low = region.low();
+    for( size_t i = 0; i < region.size / 2; i++ )
+    {
+        dest[i * 2] = high[i];
+        dest[(i * 2) + 1] = low[i];
+    }
+}
+
+size_t SimRamHistory::encode_chunk(const uint8_t *a, const uint8_t *b, uint8_t *out) const
+{
+    uint8_t *start = out;
+    uint32_t wa, wb;
+
+    size_t i = 0;
+    while (i < CHUNK_WORDS)
+    {
+        uint16_t skip = 0;
+        while (i < CHUNK_WORDS)
+        {
+            memcpy(&wa, a + i * 4, 4);
+            memcpy(&wb, b + i * 4, 4);
+            if (wa != wb) break;
+            i++;
+            skip++;
+        }
+        if (i == CHUNK_WORDS) break;
+
+        uint8_t *header = out;
+        out += 4;
+
+        uint16_t changed = 0;
+        while (i < CHUNK_WORDS)
+        {
+            memcpy(&wa, a + i * 4, 4);
+            memcpy(&wb, b + i * 4, 4);
+            uint32_t x = wa ^ wb;
+            if (x == 0) break;
+            memcpy(out, &x, 4);
+            out += 4;
+            i++;
+            changed++;
+        }
+
+        uint16_t counts[2] = { skip, changed };
+        memcpy(header, counts, 4);
+    }
+
+    return out - start;
+}
+
+size_t SimRamHistory::frame_bytes(const Frame &f) const
+{
+    return sizeof(Frame) + (f.masks.size() * 8) + (f.offsets.size() * 4) + f.data.size();
+}
+
+void SimRamHistory::record(uint64_t frame)
+{
+    if (!recording || m_regions.empty()) return;
+
+    bool gap = m_frames.empty() || frame != newest_frame() + 1;
+    if (!m_frames.empty() && frame <= newest_frame())
+    {
+        while (!m_frames.empty() && m_frames.back().frame >= frame)
+        {
+            m_bytes -= frame_bytes(m_frames.back());
+            m_frames.pop_back();
+        }
+        invalidate_views();
+    }
+
+    Frame f;
+    f.frame = frame;
+    f.key = gap || m_since_key + 1 >= KEY_INTERVAL;
+    f.masks.assign(m_regions.size(), 0);
+
+    // Worst case is alternating changed/unchanged words
+    uint8_t encoded[(CHUNK_SIZE * 2) + 8];
+
+    for( size_t r = 0; r < m_regions.size(); r++ )
+    {
+        Region &region = m_regions[r];
+        read_region(region, m_current.data());
+        const uint8_t *base = f.key ? m_zero.data() : region.last.data();
+
+        for( size_t chunk = 0; chunk < region.size / CHUNK_SIZE; chunk++ )
+        {
+            size_t ofs = chunk * CHUNK_SIZE;
+            if (memcmp(m_current.data() + ofs, base + ofs, CHUNK_SIZE) == 0) continue;
+
+            size_t size = encode_chunk(m_current.data() + ofs, base + ofs, encoded);
+            f.masks[r] |= 1ull << chunk;
+            f.offsets.push_back(f.data.size());
+            f.data.insert(f.data.end(), encoded, encoded + size);
+        }
+
+        memcpy(region.last.data(), m_current.data(), region.size);
+    }
+    f.offsets.push_back(f.data.size());
+    f.data.shrink_to_fit();
+
+    m_since_key = f.key ? 0 : m_since_key + 1;
+    m_bytes += frame_bytes(f);
+    m_frames.push_back(std::move(f));
+
+    while (m_bytes > m_budget)
+    {
+        size_t before = m_frames.size();
+        drop_oldest();
+        if (m_frames.size() == before) break;
+    }
+}
+
+// Drop frames up to the next key frame, the newest key frame is kept
+void SimRamHistory::drop_oldest()
+{
+    size_t next_key = 1;
+    while (next_key < m_frames.size() && !m_frames[next_key].key) next_key++;
+    if (next_key >= m_frames.size()) return;
+
+    for( size_t i = 0; i < next_key; i++ )
+    {
+        m_bytes -= frame_bytes(m_frames.front());
+        m_frames.pop_front();
+    }
+}
+
+int64_t SimRamHistory::find_index(uint64_t frame) const
+{
+    auto it = std::lower_bound(m_frames.begin(), m_frames.end(), frame,
+                               [](const Frame &f, uint64_t n) { return f.frame < n; });
+    if (it == m_frames.end() || it->frame != frame) return -1;
+    return it - m_frames.begin();
+}
+
+int SimRamHistory::chunk_index(const Frame &f, int region, size_t chunk) const
+{
+    uint64_t mask = f.masks[region];
+    if (!(mask & (1ull << chunk))) return -1;
+
+    int index = 0;
+    for( int r = 0; r < region; r++ )
+    {
+        index += __builtin_popcountll(f.masks[r]);
+    }
+    return index + __builtin_popcountll(mask & ((1ull << chunk) - 1));
+}
+
+void SimRamHistory::apply_frame(const Frame &f, int region, uint8_t *dest) const
+{
+    uint64_t mask = f.masks[region];
+    if (!mask) return;
+
+    int index = chunk_index(f, region, __builtin_ctzll(mask));
+
+    while (mask)
+    {
+        size_t chunk = __builtin_ctzll(mask);
+        mask &= mask - 1;
+
+        const uint8_t *delta = f.data.data() + f.offsets[index];
+        const uint8_t *end = f.data.data() + f.offsets[index + 1];
+        uint8_t *d = dest + (chunk * CHUNK_SIZE);
+        index++;
+
+        while (delta < end)
+        {
+            uint16_t counts[2];
+            memcpy(counts, delta, 4);
+            delta += 4;
+
+            d += counts[0] * 4;
+            for( uint32_t i = 0; i < counts[1]; i++ )
+            {
+                uint32_t x, w;
+                memcpy(&x, delta, 4);
+                memcpy(&w, d, 4);
+                w ^= x;
+                memcpy(d, &w, 4);
+                delta += 4;
+                d += 4;
+            }
+        }
+    }
+}
+
+uint8_t SimRamHistory::delta_byte(const Frame &f, int region, uint32_t offset) const
+{
+    int index = chunk_index(f, region, offset / CHUNK_SIZE);
+    if (index < 0) return 0;
+
+    const uint8_t *delta = f.data.data() + f.offsets[index];
+    const uint8_t *end = f.data.data() + f.offsets[index + 1];
+    uint32_t target = (offset % CHUNK_SIZE) / 4;
+    uint32_t word = 0;
+
+    while (delta < end)
+    {
+        uint16_t counts[2];
+        memcpy(counts, delta, 4);
+        delta += 4;
+
+        word += counts[0];
+        if (target < word) return 0;
+        if (target < word + counts[1]) return delta[((target - word) * 4) + (offset % 4)];
+        word += counts[1];
+        delta += counts[1] * 4;
+    }
+    return 0;
+}
+
+const uint8_t *SimRamHistory::contents(int region, uint64_t frame)
+{
+    if (region < 0 || region >= (int)m_regions.size()) return nullptr;
+
+    int64_t index = find_index(frame);
+    if (index < 0) return nullptr;
+
+    Region &r = m_regions[region];
+    if (r.view_valid && r.cached_frame == frame) return r.view.data();
+
+    int64_t key = index;
+    while (!m_frames[key].key) key--;
+
+    // Carry on from the cached frame when it is on the way
+    int64_t start = key;
+    if (r.view_valid && r.cached_frame >= m_frames[key].frame && r.cached_frame < frame)
+    {
+        int64_t cached = find_index(r.cached_frame);
+        if (cached >= 0) start = cached + 1;
+    }
+
+    if (start == key) r.view.assign(r.size, 0);
+    for( int64_t i = start; i <= index; i++ )
+    {
+        apply_frame(m_frames[i], region, r.view.data());
+    }
+
+    r.cached_frame = frame;
+    r.view_valid = true;
+    return r.view.data();
+}
+
+int64_t SimRamHistory::find_change(int region, uint32_t offset, int width, uint64_t before) const
+{
+    if (region < 0 || region >= (int)m_regions.size()) return -1;
+    if (offset + width > m_regions[region].size) return -1;
+
+    uint8_t value[4];
+    bool have_value = false;
+    int64_t result = -1;
+
+    for( const Frame &f : m_frames )
+    {
+        if (f.frame > before) break;
+
+        uint8_t v[4];
+        for( int i = 0; i < width; i++ )
+        {
+            uint8_t d = delta_byte(f, region, offset + i);
+            v[i] = f.key ? d : value[i] ^ d;
+        }
+
+        if (have_value && memcmp(v, value, width) != 0) result = f.frame;
+        memcpy(value, v, width);
+        have_value = true;
+    }
+
+    return result;
+}
+
+void SimRamHistory::draw()
+{
+    if (!ImGui::Begin("RAM History"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("Recording", &recording);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) clear();
+
+    ImGui::Text("%zu frames, %llu-%llu, %zu/%zu KB", count(),
+                (unsigned long long)oldest_frame(), (unsigned long long)newest_frame(),
+                bytes_used() / 1024, budget() / 1024);
+
+    if (empty())
+    {
+        viewing = false;
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Checkbox("View Past Frame", &viewing);
+    if (viewing)
+    {
+        uint64_t oldest = oldest_frame();
+        uint64_t newest = newest_frame();
+        view_frame = std::clamp(view_frame, oldest, newest);
+
+        if (ImGui::ArrowButton("##prev", ImGuiDir_Left) && view_frame > oldest) view_frame--;
+        ImGui::SameLine();
+        if (ImGui::ArrowButton("##next", ImGuiDir_Right) && view_frame < newest) view_frame++;
+        ImGui::SameLine();
+        ImGui::SliderScalar("Frame", ImGuiDataType_U64, &view_frame, &oldest, &newest);
+
+        if (find_index(view_frame) < 0) ImGui::TextDisabled("Frame %llu was not recorded", (unsigned long long)view_frame);
+    }
+
+    ImGui::SeparatorText("Find Change");
+
+    if (ImGui::BeginCombo("Region", m_regions[m_find_region].name))
+    {
+        for( int r = 0; r < (int)m_regions.size(); r++ )
+        {
+            if (ImGui::Selectable(m_regions[r].name, r == m_find_region)) m_find_region = r;
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::InputScalar("Offset", ImGuiDataType_U32, &m_find_offset, nullptr, nullptr, "%X", ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::Combo("Width", &m_find_width, "8-bit\0" "16-bit\0" "32-bit\0");
+
+    int width = 1 << m_find_width;
+    if (ImGui::Button("Find Previous Change"))
+    {
+        // Searching again from a found frame steps further back
+        uint64_t before = viewing ? std::max<uint64_t>(view_frame, 1) - 1 : newest_frame();
+        m_find_result = find_change(m_find_region, m_find_offset, width, before);
+        if (m_find_result >= 0)
+        {
+            viewing = true;
+            view_frame = m_find_result;
+        }
+    }
+
+    if (m_find_result == -1)
+    {
+        ImGui::TextDisabled("No change recorded");
+    }
+    else if (m_find_result >= 0)
+    {
+        ImGui::Text("Changed at frame %llu", (unsigned long long)m_find_result);
+    }
+
+    uint64_t frame = viewing ? view_frame : newest_frame();
+    const uint8_t *data = contents(m_find_region, frame);
+    if (data && m_find_offset + width <= region_size(m_find_region))
+    {
+        uint32_t value = 0;
+        for( int i = 0; i < width; i++ )
+        {
+            value = (value << 8) | data[m_find_offset + i];
+        }
+        ImGui::Text("Value at frame %llu: %0*X", (unsigned long long)frame, width * 2, value);
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Per-frame history of a set of RAMs for inspecting past contents.
+//
+// Each recorded frame stores every RAM as an XOR delta against the frame
+// before it. RAMs are split into 1KB chunks, unchanged chunks are not
+// stored at all and changed chunks use the same run-length encoded word
+// deltas as SimRewind. Every KEY_INTERVAL frames, and after any gap in the
+// recorded frames, a key frame is stored as a delta against zeroes so the
+// oldest frames can be dropped once the memory budget is used up.
+class SimRamHistory
+{
+public:
+    typedef uint8_t *(*ArrayFn)();
+
+    explicit SimRamHistory(size_t budget);
+
+    // A 16-bit RAM as high and low byte arrays, or an 8-bit RAM when low is
+    // null. size is in bytes, a multiple of 1KB up to 64KB. Returns the
+    // region index.
+    int add_region(const char *name, ArrayFn high, ArrayFn low, size_t size);
+
+    // Call at each frame boundary. A frame at or before the newest recorded
+    // one, after a reset or rewind, discards the frames from there on.
+    void record(uint64_t frame);
+
+    void clear();
+
+    int region_count() const { return (int)m_regions.size(); }
+    const char *region_name(int region) const { return m_regions[region].name; }
+    size_t region_size(int region) const { return m_regions[region].size; }
+
+    bool empty() const { return m_frames.empty(); }
+    uint64_t oldest_frame() const { return m_frames.empty() ? 0 : m_frames.front().frame; }
+    uint64_t newest_frame() const { return m_frames.empty() ? 0 : m_frames.back().frame; }
+    size_t count() const { return m_frames.size(); }
+    size_t bytes_used() const { return m_bytes; }
+    size_t budget() const { return m_budget; }
+
+    // Region contents in 68k byte order as of a recorded frame, null if
+    // the frame is not recorded. Valid until the next call for the same
+    // region.
+    const uint8_t *contents(int region, uint64_t frame);
+
+    // Most recent recorded frame, no later than before, where any of the
+    // bytes [offset, offset + width) differ from the frame before it.
+    // Returns -1 if there is none.
+    int64_t find_change(int region, uint32_t offset, int width, uint64_t before) const;
+
+    // While viewing, memory editors show contents(region, view_frame)
+    // instead of the live RAM
+    bool viewing = false;
+    uint64_t view_frame = 0;
+
+    bool recording = true;
+
+    void draw();
+
+private:
+    static const size_t CHUNK_SIZE = 1024;
+    static const int KEY_INTERVAL = 60;
+
+    struct Region
+    {
+        const char *name;
+        ArrayFn high, low;
+        size_t size;
+        std::vector<uint8_t> last;      // contents at the newest frame
+
+        // Reconstruction cache for contents()
+        std::vector<uint8_t> view;
+        uint64_t cached_frame;
+        bool view_valid;
+    };
+
+    struct Frame
+    {
+        uint64_t frame;
+        bool key;
+        std::vector<uint64_t> masks;    // per region, chunks that are stored
+        std::vector<uint32_t> offsets;  // start of each stored chunk, then the end
+        std::vector<uint8_t> data;
+    };
+
+    void read_region(const Region &region, uint8_t *dest) const;
+    size_t encode_chunk(const uint8_t *a, const uint8_t *b, uint8_t *out) const;
+    void apply_frame(const Frame &f, int region, uint8_t *dest) const;
+    int chunk_index(const Frame &f, int region, size_t chunk) const;
+    uint8_t delta_byte(const Frame &f, int region, uint32_t offset) const;
+    size_t frame_bytes(const Frame &f) const;
+    int64_t find_index(uint64_t frame) const;
+    void drop_oldest();
+    void invalidate_views();
+
+    std::vector<Region> m_regions;
+    std::deque<Frame> m_frames;
+    size_t m_budget;
+    size_t m_bytes;
+    int m_since_key;
+
+    std::vector<uint8_t> m_current;
+    std::vector<uint8_t> m_zero;
+
+    // UI state
+    int m_find_region = 0;
+    uint32_t m_find_offset = 0;
+    int m_find_width = 0;
+    int64_t m_find_result = -2;
+};
@@ -0,0 +1,210 @@
+#include "sim_rewind.h"
+#include "sim_state.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Delta encoding works on 32-bit words. Each run is a header of two 16-bit
+// counts, the number of unchanged words to skip followed by the number of
+// changed words, then the changed words XORed with the original.
+static const uint32_t MAX_RUN = 0xffff;
+
+SimRewind::SimRewind(SimState* state, size_t arena_size)
+    : m_state(state), m_head(0), m_latest_frame(0), m_has_latest(false)
+{
+    m_arena.resize(arena_size);
+    m_latest.resize(state->size());
+
+    // Worst case is alternating changed/unchanged words
+    m_encode.resize(state->size() * 2 + 8);
+}
+
+void SimRewind::clear()
+{
+    m_entries.clear();
+    m_head = 0;
+    m_has_latest = false;
+}
+
+int SimRewind::count() const
+{
+    return m_has_latest ? (int)m_entries.size() + 1 : 0;
+}
+
+size_t SimRewind::bytes_used() const
+{
+    size_t total = 0;
+    for (const Entry& e : m_entries)
+    {
+        total += e.size;
+    }
+    return total;
+}
+
+uint64_t SimRewind::oldest_frame() const
+{
+    if (!m_entries.empty()) return m_entries.front().frame;
+    return m_latest_frame;
+}
+
+size_t SimRewind::encode_delta(const uint8_t* a, const uint8_t* b)
+{
+    const size_t words = m_latest.size() / 4;
+    uint8_t* out = m_encode.data();
+
+    uint32_t wa, wb;
+
+    size_t i = 0;
+    while (i < words)
+    {
+        uint32_t skip = 0;
+        while (i < words && skip < MAX_RUN)
+        {
+            // Compare a block at a time when aligned, most of the state doesn't change
+            if ((i & 255) == 0 && i + 256 <= words && skip + 256 <= MAX_RUN && memcmp(a + i * 4, b + i * 4, 1024) == 0)
+            {
+                i += 256;
+                skip += 256;
+                continue;
+            }
+            memcpy(&wa, a + i * 4, 4);
+            memcpy(&wb, b + i * 4, 4);
+            if (wa != wb) break;
+            i++;
+            skip++;
+        }
+
+        uint8_t* header = out;
+        out += 4;
+
+        uint32_t changed = 0;
+        while (i < words && changed < MAX_RUN)
+        {
+            memcpy(&wa, a + i * 4, 4);
+            memcpy(&wb, b + i * 4, 4);
+            uint32_t x = wa ^ wb;
+            if (x == 0) break;
+            memcpy(out, &x, 4);
+            out += 4;
+            i++;
+            changed++;
+        }
+
+        uint16_t counts[2] = { (uint16_t)skip, (uint16_t)changed };
+        memcpy(header, counts, 4);
+    }
+
+    return out - m_encode.data();
+}
+
+void SimRewind::apply_delta(uint8_t* dest, const uint8_t* delta, size_t size)
+{
+    const uint8_t* end = delta + size;
+    uint8_t* d = dest;
+
+    while (delta < end)
+    {
+        uint16_t counts[2];
+        memcpy(counts, delta, 4);
+        delta += 4;
+
+        d += counts[0] * 4;
+        for (uint32_t i = 0; i < counts[1]; i++)
+        {
+            uint32_t x, w;
+            memcpy(&x, delta, 4);
+            memcpy(&w, d, 4);
+            w ^= x;
+            memcpy(d, &w, 4);
+            delta += 4;
+            d += 4;
+        }
+    }
+}
+
+void SimRewind::push_delta(size_t size, uint64_t frame)
+{
+    if (size > m_arena.size())
+    {
+        // Can't keep any history, the newest snapshot is still available
+        m_entries.clear();
+        return;
+    }
+
+    if (m_head + size > m_arena.size())
+    {
+        // Wrap. Entries past the old head are the oldest ones.
+        while (!m_entries.empty() && m_entries.front().offset >= m_head)
+        {
+            m_entries.pop_front();
+        }
+        m_head = 0;
+    }
+
+    while (!m_entries.empty())
+    {
+        const Entry& e = m_entries.front();
+        if (e.offset >= m_head + size || e.offset + e.size <= m_head) break;
+        m_entries.pop_front();
+    }
+
+    memcpy(&m_arena[m_head], m_encode.data(), size);
+    m_entries.push_back({ m_head, size, frame });
+    m_head += size;
+}
+
+bool SimRewind::due(uint64_t frame) const
+{
+    // Frames on a fixed schedule, so every run captures at the same points
+    if (interval <= 0 || frame % interval != 0) return false;
+    return !m_has_latest || frame > m_latest_frame;
+}
+
+void SimRewind::update(uint64_t frame)
+{
+    if (!due(frame)) return;
+
+    m_state->capture();
+    const uint8_t* current = m_state->data();
+
+    if (m_has_latest)
+    {
+        size_t size = encode_delta(m_latest.data(), current);
+        push_delta(size, m_latest_frame);
+    }
+
+    memcpy(m_latest.data(), current, m_latest.size());
+    m_latest_frame = frame;
+    m_has_latest = true;
+}
+
+int64_t SimRewind::rewind(uint64_t frame, int frames)
+{
+    if (frames <= 0 || (uint64_t)frames > frame)
+    {
+        printf("Can't rewind %d frames from frame %llu\n", frames, (unsigned long long)frame);
+        return -1;
+    }
+
+    if (!m_has_latest) return -1;
+
+    uint64_t target = frame - frames;
+    if (oldest_frame() > target) return -1;
+
+    // Walk back from the newest snapshot, undoing deltas as we go
+    while (m_latest_frame > target)
+    {
+        const Entry& e = m_entries.back();
+        apply_delta(m_latest.data(), &m_arena[e.offset], e.size);
+        m_latest_frame = e.frame;
+        m_head = e.offset;
+        m_entries.pop_back();
+    }
+
+    if (!m_state->restore(m_latest.data(), m_latest.size()))
+    {
+        return -1;
+    }
+
+    return m_latest_frame;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+class SimState;
+
+// Ring of savestates captured every N frames for rewinding.
+//
+// The newest snapshot is kept in full, older snapshots are stored as
+// run-length encoded XOR deltas against the snapshot that followed them,
+// so the oldest entries can be dropped without touching the others.
+// All storage is allocated up front.
+class SimRewind {
+public:
+    SimRewind(SimState* state, size_t arena_size);
+
+    // Call on each frame edge, captures on frames that are a multiple of
+    // interval
+    void update(uint64_t frame);
+
+    // True if update() would capture on this frame
+    bool due(uint64_t frame) const;
+
+    // Restore the newest snapshot that is at least `frames` older than
+    // `frame`. Later snapshots are discarded. Returns the frame number of
+    // the restored state, or -1 if there is nothing that old or `frames`
+    // is not between 1 and `frame`.
+    int64_t rewind(uint64_t frame, int frames);
+
+    void clear();
+
+    // Number of snapshots, including the newest full copy
+    int count() const;
+    size_t bytes_used() const;
+    size_t arena_size() const { return m_arena.size(); }
+    uint64_t oldest_frame() const;
+    uint64_t newest_frame() const { return m_latest_frame; }
+
+    // Frames between captures, 0 to disable. Each capture interrupts the
+    // CPU, so runs with and without rewind differ in timing.
+    int interval = 0;
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+        uint64_t frame;
+    };
+
+    size_t encode_delta(const uint8_t* a, const uint8_t* b);
+    void apply_delta(uint8_t* dest, const uint8_t* delta, size_t size);
+    void push_delta(size_t size, uint64_t frame);
+
+    SimState* m_state;
+
+    std::vector<uint8_t> m_arena;
+    size_t m_head;
+    std::deque<Entry> m_entries;
+
+    std::vector<uint8_t> m_latest;
+    uint64_t m_latest_frame;
+    bool m_has_latest;
+
+    std::vector<uint8_t> m_encode;
+};
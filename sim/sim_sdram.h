@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "file_search.h"
+#include "verilated_save.h"
 
 class SimSDRAM
 {
@@ -16,6 +17,9 @@ public:
         mask = sz - 1;
         data = new uint8_t [size];
         delay = 0;
+        generation = 0;
+        load_hash = 0xcbf29ce484222325ull;
+        rng = 0x2545f491;
     }
 
     ~SimSDRAM()
@@ -30,7 +34,7 @@ public:
 
         delay--;
         if (delay > 0) return;
-        delay = rand() % 9;
+        delay = next_delay();
 
         addr &= mask;
         addr &= 0xfffffffe;
@@ -76,7 +80,7 @@ public:
 
         delay--;
         if (delay > 0) return;
-        delay = rand() % 9;
+        delay = next_delay();
 
 
         addr &= mask;
@@ -124,6 +128,8 @@ public:
             data[addr & mask] = byte;
             addr += stride;
         }
+        generation++;
+        update_load_hash(buffer, offset, stride);
         
         printf("Loaded %zu bytes from %s at offset 0x%08X with stride %d\n", 
                buffer.size(), name, offset, stride);
@@ -153,6 +159,8 @@ public:
             data[(addr + 1) & mask] = buffer[i];
             addr += 2;
         }
+        generation++;
+        update_load_hash(buffer, offset, 0);
         
         printf("Loaded %zu bytes (16-bit BE) from %s at offset 0x%08X\n", 
                buffer.size(), name, offset);
@@ -160,6 +168,20 @@ public:
     }
 
 
+    // Checkpoint support. Only the access timing state is saved, the sim
+    // never writes through the channels so the contents are just the ROMs.
+    void save_checkpoint(VerilatedSerialize &os)
+    {
+        os.write(&delay, sizeof(delay));
+        os.write(&rng, sizeof(rng));
+    }
+
+    void restore_checkpoint(VerilatedDeserialize &is)
+    {
+        is.read(&delay, sizeof(delay));
+        is.read(&rng, sizeof(rng));
+    }
+
     bool save_data(const char *filename)
     {
         FILE *fp = fopen(filename, "wb");
@@ -182,6 +204,35 @@ public:
     uint32_t mask;
     uint8_t *data;
     int delay;
+
+    // Incremented whenever a ROM image is loaded, lets caches of decoded
+    // ROM contents know when they are stale
+    uint32_t generation;
+
+    // FNV-1a hash of every image loaded and where it went, identifies the
+    // ROM set for caches that persist across runs
+    uint64_t load_hash;
+
+    void update_load_hash(const std::vector<uint8_t> &buffer, int offset, int stride)
+    {
+        load_hash = (load_hash ^ (uint32_t)offset) * 0x100000001b3ull;
+        load_hash = (load_hash ^ (uint32_t)stride) * 0x100000001b3ull;
+        for (uint8_t byte : buffer)
+        {
+            load_hash = (load_hash ^ byte) * 0x100000001b3ull;
+        }
+    }
+
+    // Random access latency, from our own generator so it can be checkpointed
+    uint32_t rng;
+
+    int next_delay()
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng % 9;
+    }
 };
 
 extern SimSDRAM sdram;
@@ -0,0 +1,159 @@
+#include "sim_shm.h"
+#include "sim_video.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static size_t align_page(size_t size)
+{
+    return (size + 4095) & ~(size_t)4095;
+}
+
+SimShm::SimShm()
+    : m_header(nullptr), m_audio(nullptr), m_audio_pos(0), m_size(0), m_slot(0), m_video(nullptr)
+{
+    m_name[0] = '\0';
+}
+
+SimShm::~SimShm()
+{
+    close();
+}
+
+uint32_t* SimShm::slot_pixels(int slot) const
+{
+    return (uint32_t*)((uint8_t*)m_header + m_header->frame_offset + slot * m_header->frame_stride);
+}
+
+bool SimShm::open(const char* name, SimVideo* video, uint32_t audio_rate)
+{
+    close();
+
+    const size_t frame_bytes = align_page(video->width * video->height * sizeof(uint32_t));
+    const size_t frame_offset = align_page(sizeof(ShmHeader));
+    const size_t audio_offset = frame_offset + frame_bytes * SHM_FRAME_SLOTS;
+    const size_t size = audio_offset + align_page(SHM_AUDIO_SAMPLES * sizeof(int16_t));
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        printf("Failed to open shared memory %s\n", name);
+        return false;
+    }
+
+    if (ftruncate(fd, size) != 0)
+    {
+        printf("Failed to size shared memory %s\n", name);
+        ::close(fd);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED)
+    {
+        printf("Failed to map shared memory %s\n", name);
+        return false;
+    }
+
+    m_header = (ShmHeader*)mem;
+    m_size = size;
+    snprintf(m_name, sizeof(m_name), "%s", name);
+
+    // Keep counting sessions if a previous sim left the region behind
+    uint32_t session = memcmp(m_header->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) ? 0 : m_header->session + 1;
+
+    // Invalidate while the layout is filled in
+    memset(m_header->magic, 0, sizeof(m_header->magic));
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_header->version = SHM_VERSION;
+    m_header->header_size = sizeof(ShmHeader);
+    m_header->width = video->width;
+    m_header->height = video->height;
+    m_header->frame_slots = SHM_FRAME_SLOTS;
+    m_header->frame_offset = frame_offset;
+    m_header->frame_stride = frame_bytes;
+    m_header->audio_rate = audio_rate;
+    m_header->audio_samples = SHM_AUDIO_SAMPLES;
+    m_header->audio_offset = audio_offset;
+    m_header->seq.store(0);
+    m_header->latest_slot = 0;
+    m_header->latest_frame = 0;
+    m_header->audio_write_pos.store(0);
+    m_header->session = session;
+    for (int i = 0; i < SHM_FRAME_SLOTS; i++)
+    {
+        m_header->slots[i].seq.store(0);
+        m_header->slots[i].frame = 0;
+    }
+
+    m_audio = (int16_t*)((uint8_t*)mem + audio_offset);
+    m_audio_pos = 0;
+
+    // The video draws straight into the first slot
+    m_slot = 0;
+    m_header->slots[0].seq.store(1, std::memory_order_relaxed);
+    memcpy(slot_pixels(0), video->pixels, video->width * video->height * sizeof(uint32_t));
+    video->set_pixels(slot_pixels(0));
+    m_video = video;
+
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(m_header->magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+
+    printf("Publishing frames and audio to shared memory %s\n", name);
+    return true;
+}
+
+void SimShm::close()
+{
+    if (!m_header) return;
+
+    // Give the video its own buffer back before unmapping
+    const size_t pixel_bytes = m_video->width * m_video->height * sizeof(uint32_t);
+    uint32_t* pixels = new uint32_t[m_video->width * m_video->height];
+    memcpy(pixels, m_video->pixels, pixel_bytes);
+    m_video->set_pixels(pixels);
+    m_video->owns_pixels = true;
+
+    memset(m_header->magic, 0, sizeof(m_header->magic));
+    munmap(m_header, m_size);
+    shm_unlink(m_name);
+
+    m_header = nullptr;
+    m_audio = nullptr;
+    m_video = nullptr;
+}
+
+void SimShm::frame_complete(uint64_t frame)
+{
+    if (!m_header) return;
+
+    // Finish the current slot
+    ShmFrameSlot& cur = m_header->slots[m_slot];
+    cur.frame = frame;
+    cur.seq.fetch_add(1, std::memory_order_release);
+
+    // Point the header at it
+    m_header->seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->latest_slot = m_slot;
+    m_header->latest_frame = frame;
+    m_header->seq.fetch_add(1, std::memory_order_release);
+
+    m_header->audio_write_pos.store(m_audio_pos, std::memory_order_release);
+
+    // Start writing the next slot, seeded with this frame so partially
+    // drawn frames look the same as before
+    int next = (m_slot + 1) % SHM_FRAME_SLOTS;
+    ShmFrameSlot& slot = m_header->slots[next];
+    slot.seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(slot_pixels(next), slot_pixels(m_slot), m_video->width * m_video->height * sizeof(uint32_t));
+    m_video->set_pixels(slot_pixels(next));
+    m_slot = next;
+}
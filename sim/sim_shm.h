@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+// Layout of the shared memory region the sim publishes frames and audio
+// into, for external viewers (see f2view.cpp).
+//
+// Frames live in a ring of slots. The sim draws directly into the current
+// slot, each slot has its own sequence number which is odd while it is
+// being written. The header fields are covered by a seqlock, a reader
+// copies them and retries if the sequence changed or was odd.
+//
+// Audio is a ring of native rate samples with a monotonic write position,
+// each reader keeps its own read position.
+
+static const char SHM_MAGIC[8] = { 'F', '2', 'S', 'H', 'M', 0, 0, 0 };
+static const uint32_t SHM_VERSION = 1;
+static const char* const SHM_DEFAULT_NAME = "/f2sim";
+
+static const int SHM_FRAME_SLOTS = 4;
+static const uint32_t SHM_AUDIO_SAMPLES = 1 << 20;
+
+struct ShmFrameSlot {
+    std::atomic<uint32_t> seq;
+    uint32_t reserved;
+    uint64_t frame;
+};
+
+struct ShmHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_slots;
+    uint32_t frame_offset;      // offset of the first slot's pixels
+    uint32_t frame_stride;      // bytes between slots
+
+    uint32_t audio_rate;
+    uint32_t audio_samples;     // ring size, power of two
+    uint32_t audio_offset;
+
+    // Seqlock over latest_slot and latest_frame
+    std::atomic<uint32_t> seq;
+    uint32_t latest_slot;
+    uint64_t latest_frame;
+
+    // Written with release ordering after the samples
+    std::atomic<uint64_t> audio_write_pos;
+
+    // Incremented by the sim on startup so viewers can notice a restart
+    uint32_t session;
+    uint32_t reserved;
+
+    ShmFrameSlot slots[SHM_FRAME_SLOTS];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared atomics must be lock free");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+class SimVideo;
+
+// Publishing side, owned by the sim
+class SimShm {
+public:
+    SimShm();
+    ~SimShm();
+
+    // Create the region and point the video pixels at the first slot
+    bool open(const char* name, SimVideo* video, uint32_t audio_rate);
+    void close();
+
+    // Call when the video has completed a frame. Publishes it and moves
+    // the video on to the next slot.
+    void frame_complete(uint64_t frame);
+
+    void push_audio(int16_t sample)
+    {
+        if (!m_header) return;
+        uint64_t pos = m_audio_pos++;
+        m_audio[pos & (SHM_AUDIO_SAMPLES - 1)] = sample;
+
+        // Publishing every sample is expensive, batch them up
+        if ((m_audio_pos & 255) == 0) m_header->audio_write_pos.store(m_audio_pos, std::memory_order_release);
+    }
+
+    bool is_open() const { return m_header != nullptr; }
+
+private:
+    uint32_t* slot_pixels(int slot) const;
+
+    ShmHeader* m_header;
+    int16_t* m_audio;
+    uint64_t m_audio_pos;
+    size_t m_size;
+    char m_name[64];
+    int m_slot;
+    SimVideo* m_video;
+};
@@ -2,6 +2,8 @@
 #include "F2.h"
 #include "sim_ddr.h"
 #include "sim.h"
+#include "games.h"
+#include "miniz.h"
 
 #include <dirent.h>
 #include <algorithm>
@@ -9,12 +11,313 @@
 
 extern void sim_tick(int count);
 
+// Hash of the HDL sources and verilator options, set by the Makefile
+#if !defined(F2_BUILD_HASH)
+#define F2_BUILD_HASH 0
+#endif
+
+// .f2state container
+//
+//   F2StateHeader
+//   F2StateLayout[num_layout]  - savestate chunks, from the stream headers
+//   uint32_t[num_chunks]       - stored size of each compression chunk
+//   chunk data                 - deflated, or raw if stored size == chunk size
+static const char F2STATE_MAGIC[8] = { 'F', '2', 'S', 'T', 'A', 'T', 'E', 0 };
+static const uint32_t F2STATE_VERSION = 1;
+static const uint32_t F2STATE_CHUNK_SIZE = 16 * 1024;
+
+struct F2StateHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t build_hash;
+    char game_name[16];
+    uint8_t game;
+    uint8_t reserved[3];
+    uint32_t state_size;
+    uint32_t chunk_size;
+    uint32_t num_chunks;
+    uint32_t num_layout;
+    uint32_t crc;
+};
+
+struct F2StateLayout
+{
+    uint8_t index;
+    uint8_t width;
+    uint16_t reserved;
+    uint32_t count;
+};
+
+static_assert(sizeof(F2StateHeader) == 56, "F2StateHeader mismatch");
+static_assert(sizeof(F2StateLayout) == 8, "F2StateLayout mismatch");
+
+static bool layout_equal(const std::vector<SSChunk>& a, const std::vector<SSChunk>& b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].index != b[i].index || a[i].width != b[i].width || a[i].count != b[i].count) return false;
+    }
+    return true;
+}
+
 SimState::SimState(F2* top, SimDDR* memory, int offset, int size) 
     : m_top(top), m_memory(memory), m_offset(offset), m_size(size)
 {
 }
 
 bool SimState::save_state(const char* filename)
+{
+    capture();
+
+    return write_file(filename, data());
+}
+
+bool SimState::restore_state(const char* filename)
+{
+    std::vector<uint8_t> state;
+    if (!read_file(filename, state))
+    {
+        return false;
+    }
+
+    return restore(state.data(), state.size());
+}
+
+bool SimState::parse_layout(const uint8_t* data, int size, std::vector<SSChunk>& layout)
+{
+    layout.clear();
+
+    // 8 byte stream header, then 8 byte chunk headers each followed by
+    // their elements packed into 64-bit words
+    int offset = 8;
+    while (offset + 8 <= size)
+    {
+        uint64_t header;
+        memcpy(&header, data + offset, 8);
+        offset += 8;
+
+        if ((header >> 56) == 0xff)
+        {
+            return true;
+        }
+
+        SSChunk chunk;
+        chunk.index = header >> 56;
+        chunk.width = (header >> 32) & 0x3;
+        chunk.count = header & 0xffffffff;
+        layout.push_back(chunk);
+
+        uint64_t bytes = ((uint64_t)chunk.count << chunk.width);
+        offset += (bytes + 7) & ~7ull;
+    }
+
+    return false;
+}
+
+bool SimState::write_file(const char* filename, const uint8_t* data)
+{
+    F2StateHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, F2STATE_MAGIC, sizeof(header.magic));
+    header.version = F2STATE_VERSION;
+    header.build_hash = F2_BUILD_HASH;
+    strncpy(header.game_name, game_name((game_t)m_top->game), sizeof(header.game_name) - 1);
+    header.game = m_top->game;
+    header.state_size = m_size;
+    header.chunk_size = F2STATE_CHUNK_SIZE;
+    header.num_chunks = (m_size + F2STATE_CHUNK_SIZE - 1) / F2STATE_CHUNK_SIZE;
+    header.crc = mz_crc32(MZ_CRC32_INIT, data, m_size);
+
+    std::vector<SSChunk> layout;
+    if (!parse_layout(data, m_size, layout))
+    {
+        printf("State data has an invalid chunk layout\n");
+        return false;
+    }
+    header.num_layout = layout.size();
+
+    std::vector<uint32_t> chunk_sizes(header.num_chunks);
+    std::vector<uint8_t> packed;
+    std::vector<uint8_t> work(mz_compressBound(F2STATE_CHUNK_SIZE));
+
+    for (uint32_t i = 0; i < header.num_chunks; i++)
+    {
+        const uint8_t* src = data + i * F2STATE_CHUNK_SIZE;
+        uint32_t len = std::min<uint32_t>(F2STATE_CHUNK_SIZE, m_size - i * F2STATE_CHUNK_SIZE);
+
+        mz_ulong comp_len = work.size();
+        if (mz_compress2(work.data(), &comp_len, src, len, MZ_BEST_SPEED) == MZ_OK && comp_len < len)
+        {
+            packed.insert(packed.end(), work.begin(), work.begin() + comp_len);
+            chunk_sizes[i] = comp_len;
+        }
+        else
+        {
+            packed.insert(packed.end(), src, src + len);
+            chunk_sizes[i] = len;
+        }
+    }
+
+    FILE* fp = fopen(filename, "wb");
+    if (!fp)
+    {
+        printf("Failed to open file for saving state: %s\n", filename);
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for (const SSChunk& chunk : layout)
+    {
+        F2StateLayout entry = { chunk.index, chunk.width, 0, chunk.count };
+        ok = ok && fwrite(&entry, sizeof(entry), 1, fp) == 1;
+    }
+    ok = ok && fwrite(chunk_sizes.data(), sizeof(uint32_t), chunk_sizes.size(), fp) == chunk_sizes.size();
+    ok = ok && fwrite(packed.data(), 1, packed.size(), fp) == packed.size();
+    fclose(fp);
+
+    if (!ok)
+    {
+        printf("Failed to write state file: %s\n", filename);
+        return false;
+    }
+
+    printf("Saved state to %s (%zu bytes)\n", filename, sizeof(header) + layout.size() * sizeof(F2StateLayout) + chunk_sizes.size() * 4 + packed.size());
+    return true;
+}
+
+bool SimState::read_file(const char* filename, std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> file;
+    FILE* fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        printf("Failed to open state file: %s\n", filename);
+        return false;
+    }
+    uint8_t buf[16 * 1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+        file.insert(file.end(), buf, buf + n);
+    }
+    fclose(fp);
+
+    F2StateHeader header;
+    if (file.size() < sizeof(header) || memcmp(file.data(), F2STATE_MAGIC, sizeof(F2STATE_MAGIC)) != 0)
+    {
+        printf("%s is not a state file\n", filename);
+        return false;
+    }
+
+    memcpy(&header, file.data(), sizeof(header));
+    header.game_name[sizeof(header.game_name) - 1] = '\0';
+
+    if (header.version != F2STATE_VERSION)
+    {
+        printf("%s: unsupported version %u\n", filename, header.version);
+        return false;
+    }
+
+    if (header.game != m_top->game)
+    {
+        printf("%s: state is for %s, not %s\n", filename, header.game_name, game_name((game_t)m_top->game));
+        return false;
+    }
+
+    if (header.build_hash != F2_BUILD_HASH)
+    {
+        printf("%s: state is from a different build (%08X, expected %08X)\n", filename, header.build_hash, F2_BUILD_HASH);
+        return false;
+    }
+
+    if ((int)header.state_size != m_size || header.chunk_size == 0 ||
+        header.num_chunks != (header.state_size + header.chunk_size - 1) / header.chunk_size)
+    {
+        printf("%s: unexpected state size %u\n", filename, header.state_size);
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+    size_t tables = header.num_layout * sizeof(F2StateLayout) + header.num_chunks * sizeof(uint32_t);
+    if (offset + tables > file.size())
+    {
+        printf("%s: truncated\n", filename);
+        return false;
+    }
+
+    std::vector<SSChunk> layout(header.num_layout);
+    for (uint32_t i = 0; i < header.num_layout; i++)
+    {
+        F2StateLayout entry;
+        memcpy(&entry, &file[offset], sizeof(entry));
+        offset += sizeof(entry);
+        layout[i] = { entry.index, entry.width, entry.count };
+    }
+
+    // Only known once this model has captured a state, a rewind or save
+    // records it. Capturing here would run the model before the file is
+    // accepted, so without one rely on the build hash alone.
+    if (m_layout.empty())
+    {
+        printf("%s: no state captured yet, skipping the layout check\n", filename);
+    }
+    else if (!layout_equal(layout, m_layout))
+    {
+        printf("%s: savestate layout does not match this model\n", filename);
+        return false;
+    }
+
+    std::vector<uint32_t> chunk_sizes(header.num_chunks);
+    memcpy(chunk_sizes.data(), &file[offset], header.num_chunks * sizeof(uint32_t));
+    offset += header.num_chunks * sizeof(uint32_t);
+
+    data.resize(header.state_size);
+    for (uint32_t i = 0; i < header.num_chunks; i++)
+    {
+        uint32_t len = std::min(header.chunk_size, header.state_size - i * header.chunk_size);
+        uint8_t* dest = data.data() + i * header.chunk_size;
+
+        if (offset + chunk_sizes[i] > file.size())
+        {
+            printf("%s: truncated\n", filename);
+            return false;
+        }
+
+        if (chunk_sizes[i] == len)
+        {
+            memcpy(dest, &file[offset], len);
+        }
+        else
+        {
+            mz_ulong dest_len = len;
+            if (mz_uncompress(dest, &dest_len, &file[offset], chunk_sizes[i]) != MZ_OK || dest_len != len)
+            {
+                printf("%s: corrupt chunk %u\n", filename, i);
+                return false;
+            }
+        }
+        offset += chunk_sizes[i];
+    }
+
+    if (mz_crc32(MZ_CRC32_INIT, data.data(), data.size()) != header.crc)
+    {
+        printf("%s: checksum mismatch\n", filename);
+        return false;
+    }
+
+    std::vector<SSChunk> data_layout;
+    if (!parse_layout(data.data(), data.size(), data_layout) || !layout_equal(layout, data_layout))
+    {
+        printf("%s: state data does not match its layout\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
+void SimState::capture()
 {
     m_top->ss_index = 0;
     m_top->ss_do_save = 1;
@@ -23,15 +326,31 @@ bool SimState::save_state(const char* filename)
     m_top->ss_do_save = 0;
     sim_tick_until([&]{ return m_top->ss_state_out == 0; });
 
-    m_memory->save_data(filename, m_offset, m_size);
+    parse_layout(data(), m_size, m_layout);
+}
+
+bool SimState::restore(const uint8_t* data, int size)
+{
+    if (size != m_size)
+    {
+        printf("State size mismatch, expected %d got %d\n", m_size, size);
+        return false;
+    }
+
+    memcpy(&m_memory->memory[m_offset], data, size);
+
+    do_restore();
 
     return true;
 }
 
-bool SimState::restore_state(const char* filename)
+const uint8_t* SimState::data() const
 {
-    m_memory->load_data(filename, m_offset, 1); // Pass stride=1 explicitly
+    return &m_memory->memory[m_offset];
+}
 
+void SimState::do_restore()
+{
     m_top->ss_index = 0;
     m_top->ss_do_restore = 1;
     sim_tick_until([&]{ return m_top->ss_state_out != 0; });
@@ -39,7 +358,7 @@ bool SimState::restore_state(const char* filename)
     m_top->ss_do_restore = 0;
     sim_tick_until([&]{ return m_top->ss_state_out == 0; });
 
-    return true;
+    sim_state_restored();
 }
 
 std::vector<std::string> SimState::get_f2state_files()
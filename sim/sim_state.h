@@ -2,11 +2,19 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 // Forward declarations
 class F2;
 class SimDDR;
 
+// One chunk of the savestate stream, as written by memory_stream.sv
+struct SSChunk {
+    uint8_t index;  // SSIDX_*
+    uint8_t width;  // log2 of the element size in bytes
+    uint32_t count; // number of elements
+};
+
 class SimState {
 public:
     SimState(F2* top, SimDDR* memory, int offset, int size);
@@ -16,6 +24,26 @@ public:
     
     // Restore state from the specified file
     bool restore_state(const char* filename);
+
+    // Run the savestate machine, leaving the state in memory at data()
+    void capture();
+
+    // Copy a previously captured state into memory and restore it
+    bool restore(const uint8_t* data, int size);
+
+    // Captured state, valid after capture()
+    const uint8_t* data() const;
+    int size() const { return m_size; }
+
+    // Write/read state data using the .f2state container format. Reading
+    // validates the game, build and chunk layout against the running model
+    // and fails without touching it on any mismatch. The layout is only
+    // checked once this model has captured a state.
+    bool write_file(const char* filename, const uint8_t* data);
+    bool read_file(const char* filename, std::vector<uint8_t>& data);
+
+    // Walk the chunk headers of a captured state
+    static bool parse_layout(const uint8_t* data, int size, std::vector<SSChunk>& layout);
     
     // Get list of all available state files in current directory
     std::vector<std::string> get_f2state_files();
@@ -24,8 +52,13 @@ public:
     void tick(int count);
 
 private:
+    void do_restore();
+
     F2* m_top;
     SimDDR* m_memory;
     int m_offset;
     int m_size;
+
+    // Layout of the last state captured by this model, empty until then
+    std::vector<SSChunk> m_layout;
 };
@@ -3,6 +3,10 @@
 
 #include <stdint.h>
 #include <SDL.h>
+#include <functional>
+#include <vector>
+#include <string.h>
+#include "verilated_save.h"
 
 #include "imgui_wrap.h"
 
@@ -20,65 +24,109 @@ public:
         width = w;
         height = h;
         pixels = new uint32_t[width * height];
-        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+        owns_pixels = true;
+        line.assign(width, 0);
+        invalidate();
+        texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STREAMING, width, height) : nullptr;
         x = 0;
         y = 0;
         rotated = true;
         in_vsync = false;
         in_hsync = false;
         in_ce = false;
+        frame_count = 0;
     }
 
     void deinit()
     {
-        if (pixels) delete [] pixels;
+        if (pixels && owns_pixels) delete [] pixels;
         if (texture) SDL_DestroyTexture(texture);
 
         pixels = nullptr;
         texture = nullptr;
     }
 
+    // Draw into external memory instead, contents are not copied
+    void set_pixels(uint32_t *p)
+    {
+        if (pixels && owns_pixels) delete [] pixels;
+        pixels = p;
+        owns_pixels = false;
+    }
+
+    // Called every sim tick, only the rising edge of ce does any work
     void clock(bool ce, bool hsync, bool vsync, uint8_t r, uint8_t g, uint8_t b)
     {
-        if (!ce)
+        if (ce == in_ce) return;
+        in_ce = ce;
+        if (!ce) return;
+
+        if (!hsync && !vsync)
         {
-            in_ce = false;
+            if (x < width) line[x] = r << 24 | g << 16 | b << 8;
+            x++;
+            in_hsync = false;
+            in_vsync = false;
             return;
         }
 
-        if (in_ce) return;
+        pixel_blank(hsync, vsync);
+    }
 
-        if (hsync)
-        {
-            x = 0;
-            if (!in_hsync) y++;
-        }
+    // Register a callback for the start of vsync, when pixels holds a
+    // complete frame
+    void on_frame_complete(std::function<void()> fn)
+    {
+        frame_listeners.push_back(fn);
+    }
 
-        if (vsync)
-        {
-            if (!in_vsync) x = 0;
-            y = 0;
-        }
+    // Mark every line for upload, after pixels were changed externally
+    void invalidate()
+    {
+        dirty_first = 0;
+        dirty_last = height - 1;
+    }
 
-        in_hsync = hsync;
-        in_vsync = vsync;
-        in_ce = ce;
+    void save_checkpoint(VerilatedSerialize &os)
+    {
+        os.write(&x, sizeof(x));
+        os.write(&y, sizeof(y));
+        os.write(&in_hsync, sizeof(in_hsync));
+        os.write(&in_vsync, sizeof(in_vsync));
+        os.write(&in_ce, sizeof(in_ce));
+        os.write(line.data(), width * sizeof(uint32_t));
+        os.write(pixels, width * height * sizeof(uint32_t));
+    }
 
-        if (!hsync && !vsync)
-        {
-            uint32_t c = r << 24 | g << 16 | b << 8;
-            if (x < width && y < height)
-                pixels[(y * width) + x] = c;
-            x++;
-        }
+    void restore_checkpoint(VerilatedDeserialize &is)
+    {
+        is.read(&x, sizeof(x));
+        is.read(&y, sizeof(y));
+        is.read(&in_hsync, sizeof(in_hsync));
+        is.read(&in_vsync, sizeof(in_vsync));
+        is.read(&in_ce, sizeof(in_ce));
+        is.read(line.data(), width * sizeof(uint32_t));
+        is.read(pixels, width * height * sizeof(uint32_t));
+        invalidate();
     }
 
+    // Upload the lines committed since the last call, plus a marker on the
+    // line currently being drawn
     void update_texture()
     {
+        if (!texture) return;
+
+        int marker = (!in_vsync && y < height) ? y : -1;
+        if (marker >= 0) mark_dirty(marker);
+        if (marker_line >= 0) mark_dirty(marker_line);
+        marker_line = marker;
+
+        if (dirty_first > dirty_last) return;
+
         SDL_Rect region;
 
-        int line_count = height;
-        int line_start = 0;
+        int line_start = dirty_first;
+        int line_count = dirty_last - dirty_first + 1;
         region.x = 0;
         region.y = line_start;
         region.w = width;
@@ -93,22 +141,26 @@ public:
         {
             uint8_t *dest = ((uint8_t *)work) + (pitch * line);
             uint32_t *src = pixels + ((line + line_start) * width);
-            if (!in_vsync && ((line + line_start) == y))
+            if ((line + line_start) == marker)
             {
-                memset(dest, 0x2f, pitch);
+                memset(dest, 0x2f, width * sizeof(uint32_t));
             }
             else
             {
-                memcpy(dest, src, pitch);
+                memcpy(dest, src, width * sizeof(uint32_t));
             }
         }
 
         SDL_UnlockTexture(texture);
+
+        dirty_first = height;
+        dirty_last = -1;
     }
 
     void draw()
     {
         ImGui::Begin("Video", nullptr, ImGuiWindowFlags_NoScrollbar);
+        hover_x = hover_y = -1;
 
         ImGui::Checkbox("TATE", &rotated);
         ImGui::SameLine();
@@ -148,6 +200,16 @@ public:
                                                bb.GetTL(), bb.GetTR(), bb.GetBR(), bb.GetBL(),
                                                uv0, uv1, uv2, uv3,
                                                ImGui::GetColorU32(ImVec4(1,1,1,1)));
+
+                // Pixel under the mouse, in texture coordinates
+                if (ImGui::IsWindowHovered() && ImGui::IsMouseHoveringRect(bb.Min, bb.Max))
+                {
+                    ImVec2 mouse = ImGui::GetMousePos();
+                    float fx = (mouse.x - bb.Min.x) / bb.GetWidth();
+                    float fy = (mouse.y - bb.Min.y) / bb.GetHeight();
+                    hover_x = (int)((rotated ? 1.0f - fy : fx) * width);
+                    hover_y = (int)((rotated ? fx : fy) * height);
+                }
             }
         }
         ImGui::End();
@@ -155,12 +217,70 @@ public:
 
     int width, height;
     uint32_t *pixels = nullptr;
+    bool owns_pixels = true;
 
     bool rotated;
 
+    uint64_t frame_count = 0;
+
     int x, y;
+    int hover_x = -1, hover_y = -1;
     bool in_hsync, in_vsync, in_ce;
     SDL_Texture *texture = nullptr;
+
+private:
+    // Blanking edges, kept out of the per-pixel path
+    void pixel_blank(bool hsync, bool vsync)
+    {
+        if (hsync)
+        {
+            if (!in_hsync)
+            {
+                commit_line();
+                y++;
+            }
+            x = 0;
+        }
+
+        if (vsync)
+        {
+            if (!in_vsync)
+            {
+                // A line cut short by vsync still gets drawn
+                if (x > 0) commit_line();
+                x = 0;
+                frame_count++;
+                for (auto &fn : frame_listeners) fn();
+            }
+            y = 0;
+        }
+
+        in_hsync = hsync;
+        in_vsync = vsync;
+    }
+
+    void commit_line()
+    {
+        if (y >= height || x == 0) return;
+
+        int count = x < width ? x : width;
+        memcpy(pixels + (y * width), line.data(), count * sizeof(uint32_t));
+        mark_dirty(y);
+    }
+
+    void mark_dirty(int l)
+    {
+        if (l < dirty_first) dirty_first = l;
+        if (l > dirty_last) dirty_last = l;
+    }
+
+    // Pixels of the line being drawn, copied to pixels on hblank
+    std::vector<uint32_t> line;
+
+    int dirty_first = 0, dirty_last = -1;
+    int marker_line = -1;
+
+    std::vector<std::function<void()>> frame_listeners;
 };
 
 #endif
@@ -0,0 +1,249 @@
+#include "sim_video_timing.h"
+#include "sim.h"
+#include "imgui_wrap.h"
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+
+static const size_t MAX_WARNINGS = 64;
+
+SimVideoTiming::SimVideoTiming()
+{
+    m_last_tick = 0;
+    memset(&m_timing, 0, sizeof(m_timing));
+    m_valid = false;
+    m_frames = 0;
+    m_max_jitter = 0;
+    m_jitter_frames = 0;
+    m_uneven_frames = 0;
+    m_expected_width = 0;
+    m_expected_height = 0;
+    m_game = -1;
+    m_sync_fix = false;
+    m_config_frames = 0;
+    reset();
+}
+
+void SimVideoTiming::set_expected(int width, int height)
+{
+    m_expected_width = width;
+    m_expected_height = height;
+}
+
+void SimVideoTiming::set_config(int game, bool sync_fix)
+{
+    if (game == m_game && sync_fix == m_sync_fix) return;
+
+    // The first change is just the initial config
+    if (m_game >= 0) m_config_frames = 2;
+    m_game = game;
+    m_sync_fix = sync_fix;
+}
+
+void SimVideoTiming::reset()
+{
+    // Treat every signal as already high so only real rising edges count
+    m_in_ce = true;
+    m_in_hblank = m_in_vblank = m_in_hsync = m_in_vsync = true;
+
+    m_px = 0;
+    m_px_hblank = -1;
+    m_hactive_count = 0;
+    m_hsync_count = 0;
+    m_line_active = false;
+
+    m_line = 0;
+    m_line_vblank = -1;
+    m_vactive = 0;
+    m_vsync_lines = 0;
+    m_uneven = false;
+    m_started = false;
+    m_frame_tick = 0;
+    memset(&m_current, 0, sizeof(m_current));
+}
+
+double SimVideoTiming::frame_rate() const
+{
+    if (!m_valid || m_timing.ticks == 0) return 0.0;
+    return (double)F2_CLOCK_HZ / m_timing.ticks;
+}
+
+void SimVideoTiming::warn(const char* fmt, ...)
+{
+    char msg[256];
+    int len = snprintf(msg, sizeof(msg), "Frame %llu: ", (unsigned long long)m_frames);
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(msg + len, sizeof(msg) - len, fmt, args);
+    va_end(args);
+
+    printf("Video timing: %s\n", msg);
+    m_warnings.push_back(msg);
+    if (m_warnings.size() > MAX_WARNINGS) m_warnings.pop_front();
+}
+
+void SimVideoTiming::pixel(uint64_t tick, bool hblank, bool vblank, bool hsync, bool vsync)
+{
+    // Lines start at hsync, frames at vsync
+    if (hsync && !m_in_hsync) end_line();
+    if (vsync && !m_in_vsync) end_frame(tick);
+
+    if (hblank && !m_in_hblank) m_px_hblank = m_px;
+    if (vblank && !m_in_vblank) m_line_vblank = m_line;
+
+    m_in_hblank = hblank;
+    m_in_vblank = vblank;
+    m_in_hsync = hsync;
+    m_in_vsync = vsync;
+
+    if (hsync) m_hsync_count++;
+    if (!hblank)
+    {
+        m_hactive_count++;
+        if (!vblank) m_line_active = true;
+    }
+    m_px++;
+}
+
+void SimVideoTiming::end_line()
+{
+    if (m_current.htotal == 0)
+        m_current.htotal = m_px;
+    else if (m_px != m_current.htotal)
+        m_uneven = true;
+
+    // Horizontal values are taken from lines in the active area
+    if (m_line_active)
+    {
+        m_current.hactive = m_hactive_count;
+        m_current.hsync_width = m_hsync_count;
+        m_current.hsync_start = m_px_hblank >= 0 ? m_px - m_px_hblank : 0;
+        m_vactive++;
+    }
+
+    if (m_in_vsync) m_vsync_lines++;
+
+    m_line++;
+    m_px = 0;
+    m_px_hblank = -1;
+    m_hactive_count = 0;
+    m_hsync_count = 0;
+    m_line_active = false;
+}
+
+void SimVideoTiming::end_frame(uint64_t tick)
+{
+    m_frames++;
+
+    if (m_started)
+    {
+        m_current.vtotal = m_line;
+        m_current.vactive = m_vactive;
+        m_current.vsync_width = m_vsync_lines;
+        m_current.vsync_start = m_line_vblank >= 0 ? m_line - m_line_vblank : 0;
+        m_current.ticks = tick - m_frame_tick;
+
+        const VideoTiming& t = m_current;
+        if (m_valid && !t.same_geometry(m_timing))
+        {
+            const VideoTiming& o = m_timing;
+            warn("geometry changed%s, %dx%d (%dx%d total) -> %dx%d (%dx%d total), game %d sync_fix %d",
+                 m_config_frames > 0 ? " after config change" : "",
+                 o.hactive, o.vactive, o.htotal, o.vtotal,
+                 t.hactive, t.vactive, t.htotal, t.vtotal, m_game, m_sync_fix ? 1 : 0);
+        }
+
+        if ((!m_valid || !t.same_geometry(m_timing)) && m_expected_width > 0 &&
+            (t.hactive != m_expected_width || t.vactive != m_expected_height))
+        {
+            warn("active area %dx%d does not match the %dx%d video buffer",
+                 t.hactive, t.vactive, m_expected_width, m_expected_height);
+        }
+
+        if (m_valid && t.ticks != m_timing.ticks)
+        {
+            uint64_t jitter = t.ticks > m_timing.ticks ? t.ticks - m_timing.ticks : m_timing.ticks - t.ticks;
+            m_jitter_frames++;
+            if (jitter > m_max_jitter)
+            {
+                m_max_jitter = jitter;
+                warn("frame length changed by %llu ticks (%llu -> %llu)", (unsigned long long)jitter,
+                     (unsigned long long)m_timing.ticks, (unsigned long long)t.ticks);
+            }
+        }
+
+        if (m_uneven) m_uneven_frames++;
+
+        m_timing = m_current;
+        m_valid = true;
+        if (m_config_frames > 0) m_config_frames--;
+    }
+
+    m_started = true;
+    m_frame_tick = tick;
+    m_line = 0;
+    m_line_vblank = -1;
+    m_vactive = 0;
+    m_vsync_lines = 0;
+    m_uneven = false;
+    memset(&m_current, 0, sizeof(m_current));
+}
+
+void SimVideoTiming::draw()
+{
+    if (ImGui::Begin("Video Timing"))
+    {
+        if (!m_valid)
+        {
+            ImGui::Text("No complete frame yet");
+        }
+        else
+        {
+            const VideoTiming& t = m_timing;
+            if (ImGui::BeginTable("timing", 3, ImGuiTableFlags_Borders))
+            {
+                ImGui::TableSetupColumn("");
+                ImGui::TableSetupColumn("H (pixels)");
+                ImGui::TableSetupColumn("V (lines)");
+                ImGui::TableHeadersRow();
+
+                ImGui::TableNextColumn(); ImGui::Text("Total");
+                ImGui::TableNextColumn(); ImGui::Text("%d", t.htotal);
+                ImGui::TableNextColumn(); ImGui::Text("%d", t.vtotal);
+                ImGui::TableNextColumn(); ImGui::Text("Active");
+                ImGui::TableNextColumn(); ImGui::Text("%d", t.hactive);
+                ImGui::TableNextColumn(); ImGui::Text("%d", t.vactive);
+                ImGui::TableNextColumn(); ImGui::Text("Front porch");
+                ImGui::TableNextColumn(); ImGui::Text("%d", t.hsync_start);
+                ImGui::TableNextColumn(); ImGui::Text("%d", t.vsync_start);
+                ImGui::TableNextColumn(); ImGui::Text("Sync width");
+                ImGui::TableNextColumn(); ImGui::Text("%d", t.hsync_width);
+                ImGui::TableNextColumn(); ImGui::Text("%d", t.vsync_width);
+                ImGui::EndTable();
+            }
+
+            ImGui::Text("Ticks per frame: %llu", (unsigned long long)t.ticks);
+            ImGui::Text("Frame rate: %.4f Hz", frame_rate());
+            if (t.htotal > 0 && t.vtotal > 0)
+                ImGui::Text("Ticks per pixel: %.3f", (double)t.ticks / ((uint64_t)t.htotal * t.vtotal));
+        }
+
+        ImGui::Text("Frames: %llu", (unsigned long long)m_frames);
+        ImGui::Text("Jitter: %llu frames, max %llu ticks", (unsigned long long)m_jitter_frames, (unsigned long long)m_max_jitter);
+        ImGui::Text("Uneven lines: %llu frames", (unsigned long long)m_uneven_frames);
+
+        ImGui::Separator();
+        ImGui::Text("Warnings");
+        ImGui::SameLine();
+        if (ImGui::Button("Clear")) m_warnings.clear();
+        ImGui::BeginChild("warnings");
+        for( auto it = m_warnings.rbegin(); it != m_warnings.rend(); ++it )
+        {
+            ImGui::TextUnformatted(it->c_str());
+        }
+        ImGui::EndChild();
+    }
+    ImGui::End();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// One frame's worth of video timing, horizontal values are in pixels
+// (ce_pixel enables) and vertical values in lines.
+struct VideoTiming {
+    int htotal;
+    int hactive;
+    int hsync_width;
+    int hsync_start;        // pixels from the end of active video
+    int vtotal;
+    int vactive;
+    int vsync_width;
+    int vsync_start;        // lines from the end of active video
+    uint64_t ticks;         // clk_sys ticks from vsync to vsync
+
+    bool same_geometry(const VideoTiming& o) const
+    {
+        return htotal == o.htotal && hactive == o.hactive && hsync_width == o.hsync_width &&
+               hsync_start == o.hsync_start && vtotal == o.vtotal && vactive == o.vactive &&
+               vsync_width == o.vsync_width && vsync_start == o.vsync_start;
+    }
+};
+
+// Measures the video timing generated by the core.
+//
+// Fed the raw ce_pixel, blank and sync outputs every tick, it measures
+// each frame between vsync rising edges and keeps the last complete
+// frame. Changes in geometry, and frames whose tick count or line
+// lengths differ from the previous frame, are logged as warnings along
+// with the game and sync_fix settings at the time.
+class SimVideoTiming {
+public:
+    SimVideoTiming();
+
+    // Size SimVideo was set up for, a mismatch with the measured active
+    // area is warned about
+    void set_expected(int width, int height);
+
+    // Current configuration, for attributing geometry changes
+    void set_config(int game, bool sync_fix);
+
+    void clock(uint64_t tick, bool ce, bool hblank, bool vblank, bool hsync, bool vsync)
+    {
+        bool resync = tick != m_last_tick + 1;
+        m_last_tick = tick;
+        if (resync) reset();
+
+        if (ce == m_in_ce) return;
+        m_in_ce = ce;
+        if (!ce) return;
+
+        pixel(tick, hblank, vblank, hsync, vsync);
+    }
+
+    // Forget the partial frame, the next measurement starts at vsync
+    void reset();
+
+    // True once a complete frame has been measured
+    bool valid() const { return m_valid; }
+    const VideoTiming& timing() const { return m_timing; }
+
+    // Frames completed since construction, counted on vsync rising edges
+    uint64_t frames() const { return m_frames; }
+
+    // Frames per second for the measured tick count
+    double frame_rate() const;
+
+    // Largest difference in ticks from one frame to the next
+    uint64_t max_jitter() const { return m_max_jitter; }
+    uint64_t jitter_frames() const { return m_jitter_frames; }
+
+    // Frames where not every line had the same length
+    uint64_t uneven_frames() const { return m_uneven_frames; }
+
+    const std::deque<std::string>& warnings() const { return m_warnings; }
+
+    void draw();
+
+private:
+    void pixel(uint64_t tick, bool hblank, bool vblank, bool hsync, bool vsync);
+    void end_line();
+    void end_frame(uint64_t tick);
+    void warn(const char* fmt, ...);
+
+    uint64_t m_last_tick;
+    bool m_in_ce;
+    bool m_in_hblank, m_in_vblank, m_in_hsync, m_in_vsync;
+
+    // Current line, in pixels
+    int m_px;
+    int m_px_hblank;        // position hblank started, -1 if not yet
+    int m_hactive_count;
+    int m_hsync_count;
+    bool m_line_active;
+
+    // Current frame, in lines
+    int m_line;
+    int m_line_vblank;      // line vblank started, -1 if not yet
+    int m_vactive;
+    int m_vsync_lines;
+    bool m_uneven;
+    bool m_started;         // seen a vsync since reset
+    uint64_t m_frame_tick;
+
+    VideoTiming m_current;  // horizontal values measured this frame
+    VideoTiming m_timing;
+    bool m_valid;
+
+    uint64_t m_frames;
+    uint64_t m_max_jitter;
+    uint64_t m_jitter_frames;
+    uint64_t m_uneven_frames;
+
+    int m_expected_width, m_expected_height;
+    int m_game;
+    bool m_sync_fix;
+    int m_config_frames;    // frames left to attribute changes to a config change
+
+    std::deque<std::string> m_warnings;
+};
@@ -0,0 +1,200 @@
+#include "tc0100scn.h"
+#include "games.h"
+#include "sim_sdram.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include <vector>
+#include <string.h>
+
+extern F2* top;
+extern SimSDRAM sdram;
+
+// RAM layout, in words
+static const uint32_t BG0_MAP = 0x0000;
+static const uint32_t FG0_MAP = 0x2000;
+static const uint32_t FG0_GFX = 0x3000;
+static const uint32_t BG1_MAP = 0x4000;
+static const uint32_t BG0_ROWSCROLL = 0x6000;
+static const uint32_t BG1_ROWSCROLL = 0x6200;
+static const uint32_t BG1_COLSCROLL = 0x7000;
+
+// Decoded BG tiles, one byte per pixel. ROM contents do not change once
+// loaded so tiles are decoded the first time they are used.
+static const int BG_TILE_COUNT = 0x10000;
+static std::vector<uint8_t> s_bg_tiles;
+static std::vector<uint8_t> s_bg_valid;
+static const uint8_t *s_bg_rom = nullptr;
+
+// Position of each pixel's nibble in the 32-bit ROM word, left to right.
+// The shifter is loaded with {d[15:8], d[7:0], d[31:24], d[23:16]} and
+// outputs from the top nibble down.
+static const int BG_NIBBLE_SHIFT[8] = { 12, 8, 4, 0, 28, 24, 20, 16 };
+
+static const uint8_t *bg_tile(const SCNState &state, uint16_t code)
+{
+    if (s_bg_rom != state.rom || s_bg_tiles.empty())
+    {
+        s_bg_tiles.assign(BG_TILE_COUNT * 64, 0);
+        s_bg_valid.assign(BG_TILE_COUNT, 0);
+        s_bg_rom = state.rom;
+    }
+
+    uint8_t *pixels = &s_bg_tiles[code * 64];
+    if (s_bg_valid[code]) return pixels;
+
+    for( int row = 0; row < 8; row++ )
+    {
+        size_t ofs = (code * 32) + (row * 4);
+        if (ofs + 4 > state.rom_size) break;
+        const uint8_t *src = state.rom + ofs;
+        uint32_t d = (src[3] << 24) | (src[2] << 16) | (src[1] << 8) | src[0];
+        for( int x = 0; x < 8; x++ )
+        {
+            pixels[(row * 8) + x] = (d >> BG_NIBBLE_SHIFT[x]) & 0xf;
+        }
+    }
+
+    s_bg_valid[code] = 1;
+    return pixels;
+}
+
+// FG0 graphics are 2bpp in RAM, pixel i is {gfx[8+i], gfx[i]} and the
+// shifter outputs from pixel 7 down
+static inline uint8_t fg0_pixel(uint16_t gfx, int x)
+{
+    return (((gfx >> (15 - x)) & 1) << 1) | ((gfx >> (7 - x)) & 1);
+}
+
+static inline uint16_t bg_dot(const SCNState &state, uint32_t map, int x, int y)
+{
+    uint32_t tile = (((y >> 3) & 63) * 64) + ((x >> 3) & 63);
+    uint16_t attrib = state.ram[map + (tile * 2)];
+    uint16_t code = state.ram[map + (tile * 2) + 1];
+
+    int row = (attrib & 0x8000) ? 7 - (y & 7) : (y & 7);
+    int col = (attrib & 0x4000) ? 7 - (x & 7) : (x & 7);
+    return ((attrib & 0xff) << 4) | bg_tile(state, code)[(row * 8) + col];
+}
+
+static inline uint16_t fg0_dot(const SCNState &state, int x, int y)
+{
+    uint16_t code = state.ram[FG0_MAP + (((y >> 3) & 63) * 64) + ((x >> 3) & 63)];
+
+    int row = (code & 0x8000) ? 7 - (y & 7) : (y & 7);
+    int col = (code & 0x4000) ? 7 - (x & 7) : (x & 7);
+    uint16_t gfx = state.ram[FG0_GFX + ((code & 0xff) * 8) + row];
+    return (((code >> 8) & 0x3f) << 4) | fg0_pixel(gfx, col);
+}
+
+void scn_state_from_rtl(SCNState *state)
+{
+    auto root = top->rootp;
+
+    for( int i = 0; i < 0x8000; i++ )
+    {
+        state->ram[i] = (root->F2__DOT__scn_ram_0__DOT__ram_h.m_storage[i] << 8) | root->F2__DOT__scn_ram_0__DOT__ram_l.m_storage[i];
+    }
+
+    for( int i = 0; i < 8; i++ )
+    {
+        state->ctrl[i] = root->F2__DOT__scn_main__DOT__ctrl[i];
+    }
+
+    state->rom = sdram.data + SCN0_ROM_SDR_BASE;
+    state->rom_size = sdram.size - SCN0_ROM_SDR_BASE;
+}
+
+bool scn_layer_enabled(const SCNState &state, int layer)
+{
+    return (state.ctrl[6] & (1 << layer)) == 0;
+}
+
+void scn_render_plane(const SCNState &state, int layer, uint16_t *plane)
+{
+    for( int ty = 0; ty < 64; ty++ )
+    {
+        for( int tx = 0; tx < 64; tx++ )
+        {
+            uint16_t *dest = plane + (ty * 8 * SCN_PLANE_SIZE) + (tx * 8);
+
+            if (layer == SCN_FG0)
+            {
+                uint16_t code = state.ram[FG0_MAP + (ty * 64) + tx];
+                uint16_t palette = ((code >> 8) & 0x3f) << 4;
+                for( int y = 0; y < 8; y++ )
+                {
+                    int row = (code & 0x8000) ? 7 - y : y;
+                    uint16_t gfx = state.ram[FG0_GFX + ((code & 0xff) * 8) + row];
+                    for( int x = 0; x < 8; x++ )
+                    {
+                        int col = (code & 0x4000) ? 7 - x : x;
+                        dest[(y * SCN_PLANE_SIZE) + x] = palette | fg0_pixel(gfx, col);
+                    }
+                }
+            }
+            else
+            {
+                uint32_t map = layer == SCN_BG0 ? BG0_MAP : BG1_MAP;
+                uint32_t tile = (ty * 64) + tx;
+                uint16_t attrib = state.ram[map + (tile * 2)];
+                uint16_t code = state.ram[map + (tile * 2) + 1];
+                uint16_t palette = (attrib & 0xff) << 4;
+                const uint8_t *pixels = bg_tile(state, code);
+                for( int y = 0; y < 8; y++ )
+                {
+                    const uint8_t *src = pixels + (((attrib & 0x8000) ? 7 - y : y) * 8);
+                    for( int x = 0; x < 8; x++ )
+                    {
+                        dest[(y * SCN_PLANE_SIZE) + x] = palette | src[(attrib & 0x4000) ? 7 - x : x];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void scn_render_line(const SCNState &state, int layer, int line, int h_adjust, uint16_t *dots)
+{
+    bool flip = state.ctrl[7] & 1;
+    int vcnt_actual = line + SCN_V_START;
+    int vcnt = (flip ? 255 - vcnt_actual : vcnt_actual) & 0x1ff;
+
+    for( int x = 0; x < SCN_SCREEN_WIDTH; x++ )
+    {
+        int hcnt_actual = x + SCN_H_START + h_adjust;
+        int hcnt = (flip ? 343 - hcnt_actual : hcnt_actual) & 0x1ff;
+
+        // Rowscroll is fetched once per line, colscroll once per column
+        if (layer == SCN_BG0)
+        {
+            int hofs = state.ctrl[0] + state.ram[BG0_ROWSCROLL + (vcnt & 0xff)];
+            dots[x] = bg_dot(state, BG0_MAP, hcnt - hofs, vcnt - state.ctrl[3]);
+        }
+        else if (layer == SCN_BG1)
+        {
+            int hofs = state.ctrl[1] + state.ram[BG1_ROWSCROLL + (vcnt & 0xff)];
+            int vofs = state.ctrl[4] + state.ram[BG1_COLSCROLL + ((hcnt >> 3) & 63)];
+            dots[x] = bg_dot(state, BG1_MAP, hcnt - hofs, vcnt - vofs);
+        }
+        else
+        {
+            dots[x] = fg0_dot(state, hcnt - state.ctrl[2], vcnt - state.ctrl[5]);
+        }
+    }
+}
+
+uint16_t scn_mix(const SCNState &state, uint16_t bg0, uint16_t bg1, uint16_t fg0)
+{
+    bool bg0_prio = state.ctrl[6] & 0x8;
+    bool bg0_en = scn_layer_enabled(state, SCN_BG0) && (bg0 & 0xf);
+    bool bg1_en = scn_layer_enabled(state, SCN_BG1) && (bg1 & 0xf);
+    bool fg0_en = scn_layer_enabled(state, SCN_FG0) && (fg0 & 0xf);
+
+    if (fg0_en) return 0x2000 | fg0;
+    if (!bg0_prio && bg1_en) return 0x6000 | bg1;
+    if (bg0_en) return 0x4000 | bg0;
+    if (bg0_prio && bg1_en) return 0x6000 | bg1;
+    return 0x4000;
+}
@@ -0,0 +1,53 @@
+#if !defined(TC0100SCN_H)
+#define TC0100SCN_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Functional model of the TC0100SCN tilemap layers, following tc0100scn.sv.
+//
+// Dots are 12-bit values, palette in the top 8 bits and the pixel in the
+// low 4 bits, with a pixel of 0 being transparent. Planes are the full
+// 64x64 tile maps, screen lines apply scroll, rowscroll and the BG1
+// colscroll the same way the RTL fetches them.
+
+static const int SCN_PLANE_SIZE = 512;
+static const int SCN_SCREEN_WIDTH = 320;
+static const int SCN_SCREEN_HEIGHT = 224;
+
+// First active hcnt and vcnt, from HSYNn and VSYNn
+static const int SCN_H_START = 25;
+static const int SCN_V_START = 2;
+
+enum SCNLayer
+{
+    SCN_BG0,
+    SCN_BG1,
+    SCN_FG0,
+    SCN_LAYER_COUNT
+};
+
+struct SCNState
+{
+    uint16_t ram[0x8000];       // words, scn_ram_0
+    uint16_t ctrl[8];
+    const uint8_t *rom;         // tile data in SDRAM
+    size_t rom_size;
+};
+
+// Fill the state from the current RTL state
+void scn_state_from_rtl(SCNState *state);
+
+bool scn_layer_enabled(const SCNState &state, int layer);
+
+// Render a whole 512x512 plane with no scrolling
+void scn_render_plane(const SCNState &state, int layer, uint16_t *plane);
+
+// Render SCN_SCREEN_WIDTH dots of a layer for an active screen line.
+// h_adjust moves the sample position, for lining up with captured frames.
+void scn_render_line(const SCNState &state, int layer, int line, int h_adjust, uint16_t *dots);
+
+// Layer priority mux, returns the 15-bit SC output
+uint16_t scn_mix(const SCNState &state, uint16_t bg0, uint16_t bg1, uint16_t fg0);
+
+#endif // TC0100SCN_H
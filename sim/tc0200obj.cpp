@@ -8,64 +8,149 @@
 #include "F2.h"
 #include "F2___024root.h"
 
+#include <vector>
+#include <unordered_map>
+#include <string.h>
+
 extern F2* top;
 
 static SDL_Renderer *s_renderer = nullptr;
-static uint64_t s_used_idx = 0;
 static const uint8_t *s_palette_low = nullptr;
 static const uint8_t *s_palette_high = nullptr;
 static const uint8_t *s_objmem = nullptr;
 
+// Palette contents as of the last update_obj_cache(), and a generation
+// counter per palette that is bumped whenever they change. Cache entries
+// remember the generation they were decoded with.
+static uint16_t s_palette_shadow[256][16];
+static uint32_t s_palette_gen[256];
+
+static const int OBJ_CACHE_SIZE = 2048;
 
+// Textures are never freed while the cache is alive, the least recently
+// used entry is redecoded in place when a new one is needed
 struct ObjCacheEntry
 {
-    SDL_Texture *texture;
-    uint64_t last_used;
+    SDL_Texture *texture = nullptr;
+    uint32_t key = 0;
+    uint32_t gen = 0;
+    int prev = -1;
+    int next = -1;
+};
 
-    ObjCacheEntry() : texture(nullptr), last_used(0) {}
+static std::vector<ObjCacheEntry> s_entries;
 
-    ObjCacheEntry(SDL_Texture *tex)
-        : texture(tex)
-        , last_used(0) {}
+// Atlas pages for the preview, OBJ_PAGE_TILES codes in a 16x16 grid of
+// tiles. A page is redecoded when its palette generation changes or the
+// checksum of its source data does, the checksum is only recomputed the
+// first time a page is used in a UI frame.
+static const int OBJ_PAGE_TILES = 256;
+static const int OBJ_PAGE_SIZE = 256;
+static const int OBJ_PAGE_CACHE_SIZE = 32;
 
-    ObjCacheEntry(ObjCacheEntry&& o)
-    {
-        texture = o.texture;
-        last_used = o.last_used;
-        o.texture = nullptr;
-    }
+struct ObjPage
+{
+    SDL_Texture *texture = nullptr;
+    uint32_t key = 0;
+    uint32_t gen = 0;
+    uint64_t src_hash = 0;
+    int checked_frame = -1;
+    uint64_t last_used = 0;
+};
+
+static std::vector<ObjPage> s_pages;
+static uint64_t s_page_used_idx = 0;
+static std::unordered_map<uint32_t, int> s_index;
+static int s_lru_head = -1; // most recently used
+static int s_lru_tail = -1;
+
+static void lru_unlink(int idx)
+{
+    ObjCacheEntry &e = s_entries[idx];
+    if (e.prev >= 0) s_entries[e.prev].next = e.next; else s_lru_head = e.next;
+    if (e.next >= 0) s_entries[e.next].prev = e.prev; else s_lru_tail = e.prev;
+    e.prev = e.next = -1;
+}
+
+static void lru_push_front(int idx)
+{
+    ObjCacheEntry &e = s_entries[idx];
+    e.prev = -1;
+    e.next = s_lru_head;
+    if (s_lru_head >= 0) s_entries[s_lru_head].prev = idx;
+    s_lru_head = idx;
+    if (s_lru_tail < 0) s_lru_tail = idx;
+}
 
-    ~ObjCacheEntry()
+static void read_palette(uint8_t palette, uint16_t *rawpal)
+{
+    uint16_t pal_ofs = palette * 16;
+    for( int i = 0; i < 16; i++ )
     {
-        if (texture)
-            SDL_DestroyTexture(texture);
+        rawpal[i] = (s_palette_high[pal_ofs + i] << 8) | (s_palette_low[pal_ofs + i] << 0);
     }
+}
+
+static uint32_t palette_rgb(uint16_t raw)
+{
+    uint8_t r = ((raw & 0xf000) >> 8) | ((raw & 0x0008) >> 0);
+    uint8_t g = ((raw & 0x0f00) >> 4) | ((raw & 0x0004) << 1);
+    uint8_t b = ((raw & 0x00f0) >> 0) | ((raw & 0x0002) << 2);
 
-    ObjCacheEntry(const ObjCacheEntry&) = delete;
+    return (r << 24) | (g << 16) | (b << 8);
+}
 
-    SDL_Texture *deref()
+uint32_t obj_palette_rgb(uint16_t index)
+{
+    index &= 0x3fff;
+    return palette_rgb((s_palette_high[index] << 8) | s_palette_low[index]);
+}
+
+// Pixel pairs for every byte of 4bpp data, so a byte expands with one
+// 64-bit store. Low nibble is the left pixel.
+static void build_pair_lut(uint8_t palette, uint64_t *lut)
+{
+    uint16_t rawpal[16];
+    read_palette(palette, rawpal);
+
+    uint32_t pal32[16];
+    for( int i = 0; i < 16; i++ )
     {
-        last_used = s_used_idx;
-        s_used_idx++;
-        return texture;
+        pal32[i] = palette_rgb(rawpal[i]);
     }
-};
 
-static std::map<uint64_t, ObjCacheEntry> obj_cache;
+    for( int i = 0; i < 256; i++ )
+    {
+        uint32_t pair[2] = { pal32[i & 0xf], pal32[i >> 4] };
+        memcpy(&lut[i], pair, sizeof(pair));
+    }
+}
 
-#define FNV_64_PRIME ((uint64_t)0x100000001b3ULL)
+// Expand one 16x16 tile into dest, pitch is in pixels
+static void expand_obj(const uint64_t *lut, const uint8_t *src, uint32_t *dest, int pitch)
+{
+    for( int y = 0; y < 16; y++ )
+    {
+        uint64_t row[8];
+        for( int i = 0; i < 8; i++ )
+        {
+            row[i] = lut[src[i]];
+        }
+        memcpy(dest, row, sizeof(row));
+        src += 8;
+        dest += pitch;
+    }
+}
 
-uint64_t fnv_hash(void *buf, size_t len, uint64_t hval)
+static void decode_obj(SDL_Texture *tex, uint16_t code, uint8_t palette)
 {
-    unsigned char *bp = (unsigned char *)buf;
-    unsigned char *be = bp + len;
+    uint64_t lut[256];
+    build_pair_lut(palette, lut);
 
-    while (bp < be) {
-	    hval *= FNV_64_PRIME;
-	    hval ^= (uint64_t)*bp++;
-    }
+    uint32_t pixels[16 * 16];
+    expand_obj(lut, s_objmem + (code * 128), pixels, 16);
 
-    return hval;
+    SDL_UpdateTexture(tex, nullptr, pixels, 16 * 4);
 }
 
 void init_obj_cache(SDL_Renderer *renderer, const void *objmem, const void *palmem_low, const void *palmem_high)
@@ -74,74 +159,165 @@ void init_obj_cache(SDL_Renderer *renderer, const void *objmem, const void *palm
     s_objmem = (const uint8_t *)objmem;
     s_palette_low = (const uint8_t *)palmem_low;
     s_palette_high = (const uint8_t *)palmem_high;
-}
 
-void prune_obj_cache()
-{
-    if (obj_cache.size() < 2048) return;
+    s_entries.clear();
+    s_entries.reserve(OBJ_CACHE_SIZE);
+    s_index.clear();
+    s_index.reserve(OBJ_CACHE_SIZE * 2);
+    s_lru_head = s_lru_tail = -1;
 
-    size_t num_to_remove = 128;
+    for( int i = 0; i < 256; i++ )
+    {
+        read_palette(i, s_palette_shadow[i]);
+        s_palette_gen[i] = 1;
+    }
 
-    std::vector<std::pair<uint64_t, uint64_t>> hash_ages;
-    for( const auto& it : obj_cache )
+    for( auto &page : s_pages )
     {
-        hash_ages.push_back({it.second.last_used, it.first});
+        if (page.texture) SDL_DestroyTexture(page.texture);
     }
-    std::sort(hash_ages.begin(), hash_ages.end());
-    for( size_t i = 0; i < num_to_remove; i++ )
+    s_pages.clear();
+}
+
+void update_obj_cache()
+{
+    if (!s_palette_low) return;
+
+    for( int i = 0; i < 256; i++ )
     {
-        obj_cache.erase(hash_ages[i].second);
+        uint16_t rawpal[16];
+        read_palette(i, rawpal);
+        if (memcmp(rawpal, s_palette_shadow[i], sizeof(rawpal)))
+        {
+            memcpy(s_palette_shadow[i], rawpal, sizeof(rawpal));
+            s_palette_gen[i]++;
+        }
     }
 }
 
 SDL_Texture *get_obj_texture(uint16_t code, uint8_t palette)
 {
-    uint16_t pal_ofs = palette * 16;
-
-    uint16_t rawpal[16];
+    uint32_t key = (code << 8) | palette;
 
-    for( int i = 0; i < 16; i++ )
+    auto it = s_index.find(key);
+    if (it != s_index.end())
     {
-        rawpal[i] = (s_palette_high[pal_ofs + i] << 8) | (s_palette_low[pal_ofs + i] << 0);
+        int idx = it->second;
+        ObjCacheEntry &e = s_entries[idx];
+        if (e.gen != s_palette_gen[palette])
+        {
+            decode_obj(e.texture, code, palette);
+            e.gen = s_palette_gen[palette];
+        }
+        if (idx != s_lru_head)
+        {
+            lru_unlink(idx);
+            lru_push_front(idx);
+        }
+        return e.texture;
     }
 
-    uint64_t hash = fnv_hash(rawpal, sizeof(rawpal), code);
-    auto it = obj_cache.find(hash);
-    if (it != obj_cache.end())
+    int idx;
+    if ((int)s_entries.size() < OBJ_CACHE_SIZE)
     {
-        return it->second.deref();
+        idx = (int)s_entries.size();
+        s_entries.emplace_back();
+        s_entries[idx].texture = SDL_CreateTexture(s_renderer, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STATIC, 16, 16);
     }
-
-    uint32_t pal32[16];
-    for( int i = 0; i < 16; i++ )
+    else
     {
-        uint8_t r = ((rawpal[i] & 0xf000) >> 8) | ((rawpal[i] & 0x0008) >> 0);
-        uint8_t g = ((rawpal[i] & 0x0f00) >> 4) | ((rawpal[i] & 0x0004) << 1);
-        uint8_t b = ((rawpal[i] & 0x00f0) >> 0) | ((rawpal[i] & 0x0002) << 2);
+        idx = s_lru_tail;
+        lru_unlink(idx);
+        s_index.erase(s_entries[idx].key);
+    }
+
+    ObjCacheEntry &e = s_entries[idx];
+    e.key = key;
+    e.gen = s_palette_gen[palette];
+    decode_obj(e.texture, code, palette);
 
-        uint32_t c = (r << 24) | (g << 16) | (b << 8);
-        pal32[i] = c;
+    s_index[key] = idx;
+    lru_push_front(idx);
+    return e.texture;
+}
+
+static uint64_t page_hash(const uint8_t *src)
+{
+    const uint64_t *p = (const uint64_t *)src;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for( int i = 0; i < OBJ_PAGE_TILES * 128 / 8; i++ )
+    {
+        h = (h ^ p[i]) * 0x100000001b3ULL;
     }
+    return h;
+}
 
-    SDL_Texture *tex = SDL_CreateTexture(s_renderer, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STATIC, 16, 16);
+SDL_Texture *get_obj_page_texture(uint8_t page, uint8_t palette)
+{
+    uint32_t key = (page << 8) | palette;
+    int frame = ImGui::GetFrameCount();
+    const uint8_t *src = s_objmem + (page * OBJ_PAGE_TILES * 128);
 
-    const uint8_t *src = s_objmem + (code * 128);
-    uint32_t pixels[16 * 16];
-    uint32_t *dest = pixels;
+    ObjPage *entry = nullptr;
+    for( auto &p : s_pages )
+    {
+        if (p.texture && p.key == key)
+        {
+            entry = &p;
+            break;
+        }
+    }
 
-    for( int i = 0; i < 128; i++ )
+    bool decode = false;
+    if (!entry)
     {
-        dest[1] = pal32[((*src & 0xf0) >> 4)];
-        dest[0] = pal32[((*src & 0x0f) >> 0)];
-        dest += 2;
-        src++;
+        if ((int)s_pages.size() < OBJ_PAGE_CACHE_SIZE)
+        {
+            s_pages.emplace_back();
+            entry = &s_pages.back();
+            entry->texture = SDL_CreateTexture(s_renderer, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STATIC, OBJ_PAGE_SIZE, OBJ_PAGE_SIZE);
+        }
+        else
+        {
+            entry = &s_pages[0];
+            for( auto &p : s_pages )
+            {
+                if (p.last_used < entry->last_used) entry = &p;
+            }
+        }
+        entry->key = key;
+        entry->src_hash = page_hash(src);
+        entry->checked_frame = frame;
+        decode = true;
+    }
+    else if (entry->checked_frame != frame)
+    {
+        entry->checked_frame = frame;
+        uint64_t h = page_hash(src);
+        if (h != entry->src_hash)
+        {
+            entry->src_hash = h;
+            decode = true;
+        }
     }
 
-    SDL_UpdateTexture(tex, nullptr, pixels, 16 * 4);
+    if (decode || entry->gen != s_palette_gen[palette])
+    {
+        uint64_t lut[256];
+        build_pair_lut(palette, lut);
 
-    obj_cache.emplace(hash, ObjCacheEntry(tex));
+        static uint32_t pixels[OBJ_PAGE_SIZE * OBJ_PAGE_SIZE];
+        for( int t = 0; t < OBJ_PAGE_TILES; t++ )
+        {
+            uint32_t *dest = pixels + ((t / 16) * 16 * OBJ_PAGE_SIZE) + ((t % 16) * 16);
+            expand_obj(lut, src + (t * 128), dest, OBJ_PAGE_SIZE);
+        }
+        SDL_UpdateTexture(entry->texture, nullptr, pixels, OBJ_PAGE_SIZE * 4);
+        entry->gen = s_palette_gen[palette];
+    }
 
-    return obj_cache[hash].deref();
+    entry->last_used = ++s_page_used_idx;
+    return entry->texture;
 }
 
 
@@ -372,12 +548,15 @@ void draw_obj_preview_window()
             {
                 ImGui::TableNextRow();
                 ImGui::TableNextColumn(); ImGui::Text("%03Xx", index);
-                uint16_t base_code = index * 16;
+                // Each row is one row of tiles in an atlas page, every
+                // image in the page batches into the same draw call
+                SDL_Texture *tex = get_obj_page_texture(index / 16, (uint8_t)color);
+                float v0 = (index % 16) / 16.0f;
+                float v1 = v0 + (1.0f / 16.0f);
                 for( int i = 0; i < 16; i++)
                 {
                     ImGui::TableNextColumn(); 
-                    SDL_Texture *tex = get_obj_texture((uint16_t)base_code + i, (uint8_t)color);
-                    ImGui::Image((ImTextureID)tex, ImVec2(32, 32));
+                    ImGui::Image((ImTextureID)tex, ImVec2(32, 32), ImVec2(i / 16.0f, v0), ImVec2((i + 1) / 16.0f, v1));
                 }
             }
         }
@@ -82,8 +82,15 @@ void draw_obj_window();
 void draw_obj_preview_window();
 
 void init_obj_cache(SDL_Renderer *renderer, const void *objmem, const void *palmem_low, const void *palmem_high);
-void prune_obj_cache();
+// Call once per UI frame, picks up palette changes
+void update_obj_cache();
 SDL_Texture *get_obj_texture(uint16_t code, uint8_t palette);
 
+// RGBX8888 color of a color_ram entry
+uint32_t obj_palette_rgb(uint16_t index);
+
+// 256x256 atlas of the 256 codes starting at page * 256
+SDL_Texture *get_obj_page_texture(uint8_t page, uint8_t palette);
+
 #endif
 
@@ -0,0 +1,522 @@
+#include <SDL.h>
+
+#include "imgui.h"
+#include "imgui_internal.h"
+#include "imgui_wrap.h"
+#include "tc0200obj.h"
+#include "tc0200obj_render.h"
+#include "games.h"
+#include "sim_ddr.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include <chrono>
+#include <string.h>
+
+extern F2* top;
+extern SimDDR ddr_memory;
+
+// Instances processed per frame before the RTL gives up
+static const int OBJ_MAX_INSTANCES = 835;
+
+// tc0200obj_zoom_calc, picks which of the 16 source rows or columns are
+// drawn for a given zoom delta
+struct ObjZoomCalc
+{
+    uint16_t accum = 0;
+    int count = 0;
+    uint8_t indices[16];
+
+    void run(uint16_t delta, bool cont)
+    {
+        if (!cont) accum = 0;
+        count = 0;
+        for( int index = 0; index < 16; index++ )
+        {
+            uint16_t next = (accum + delta) & 0x1ff;
+            if ((next ^ accum) & 0x100)
+            {
+                indices[count & 15] = index;
+                count++;
+            }
+            accum = next;
+        }
+    }
+};
+
+void obj_render_input_from_rtl(ObjRenderInput *input)
+{
+    auto root = top->rootp;
+
+    for( int i = 0; i < 0x8000; i++ )
+    {
+        input->obj_ram[i] = (root->F2__DOT__obj_ram__DOT__ram_h.m_storage[i] << 8) | root->F2__DOT__obj_ram__DOT__ram_l.m_storage[i];
+    }
+
+    input->obj_data = ddr_memory.memory.data() + OBJ_DATA_DDR_BASE;
+    input->obj_data_size = ddr_memory.memory.size() - OBJ_DATA_DDR_BASE;
+
+    input->cmd_ctrl = root->F2__DOT__tc0200obj__DOT__cmd_ctrl;
+    input->master_x = root->F2__DOT__tc0200obj__DOT__master_x;
+    input->master_y = root->F2__DOT__tc0200obj__DOT__master_y;
+
+    input->extender_mode = root->F2__DOT__cfg_obj_extender;
+    memcpy(input->extension_ram, root->F2__DOT__tc0200obj_extender__DOT__extension_ram__DOT__ram.m_storage, sizeof(input->extension_ram));
+    input->fmc = root->F2__DOT__cfg_190fmc != 0;
+    for( int i = 0; i < 8; i++ )
+    {
+        input->fmc_ctrl[i] = root->F2__DOT__tc0190fmc__DOT__ctrl.m_storage[i];
+    }
+
+    input->flip_x_origin = root->F2__DOT__tc0200obj__DOT__flip_x_origin;
+    input->flip_y_origin = root->F2__DOT__tc0200obj__DOT__flip_y_origin;
+}
+
+static uint32_t modify_code(const ObjRenderInput &input, uint16_t code, uint32_t ext_index)
+{
+    if (input.fmc)
+    {
+        switch ((code >> 10) & 7)
+        {
+            case 0: case 1: return (input.fmc_ctrl[2] << 11) | (code & 0x7ff);
+            case 2: case 3: return (input.fmc_ctrl[3] << 11) | (code & 0x7ff);
+            default: return (input.fmc_ctrl[4 + ((code >> 10) & 3)] << 10) | (code & 0x3ff);
+        }
+    }
+
+    if (input.extender_mode == 1 || input.extender_mode == 2)
+    {
+        return (input.extension_ram[ext_index & 0xfff] << 8) | (code & 0xff);
+    }
+
+    return code;
+}
+
+// 16x16 tile into 6-bit pixels, as tc0200obj_data_shifter loads them
+static bool decode_tile(const ObjRenderInput &input, uint32_t code, bool bpp6, uint8_t *pixel)
+{
+    size_t size = bpp6 ? 256 : 128;
+    size_t offset = (size_t)code * size;
+    if (offset + size > input.obj_data_size) return false;
+
+    const uint8_t *src = input.obj_data + offset;
+    if (bpp6)
+    {
+        for( int i = 0; i < 64; i++ )
+        {
+            uint32_t d = src[0] | (src[1] << 8) | (src[2] << 16) | (src[3] << 24);
+            pixel[0] = ((d >> 16) & 0x3) << 4 | ((d >> 8) & 0xf);
+            pixel[1] = ((d >> 18) & 0x3) << 4 | ((d >> 12) & 0xf);
+            pixel[2] = ((d >> 20) & 0x3) << 4 | ((d >> 0) & 0xf);
+            pixel[3] = ((d >> 22) & 0x3) << 4 | ((d >> 4) & 0xf);
+            pixel += 4;
+            src += 4;
+        }
+    }
+    else
+    {
+        for( int i = 0; i < 128; i++ )
+        {
+            pixel[0] = src[i] & 0xf;
+            pixel[1] = src[i] >> 4;
+            pixel += 2;
+        }
+    }
+    return true;
+}
+
+void obj_render(const ObjRenderInput &input, uint16_t *fb, ObjRenderStats *stats)
+{
+    memset(fb, 0, OBJ_FB_WIDTH * OBJ_FB_HEIGHT * sizeof(uint16_t));
+
+    uint16_t ctrl = input.cmd_ctrl;
+    uint16_t master_x = input.master_x, master_y = input.master_y;
+    uint16_t extra_x = 0, extra_y = 0;
+    uint16_t base_x = 0, base_y = 0;
+    uint16_t latch_x = 0, latch_y = 0;
+    uint8_t latch_color = 0;
+    uint16_t zoom_dx = 0, zoom_dy = 0;
+    bool prev_seq = false;
+    ObjZoomCalc row_calc, col_calc;
+
+    int drawn = 0;
+    uint8_t pixel[256];
+
+    for( int index = 0; index < OBJ_MAX_INSTANCES; index++ )
+    {
+        // Read the instance, command entries can switch banks part way
+        uint16_t w[8];
+        bool zero_bank = false;
+        bool is_cmd = false;
+        uint32_t code = 0;
+        for( int k = 0; k < 8; k++ )
+        {
+            uint32_t addr = (index * 8) + k;
+            uint32_t bank = ((ctrl & 0x0001) << 1) | ((ctrl & 0x0400) >> 10);
+            uint16_t d = input.obj_ram[zero_bank ? addr : ((bank << 13) | addr)];
+            w[k] = d;
+
+            if (k == 3 && (d & 0x8000))
+            {
+                zero_bank = (d & 1) == 0;
+                is_cmd = true;
+            }
+            else if (k == 5)
+            {
+                code = modify_code(input, w[0] & 0x1fff, ((ctrl & 0x0001) << 10) | index);
+                if (is_cmd)
+                {
+                    ctrl = d;
+                    zero_bank = false;
+                }
+            }
+        }
+
+        // Coordinates come from words 6 and 7, which the DMA at the
+        // start of the frame copied from words 2 and 3
+        uint16_t x_coord = w[6] & 0xfff;
+        uint16_t y_coord = w[7] & 0xfff;
+        bool latch_extra = (w[6] >> 12) & 1;
+        bool latch_master = (w[6] >> 13) & 1;
+        bool use_extra = !((w[6] >> 14) & 1);
+        bool use_scroll = !((w[6] >> 15) & 1);
+
+        uint8_t color = w[4] & 0xff;
+        bool flip_x = (w[4] >> 8) & 1;
+        bool flip_y = (w[4] >> 9) & 1;
+        bool reuse_color = (w[4] >> 10) & 1;
+        bool next_seq = (w[4] >> 11) & 1;
+        bool use_latch_y = (w[4] >> 12) & 1;
+        bool inc_y = (w[4] >> 13) & 1;
+        bool use_latch_x = (w[4] >> 14) & 1;
+        bool inc_x = (w[4] >> 15) & 1;
+
+        // ST_EVAL0/1
+        bool is_seq_start = !prev_seq;
+        prev_seq = next_seq;
+
+        if (is_seq_start)
+        {
+            base_x = (x_coord + (use_scroll ? (master_x + (use_extra ? extra_x : 0)) : 0)) & 0xfff;
+            base_y = (y_coord + (use_scroll ? (master_y + (use_extra ? extra_y : 0)) : 0)) & 0xfff;
+        }
+
+        if (latch_extra && !use_extra)
+        {
+            extra_x = x_coord;
+            extra_y = y_coord;
+        }
+
+        if (latch_master && !use_scroll)
+        {
+            master_x = x_coord;
+            master_y = y_coord;
+        }
+
+        // ST_EVAL2, the latches step by the previous instance's counts
+        int prev_row_count = row_calc.count;
+        int prev_col_count = col_calc.count;
+
+        if (is_seq_start)
+        {
+            zoom_dx = 0x100 - (w[1] & 0xff);
+            zoom_dy = 0x100 - (w[1] >> 8);
+            row_calc.run(zoom_dy, inc_y);
+            col_calc.run(zoom_dx, inc_x);
+        }
+        else
+        {
+            row_calc.run(zoom_dy, inc_y);
+            if (inc_x) col_calc.run(zoom_dx, inc_x);
+        }
+
+        if (use_latch_y)
+            latch_y = (latch_y + prev_row_count) & 0xfff;
+        else
+            latch_y = base_y;
+
+        if (use_latch_x || inc_x)
+            latch_x = (latch_x + (inc_x ? prev_col_count : 0)) & 0xfff;
+        else
+            latch_x = base_x;
+
+        if (!reuse_color) latch_color = color;
+
+        // ST_EVAL3 and ST_CHECK_BOUNDS
+        bool disable = (ctrl >> 12) & 1;
+        if (code == 0 || disable) continue;
+        if (latch_x > 480 || latch_y > 240) continue;
+
+        bool bpp6 = (ctrl >> 8) & 1;
+        bool flipscreen = (ctrl >> 13) & 1;
+        if (!decode_tile(input, code, bpp6, pixel)) continue;
+        drawn++;
+
+        uint16_t x = flipscreen ? ((input.flip_x_origin - latch_x) & 0xfff) : latch_x;
+        uint16_t y = flipscreen ? ((input.flip_y_origin - latch_y) & 0xfff) : latch_y;
+        flip_x ^= flipscreen;
+        flip_y ^= flipscreen;
+
+        uint16_t dot_color = bpp6 ? ((latch_color >> 2) << 6) : (latch_color << 4);
+        uint8_t pixel_mask = bpp6 ? 0x3f : 0x0f;
+        uint16_t base_addr = ((y & 0xff) << 7) | ((x >> 2) & 0x7f);
+        int x_shift = x & 3;
+
+        // tc0200obj_data_shifter, rows of 20 pixels written as five groups
+        // of four, the group address carries into the line
+        for( int r = 0; r < row_calc.count && r < 16; r++ )
+        {
+            uint8_t row_data[20];
+            memset(row_data, 0, sizeof(row_data));
+
+            int ri = row_calc.indices[r] ^ (flip_y ? 15 : 0);
+            for( int i = 0; i < col_calc.count && i < 16; i++ )
+            {
+                int ci = col_calc.indices[i] ^ (flip_x ? 15 : 0);
+                row_data[i + x_shift] = pixel[(ri * 16) + ci];
+            }
+
+            for( int col = 0; col < 5; col++ )
+            {
+                uint16_t addr = (base_addr + (r << 7) + col) & 0x7fff;
+                uint16_t *dest = fb + ((addr >> 7) * OBJ_FB_WIDTH) + ((addr & 0x7f) * 4);
+                for( int k = 0; k < 4; k++ )
+                {
+                    uint8_t p = row_data[(col * 4) + k];
+                    if (p) dest[k] = dot_color | (p & pixel_mask);
+                }
+            }
+        }
+    }
+
+    // Scanout only shows pixels with a non-zero pen
+    uint16_t pen_mask = ((ctrl >> 8) & 1) ? 0x3f : 0x0f;
+    for( int i = 0; i < OBJ_FB_WIDTH * OBJ_FB_HEIGHT; i++ )
+    {
+        if ((fb[i] & pen_mask) == 0) fb[i] = 0;
+    }
+
+    if (stats)
+    {
+        stats->instances = OBJ_MAX_INSTANCES;
+        stats->drawn = drawn;
+        stats->cmd_ctrl = ctrl;
+    }
+}
+
+void obj_read_rtl_fb(uint16_t *fb)
+{
+    auto root = top->rootp;
+    uint32_t buffer = root->F2__DOT__tc0200obj__DOT__scanout_buffer & 1;
+    const uint8_t *src = ddr_memory.memory.data() + OBJ_FB_DDR_BASE + (buffer << 18);
+    uint16_t pen_mask = ((root->F2__DOT__tc0200obj__DOT__cmd_ctrl >> 8) & 1) ? 0x3f : 0x0f;
+
+    for( int y = 0; y < OBJ_FB_HEIGHT; y++ )
+    {
+        for( int group = 0; group < OBJ_FB_WIDTH / 4; group++ )
+        {
+            uint16_t *dest = fb + (y * OBJ_FB_WIDTH) + (group * 4);
+            bool dirty = root->F2__DOT__tc0200obj__DOT__fb_dirty_buffer__DOT__ram.m_storage[(buffer << 15) | (y << 7) | group] != 0;
+            for( int k = 0; k < 4; k++ )
+            {
+                const uint8_t *p = src + (y << 10) + (group * 8) + (k * 2);
+                uint16_t v = (p[0] | (p[1] << 8)) & 0xfff;
+                dest[k] = (dirty && (v & pen_mask)) ? v : 0;
+            }
+        }
+    }
+}
+
+enum ObjView
+{
+    VIEW_MODEL,
+    VIEW_RTL,
+    VIEW_DIFF
+};
+
+bool obj_compare_active = false;
+
+static ObjRenderInput s_input;
+static uint16_t s_model_fb[OBJ_FB_WIDTH * OBJ_FB_HEIGHT];
+static uint16_t s_rtl_fb[OBJ_FB_WIDTH * OBJ_FB_HEIGHT];
+static ObjRenderStats s_stats;
+static double s_render_ms = 0.0;
+static int s_mismatches = 0;
+static bool s_have_rtl = false;
+static bool s_texture_dirty = false;
+
+static int s_last_buffer = -1;
+static uint16_t s_frame_cmd_ctrl, s_frame_master_x, s_frame_master_y;
+static uint64_t s_frames_compared = 0;
+static uint64_t s_frames_mismatched = 0;
+
+static SDL_Texture *s_texture = nullptr;
+
+static void render_and_compare(bool with_rtl)
+{
+    auto start = std::chrono::steady_clock::now();
+    obj_render(s_input, s_model_fb, &s_stats);
+    s_render_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    s_have_rtl = with_rtl;
+    s_mismatches = 0;
+    if (with_rtl)
+    {
+        obj_read_rtl_fb(s_rtl_fb);
+        for( int i = 0; i < OBJ_FB_WIDTH * OBJ_FB_HEIGHT; i++ )
+        {
+            if (s_model_fb[i] != s_rtl_fb[i]) s_mismatches++;
+        }
+    }
+    s_texture_dirty = true;
+}
+
+void obj_compare_tick()
+{
+    int buffer = top->rootp->F2__DOT__tc0200obj__DOT__scanout_buffer & 1;
+    if (buffer == s_last_buffer) return;
+
+    // The buffer that was just swapped in for scanout was drawn starting
+    // from the state saved at the previous swap. Words 6 and 7 haven't
+    // been overwritten by this frame's DMA yet.
+    if (s_last_buffer >= 0)
+    {
+        obj_render_input_from_rtl(&s_input);
+        s_input.cmd_ctrl = s_frame_cmd_ctrl;
+        s_input.master_x = s_frame_master_x;
+        s_input.master_y = s_frame_master_y;
+        render_and_compare(true);
+
+        s_frames_compared++;
+        if (s_mismatches) s_frames_mismatched++;
+    }
+
+    s_last_buffer = buffer;
+    s_frame_cmd_ctrl = top->rootp->F2__DOT__tc0200obj__DOT__cmd_ctrl;
+    s_frame_master_x = top->rootp->F2__DOT__tc0200obj__DOT__master_x;
+    s_frame_master_y = top->rootp->F2__DOT__tc0200obj__DOT__master_y;
+}
+
+static uint32_t dim(uint32_t c)
+{
+    return (c >> 2) & 0x3f3f3f00;
+}
+
+static void update_texture(int view)
+{
+    if (!s_texture)
+    {
+        s_texture = SDL_CreateTexture(imgui_get_renderer(), SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STREAMING, OBJ_FB_WIDTH, OBJ_FB_HEIGHT);
+    }
+
+    void *work;
+    int pitch;
+    SDL_LockTexture(s_texture, nullptr, &work, &pitch);
+
+    for( int y = 0; y < OBJ_FB_HEIGHT; y++ )
+    {
+        uint32_t *dest = (uint32_t *)((uint8_t *)work + (pitch * y));
+        const uint16_t *model = s_model_fb + (y * OBJ_FB_WIDTH);
+        const uint16_t *rtl = s_rtl_fb + (y * OBJ_FB_WIDTH);
+        for( int x = 0; x < OBJ_FB_WIDTH; x++ )
+        {
+            uint32_t c = 0;
+            if (view == VIEW_MODEL)
+            {
+                c = model[x] ? obj_palette_rgb(model[x]) : 0;
+            }
+            else if (view == VIEW_RTL)
+            {
+                c = (s_have_rtl && rtl[x]) ? obj_palette_rgb(rtl[x]) : 0;
+            }
+            else if (!s_have_rtl || model[x] == rtl[x])
+            {
+                c = model[x] ? dim(obj_palette_rgb(model[x])) : 0;
+            }
+            else if (model[x] && rtl[x])
+            {
+                c = 0xffff0000; // both drew, different values
+            }
+            else if (rtl[x])
+            {
+                c = 0xff000000; // only the RTL drew
+            }
+            else
+            {
+                c = 0x00ff0000; // only the model drew
+            }
+            dest[x] = c;
+        }
+    }
+
+    SDL_UnlockTexture(s_texture);
+}
+
+void draw_obj_render_window()
+{
+    static int view = VIEW_DIFF;
+    static int last_view = -1;
+
+    if( !ImGui::Begin("TC0200OBJ Render") )
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::Checkbox("Compare Every Frame", &obj_compare_active))
+    {
+        s_last_buffer = -1;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Render Current"))
+    {
+        // Uses the current scroll and control state, which may have moved
+        // on since the RTL drew its last frame
+        obj_render_input_from_rtl(&s_input);
+        render_and_compare(true);
+    }
+
+    ImGui::Combo("View", &view, "Model\0RTL\0Diff\0");
+
+    ImGui::Text("Model: %.2f ms, %d drawn", s_render_ms, s_stats.drawn);
+    if (s_have_rtl)
+    {
+        ImGui::Text("Mismatched pixels: %d", s_mismatches);
+    }
+    ImGui::Text("Frames compared: %llu, with mismatches: %llu", (unsigned long long)s_frames_compared, (unsigned long long)s_frames_mismatched);
+    ImGui::TextDisabled("Diff: red RTL only, green model only, yellow different");
+
+    if (s_texture_dirty || view != last_view)
+    {
+        update_texture(view);
+        s_texture_dirty = false;
+        last_view = view;
+    }
+
+    if (s_texture)
+    {
+        ImVec2 avail = ImGui::GetContentRegionAvail();
+        float scale = avail.x / OBJ_FB_WIDTH;
+        if (scale < 1.0f) scale = 1.0f;
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::Image((ImTextureID)s_texture, ImVec2(OBJ_FB_WIDTH * scale, OBJ_FB_HEIGHT * scale));
+
+        if (ImGui::IsItemHovered())
+        {
+            ImVec2 mouse = ImGui::GetMousePos();
+            int x = (int)((mouse.x - origin.x) / scale);
+            int y = (int)((mouse.y - origin.y) / scale);
+            if (x >= 0 && x < OBJ_FB_WIDTH && y >= 0 && y < OBJ_FB_HEIGHT)
+            {
+                ImGui::BeginTooltip();
+                ImGui::Text("X: %d Y: %d", x, y);
+                ImGui::Text("Model: %03X", s_model_fb[(y * OBJ_FB_WIDTH) + x]);
+                if (s_have_rtl) ImGui::Text("RTL:   %03X", s_rtl_fb[(y * OBJ_FB_WIDTH) + x]);
+                ImGui::EndTooltip();
+            }
+        }
+    }
+
+    ImGui::End();
+}
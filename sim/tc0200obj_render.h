@@ -0,0 +1,60 @@
+#if !defined(TC0200OBJ_RENDER_H)
+#define TC0200OBJ_RENDER_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Software model of the TC0200OBJ draw process, following tc0200obj.sv.
+//
+// Walks the instance list the way the RTL does (sequences, latched
+// position and color, master/extra scroll, zoom, flip, command entries
+// and bank switching) and draws into a 512x256 buffer in the same
+// format as the DDR framebuffer, 12-bit dot values with 0 for
+// transparent.
+
+static const int OBJ_FB_WIDTH = 512;
+static const int OBJ_FB_HEIGHT = 256;
+
+struct ObjRenderInput
+{
+    uint16_t obj_ram[0x8000];   // words, 4 banks of 1024 instances
+    const uint8_t *obj_data;    // sprite data in DDR
+    size_t obj_data_size;
+
+    // State carried over from the previous frame
+    uint16_t cmd_ctrl;
+    uint16_t master_x, master_y;
+
+    // Code modification, extender or TC0190FMC
+    uint8_t extender_mode;
+    uint8_t extension_ram[4096];
+    bool fmc;
+    uint8_t fmc_ctrl[8];
+
+    uint16_t flip_x_origin, flip_y_origin;
+};
+
+struct ObjRenderStats
+{
+    int instances;              // processed before the end of the list
+    int drawn;                  // passed the code and bounds checks
+    uint16_t cmd_ctrl;          // at the end of the list
+};
+
+// Fill the input from the current RTL state
+void obj_render_input_from_rtl(ObjRenderInput *input);
+
+void obj_render(const ObjRenderInput &input, uint16_t *fb, ObjRenderStats *stats);
+
+// Read the framebuffer the RTL last completed from DDR, applying the
+// dirty bits so areas not drawn this frame read as 0
+void obj_read_rtl_fb(uint16_t *fb);
+
+// When enabled, every TC0200OBJ buffer swap renders the model for the
+// completed frame and compares it to the RTL framebuffer
+extern bool obj_compare_active;
+void obj_compare_tick();
+
+void draw_obj_render_window();
+
+#endif // TC0200OBJ_RENDER_H
@@ -3,14 +3,329 @@
 #include "imgui.h"
 #include "imgui_internal.h"
 #include "imgui_wrap.h"
+#include "tc0360pri.h"
+#include "tc0200obj.h"
 
 #include "F2.h"
 #include "F2___024root.h"
 
+#include <string.h>
+
 extern F2* top;
 
+static const char *INPUT_NAMES[3] = { "SCN", "OBJ", "Pivot" };
+
+uint16_t pri_model(const uint8_t *ctrl, uint16_t color_in0, uint16_t color_in1, uint8_t color_in2, PriResult *result)
+{
+    int sel0 = (color_in0 >> 12) & 3;
+    int sel1 = (color_in1 >> 12) & 3;
+    int sel2 = (ctrl[1] >> 6) & 3;
+
+    uint16_t prio_vals0 = (ctrl[5] << 8) | ctrl[4];
+    uint16_t prio_vals1 = (ctrl[7] << 8) | ctrl[6];
+    uint16_t prio_vals2 = (ctrl[9] << 8) | ctrl[8];
+
+    // 5-bit so prio - 1 wraps to a value no input can have
+    uint8_t prio0 = (color_in0 & 0xf) ? (prio_vals0 >> (4 * sel0)) & 0xf : 0;
+    uint8_t prio1 = (color_in1 & 0xf) ? (prio_vals1 >> (4 * sel1)) & 0xf : 0;
+    uint8_t prio2 = (color_in2 & 0xf) ? (prio_vals2 >> (4 * sel2)) & 0xf : 0;
+
+    uint16_t color0 = color_in0 & 0xfff;
+    uint16_t color1 = color_in1 & 0xfff;
+    uint16_t color2 = ((ctrl[1] & 0x3f) << 6) | (color_in2 & 0x3f);
+
+    bool blend = ctrl[0] & 0x80;
+    bool bm1 = blend && (ctrl[0] & 0x40);
+
+    uint16_t color = color0;
+    int winner = 0;
+    const char *reason = "SCN by default";
+
+    if (blend && prio1 == ((prio0 - 1) & 0x1f))
+    {
+        winner = -1;
+        if (bm1)
+        {
+            color = (color1 & 0xff0) | (color0 & 0xf);
+            reason = "Blend mode 1, OBJ one below SCN: OBJ palette, SCN pixel";
+        }
+        else
+        {
+            color = (color0 & 0xfe0) | (color0 & 0xf);
+            reason = "Blend mode 2, OBJ one below SCN: SCN with bit 4 cleared";
+        }
+    }
+    else if (blend && prio1 == ((prio0 + 1) & 0x1f))
+    {
+        winner = -1;
+        if (bm1)
+        {
+            color = (color0 & 0xff0) | (color1 & 0xf);
+            reason = "Blend mode 1, OBJ one above SCN: SCN palette, OBJ pixel";
+        }
+        else
+        {
+            color = (color1 & 0xfe0) | (color1 & 0xf);
+            reason = "Blend mode 2, OBJ one above SCN: OBJ with bit 4 cleared";
+        }
+    }
+    else if (blend && prio1 == ((prio2 - 1) & 0x1f))
+    {
+        winner = -1;
+        if (bm1)
+        {
+            color = (color1 & 0xff0) | (color2 & 0xf);
+            reason = "Blend mode 1, OBJ one below Pivot: OBJ palette, Pivot pixel";
+        }
+        else
+        {
+            color = (color2 & 0xfe0) | (color2 & 0xf);
+            reason = "Blend mode 2, OBJ one below Pivot: Pivot with bit 4 cleared";
+        }
+    }
+    else if (blend && prio1 == ((prio2 + 1) & 0x1f))
+    {
+        winner = -1;
+        if (bm1)
+        {
+            color = (color2 & 0xff0) | (color1 & 0xf);
+            reason = "Blend mode 1, OBJ one above Pivot: Pivot palette, OBJ pixel";
+        }
+        else
+        {
+            color = (color1 & 0xfe0) | (color1 & 0xf);
+            reason = "Blend mode 2, OBJ one above Pivot: OBJ with bit 4 cleared";
+        }
+    }
+    else if (prio1 > prio0)
+    {
+        if (prio2 > prio1)
+        {
+            color = color2;
+            winner = 2;
+            reason = "Pivot above OBJ, OBJ above SCN";
+        }
+        else
+        {
+            color = color1;
+            winner = 1;
+            reason = "OBJ above SCN and Pivot";
+        }
+    }
+    else if (prio2 > prio0)
+    {
+        color = color2;
+        winner = 2;
+        reason = "Pivot above SCN, OBJ not above SCN";
+    }
+    else if (prio0 > 0)
+    {
+        reason = "SCN not below OBJ or Pivot";
+    }
+
+    if (result)
+    {
+        result->color = color;
+        result->prio[0] = prio0;
+        result->prio[1] = prio1;
+        result->prio[2] = prio2;
+        result->winner = winner;
+        result->reason = reason;
+    }
+    return color;
+}
+
+// Capture of one band of lines, in the same pixel positions as SimVideo
+static const int PRI_WIDTH = 320;
+static const int PRI_BAND_LINES = 32;
+static const int PRI_HISTORY = 16;
+
+struct PriSample
+{
+    uint16_t in0, in1, out;
+    uint8_t in2;
+};
+
+struct PriBand
+{
+    int start;
+    uint64_t frame;
+    bool valid;
+    PriSample pixels[PRI_BAND_LINES][PRI_WIDTH];
+    uint8_t ctrl[PRI_BAND_LINES][16];   // at the start of each line
+};
+
+bool pri_capture_active = false;
+
+static PriBand s_bands[2];
+static int s_capture_idx = 0;
+static int s_band_start = 96;
+static int s_delay = 3;
+static uint64_t s_frames = 0;
+
+static bool s_in_ce = false, s_in_hblank = false, s_in_vblank = false;
+static int s_x = 0, s_y = 0;
+static PriSample s_history[PRI_HISTORY];
+static unsigned s_history_pos = 0;
+
+static const PriBand &complete_band()
+{
+    return s_bands[s_capture_idx ^ 1];
+}
+
+void pri_capture_tick()
+{
+    bool ce = top->ce_pixel != 0;
+    if (ce == s_in_ce) return;
+    s_in_ce = ce;
+    if (!ce) return;
+
+    auto root = top->rootp;
+    PriSample &sample = s_history[s_history_pos % PRI_HISTORY];
+    sample.in0 = root->F2__DOT__tc0360pri__DOT__color_in0;
+    sample.in1 = root->F2__DOT__tc0360pri__DOT__color_in1;
+    sample.in2 = root->F2__DOT__tc0360pri__DOT__color_in2;
+    sample.out = root->F2__DOT__tc0360pri__DOT__color_out;
+    s_history_pos++;
+
+    bool hblank = top->hblank != 0;
+    bool vblank = top->vblank != 0;
+
+    if (hblank || vblank)
+    {
+        if (hblank && !s_in_hblank) s_y++;
+        if (vblank)
+        {
+            if (!s_in_vblank)
+            {
+                PriBand &band = s_bands[s_capture_idx];
+                band.frame = s_frames++;
+                band.valid = true;
+                s_capture_idx ^= 1;
+                s_bands[s_capture_idx].start = s_band_start;
+                s_bands[s_capture_idx].valid = false;
+            }
+            s_y = 0;
+        }
+        s_x = 0;
+        s_in_hblank = hblank;
+        s_in_vblank = vblank;
+        return;
+    }
+
+    s_in_hblank = false;
+    s_in_vblank = false;
+
+    PriBand &band = s_bands[s_capture_idx];
+    int line = s_y - band.start;
+    if (line >= 0 && line < PRI_BAND_LINES && s_x < PRI_WIDTH)
+    {
+        if (s_x == 0)
+        {
+            for( int i = 0; i < 16; i++ )
+            {
+                band.ctrl[line][i] = root->F2__DOT__tc0360pri__DOT__ctrl[i];
+            }
+        }
+
+        // The video output trails the inputs by s_delay pixels and
+        // color_out trails the inputs by one
+        const PriSample &in = s_history[(s_history_pos - 1 - s_delay) % PRI_HISTORY];
+        const PriSample &out = s_history[(s_history_pos - s_delay) % PRI_HISTORY];
+        PriSample &dest = band.pixels[line][s_x];
+        dest.in0 = in.in0;
+        dest.in1 = in.in1;
+        dest.in2 = in.in2;
+        dest.out = out.out;
+    }
+    s_x++;
+}
+
+static void pixel_details(const PriBand &band, int line, int x)
+{
+    const PriSample &p = band.pixels[line][x];
+    const uint8_t *ctrl = band.ctrl[line];
+
+    PriResult r;
+    pri_model(ctrl, p.in0, p.in1, p.in2, &r);
+
+    ImGui::Text("X: %d Y: %d  Frame: %llu", x, band.start + line, (unsigned long long)band.frame);
+    ImGui::Text("SCN:   %03X sel %d prio %X", p.in0 & 0xfff, (p.in0 >> 12) & 3, r.prio[0]);
+    ImGui::Text("OBJ:   %03X sel %d prio %X", p.in1 & 0xfff, (p.in1 >> 12) & 3, r.prio[1]);
+    ImGui::Text("Pivot: %02X  sel %d prio %X", p.in2, (ctrl[1] >> 6) & 3, r.prio[2]);
+    ImGui::Text("Blend: %s", (ctrl[0] & 0x80) ? ((ctrl[0] & 0x40) ? "mode 1" : "mode 2") : "off");
+    ImGui::Text("Winner: %s", r.winner < 0 ? "blend" : INPUT_NAMES[r.winner]);
+    ImGui::TextUnformatted(r.reason);
+    ImGui::Text("Model: %03X  RTL: %03X%s", r.color, p.out & 0xfff, r.color == (p.out & 0xfff) ? "" : "  MISMATCH");
+}
+
+void draw_pri_video_tooltip(int x, int y)
+{
+    if (!pri_capture_active || x < 0 || y < 0 || x >= PRI_WIDTH) return;
+
+    const PriBand &band = complete_band();
+    int line = y - band.start;
+    if (!band.valid || line < 0 || line >= PRI_BAND_LINES) return;
+
+    ImGui::BeginTooltip();
+    pixel_details(band, line, x);
+    ImGui::EndTooltip();
+}
+
+enum
+{
+    VIEW_RTL,
+    VIEW_MODEL,
+    VIEW_WINNER,
+    VIEW_DIFF,
+};
+
+static SDL_Texture *s_texture = nullptr;
+
+static int update_texture(const PriBand &band, int view)
+{
+    if (!s_texture)
+    {
+        s_texture = SDL_CreateTexture(imgui_get_renderer(), SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_STREAMING, PRI_WIDTH, PRI_BAND_LINES);
+    }
+
+    static const uint32_t winner_colors[4] = { 0xffffff00, 0xff404000, 0x40ff4000, 0x4040ff00 };
+
+    void *work;
+    int pitch;
+    SDL_LockTexture(s_texture, nullptr, &work, &pitch);
+
+    int mismatches = 0;
+    for( int y = 0; y < PRI_BAND_LINES; y++ )
+    {
+        uint32_t *dest = (uint32_t *)((uint8_t *)work + (pitch * y));
+        for( int x = 0; x < PRI_WIDTH; x++ )
+        {
+            const PriSample &p = band.pixels[y][x];
+            PriResult r;
+            pri_model(band.ctrl[y], p.in0, p.in1, p.in2, &r);
+            bool match = r.color == (p.out & 0xfff);
+            if (!match) mismatches++;
+
+            if (view == VIEW_RTL)
+                dest[x] = obj_palette_rgb(p.out & 0xfff);
+            else if (view == VIEW_MODEL)
+                dest[x] = obj_palette_rgb(r.color);
+            else if (view == VIEW_WINNER)
+                dest[x] = winner_colors[r.winner + 1];
+            else
+                dest[x] = match ? (obj_palette_rgb(r.color) >> 2) & 0x3f3f3f00 : 0xff000000;
+        }
+    }
+
+    SDL_UnlockTexture(s_texture);
+    return mismatches;
+}
+
 void draw_pri_window()
 {
+    static int view = VIEW_WINNER;
+
     if (!ImGui::Begin("TC0360PRI"))
     {
         ImGui::End();
@@ -48,5 +363,39 @@ void draw_pri_window()
                 (ctrl[9] >> 0) & 0xf,
                 (ctrl[9] >> 4) & 0xf);
 
+    ImGui::Separator();
+    ImGui::Checkbox("Capture Band", &pri_capture_active);
+    ImGui::SliderInt("First Line", &s_band_start, 0, 224 - PRI_BAND_LINES);
+    ImGui::SliderInt("Output Delay", &s_delay, 0, PRI_HISTORY - 2);
+    ImGui::Combo("View", &view, "RTL\0Model\0Winner\0Diff\0");
+
+    const PriBand &band = complete_band();
+    if (pri_capture_active && band.valid)
+    {
+        int mismatches = update_texture(band, view);
+        ImGui::Text("Lines %d-%d, frame %llu, model mismatches: %d", band.start, band.start + PRI_BAND_LINES - 1,
+                    (unsigned long long)band.frame, mismatches);
+        ImGui::TextDisabled("Winner: red SCN, green OBJ, blue Pivot, white blend");
+
+        ImVec2 avail = ImGui::GetContentRegionAvail();
+        float scale = avail.x / PRI_WIDTH;
+        if (scale < 1.0f) scale = 1.0f;
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::Image((ImTextureID)s_texture, ImVec2(PRI_WIDTH * scale, PRI_BAND_LINES * scale));
+
+        if (ImGui::IsItemHovered())
+        {
+            ImVec2 mouse = ImGui::GetMousePos();
+            int x = (int)((mouse.x - origin.x) / scale);
+            int y = (int)((mouse.y - origin.y) / scale);
+            if (x >= 0 && x < PRI_WIDTH && y >= 0 && y < PRI_BAND_LINES)
+            {
+                ImGui::BeginTooltip();
+                pixel_details(band, y, x);
+                ImGui::EndTooltip();
+            }
+        }
+    }
+
     ImGui::End();
 }
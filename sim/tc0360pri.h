@@ -1,6 +1,28 @@
 #ifndef TC0360PRI_H
 #define TC0360PRI_H 1
 
+#include <stdint.h>
+
+// Result of the C++ model of the TC0360PRI priority and blend logic
+struct PriResult
+{
+    uint16_t color;             // 12-bit color_out
+    uint8_t prio[3];            // 0 for a transparent input
+    int winner;                 // input the color came from, -1 for a blend
+    const char *reason;
+};
+
+// ctrl is the 16 control registers, color_in0..2 are the raw inputs
+uint16_t pri_model(const uint8_t *ctrl, uint16_t color_in0, uint16_t color_in1, uint8_t color_in2, PriResult *result);
+
+// When enabled, every frame records the inputs and output for each pixel
+// of the selected band of lines
+extern bool pri_capture_active;
+void pri_capture_tick();
+
 void draw_pri_window();
 
+// Tooltip for a pixel hovered in the video window
+void draw_pri_video_tooltip(int x, int y);
+
 #endif // TC0360PRI_H
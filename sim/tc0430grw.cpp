@@ -0,0 +1,144 @@
+#include "tc0430grw.h"
+#include "games.h"
+#include "sim_sdram.h"
+
+#include "F2.h"
+#include "F2___024root.h"
+
+#include <vector>
+#include <string.h>
+
+extern F2* top;
+extern SimSDRAM sdram;
+
+// Counter values the RTL starts stepping at, relative to the start of
+// hblank and vblank
+static const int PIVOT_HCNT_BEGIN = 90;
+static const int PIVOT_HCNT_BEGIN_280GRD = 85;
+static const int PIVOT_HBLANK_LENGTH = 104;
+
+// Decoded tiles, one byte per pixel, decoded the first time they are used
+static const int PIVOT_TILE_COUNT = 0x4000;
+static std::vector<uint8_t> s_tiles;
+static std::vector<uint8_t> s_valid;
+static const uint8_t *s_tiles_rom = nullptr;
+
+static const uint8_t *pivot_tile(const PivotState &state, uint16_t code)
+{
+    if (s_tiles_rom != state.rom || s_tiles.empty())
+    {
+        s_tiles.assign(PIVOT_TILE_COUNT * 64, 0);
+        s_valid.assign(PIVOT_TILE_COUNT, 0);
+        s_tiles_rom = state.rom;
+    }
+
+    code &= PIVOT_TILE_COUNT - 1;
+    uint8_t *pixels = &s_tiles[code * 64];
+    if (s_valid[code]) return pixels;
+
+    // 16-bit reads, nibbles are ordered d[7:4], d[3:0], d[15:12], d[11:8]
+    for( int row = 0; row < 8; row++ )
+    {
+        size_t ofs = (code * 32) + (row * 4);
+        if (ofs + 4 > state.rom_size) break;
+        const uint8_t *src = state.rom + ofs;
+        for( int x = 0; x < 8; x++ )
+        {
+            uint8_t b = src[((x >> 2) * 2) + ((x >> 1) & 1)];
+            pixels[(row * 8) + x] = (x & 1) ? (b & 0xf) : (b >> 4);
+        }
+    }
+
+    s_valid[code] = 1;
+    return pixels;
+}
+
+static inline uint8_t pivot_dot(const PivotState &state, uint32_t x, uint32_t y)
+{
+    uint16_t code = state.ram[(((y >> 15) & 63) * 64) + ((x >> 15) & 63)];
+    if ((code & 0x3fff) == 0) return 0;
+
+    uint8_t pixel = pivot_tile(state, code)[(((y >> 12) & 7) * 8) + ((x >> 12) & 7)];
+    return ((code >> 14) << 4) | pixel;
+}
+
+static inline uint32_t sign_extend(uint16_t v)
+{
+    return (uint32_t)(int32_t)(int16_t)v;
+}
+
+void pivot_state_from_rtl(PivotState *state)
+{
+    auto root = top->rootp;
+
+    for( int i = 0; i < 0x1000; i++ )
+    {
+        state->ram[i] = (root->F2__DOT__pivot_ram__DOT__ram_h.m_storage[i] << 8) | root->F2__DOT__pivot_ram__DOT__ram_l.m_storage[i];
+    }
+
+    for( int i = 0; i < 8; i++ )
+    {
+        state->ctrl[i] = root->F2__DOT__tc0430grw__DOT__ctrl[i];
+    }
+
+    state->is_280grd = root->F2__DOT__cfg_280grd != 0;
+    state->color_bank = root->F2__DOT__tc0360pri__DOT__ctrl[1];
+    state->rom = sdram.data + PIVOT_ROM_SDR_BASE;
+    state->rom_size = sdram.size - PIVOT_ROM_SDR_BASE;
+}
+
+void pivot_render_plane(const PivotState &state, uint8_t *plane)
+{
+    for( int ty = 0; ty < 64; ty++ )
+    {
+        for( int tx = 0; tx < 64; tx++ )
+        {
+            uint8_t *dest = plane + (ty * 8 * PIVOT_PLANE_SIZE) + (tx * 8);
+            uint16_t code = state.ram[(ty * 64) + tx];
+            if ((code & 0x3fff) == 0)
+            {
+                for( int y = 0; y < 8; y++ )
+                {
+                    memset(dest + (y * PIVOT_PLANE_SIZE), 0, 8);
+                }
+                continue;
+            }
+
+            uint8_t color_hi = (code >> 14) << 4;
+            const uint8_t *pixels = pivot_tile(state, code);
+            for( int y = 0; y < 8; y++ )
+            {
+                for( int x = 0; x < 8; x++ )
+                {
+                    dest[(y * PIVOT_PLANE_SIZE) + x] = color_hi | pixels[(y * 8) + x];
+                }
+            }
+        }
+    }
+}
+
+void pivot_render_line(const PivotState &state, int line, int h_adjust, uint8_t *dots)
+{
+    uint32_t origin_x = ((state.ctrl[0] & 0xff) << 16) | state.ctrl[1];
+    uint32_t origin_y = ((state.ctrl[4] & 0xff) << 16) | state.ctrl[5];
+    uint32_t dxx = sign_extend(state.ctrl[2]) << (state.is_280grd ? 1 : 0);
+    uint32_t dyx = sign_extend(state.ctrl[6]) << (state.is_280grd ? 1 : 0);
+    uint32_t dxy = sign_extend(state.ctrl[3]);
+    uint32_t dyy = sign_extend(state.ctrl[7]);
+
+    // Each line is fetched during the line before it is displayed and the
+    // first fetched line has already stepped once from the origin
+    uint32_t row_x = origin_x + ((line + 1) * dxy);
+    uint32_t row_y = origin_y + ((line + 1) * dyy);
+
+    int hcnt_begin = state.is_280grd ? PIVOT_HCNT_BEGIN_280GRD : PIVOT_HCNT_BEGIN;
+    for( int x = 0; x < PIVOT_SCREEN_WIDTH; x++ )
+    {
+        // Steps start one pixel after the first fetch
+        int step = x + PIVOT_HBLANK_LENGTH - hcnt_begin + h_adjust - 1;
+        if (step < 0) step = 0;
+        uint32_t cur_x = row_x + (step * dxx);
+        uint32_t cur_y = row_y + (step * dyx);
+        dots[x] = pivot_dot(state, cur_x & 0xffffff, cur_y & 0xffffff);
+    }
+}
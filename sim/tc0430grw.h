@@ -0,0 +1,45 @@
+#if !defined(TC0430GRW_H)
+#define TC0430GRW_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Functional model of the TC0430GRW/TC0280GRD rotation and zoom layer,
+// following tc0430grw.sv.
+//
+// The tile map is 64x64 8x8 tiles, positions are 24-bit with 12 fractional
+// bits. Dots are 6-bit, the top 2 bits from the tile code and the low 4
+// from the tile data, with a pixel of 0 being transparent.
+
+static const int PIVOT_PLANE_SIZE = 512;
+static const int PIVOT_SCREEN_WIDTH = 320;
+static const int PIVOT_SCREEN_HEIGHT = 224;
+
+struct PivotState
+{
+    uint16_t ram[0x1000];       // words, pivot_ram
+    uint16_t ctrl[8];
+    bool is_280grd;
+    uint8_t color_bank;         // TC0360PRI ctrl[1], upper palette bits
+    const uint8_t *rom;         // tile data in SDRAM
+    size_t rom_size;
+};
+
+// Fill the state from the current RTL state
+void pivot_state_from_rtl(PivotState *state);
+
+// Render the whole 512x512 tile map with no transform
+void pivot_render_plane(const PivotState &state, uint8_t *plane);
+
+// Render PIVOT_SCREEN_WIDTH dots for an active screen line, stepping the
+// origin and increments the way the RTL counters do. h_adjust moves the
+// sample position, for lining up with captured frames.
+void pivot_render_line(const PivotState &state, int line, int h_adjust, uint8_t *dots);
+
+// Palette index for a dot
+static inline uint16_t pivot_palette_index(const PivotState &state, uint8_t dot)
+{
+    return ((state.color_bank & 0x3f) << 6) | (dot & 0x3f);
+}
+
+#endif // TC0430GRW_H